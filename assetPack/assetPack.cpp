@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+//Packs loose asset files into one archive the tutorials can map and read in place
+//
+//Layout, all little endian:
+//  header    magic "LPAK", version, entry count, alignment, TOC offset, TOC size
+//  data      each entry's bytes, starting on a multiple of the alignment
+//  TOC       per entry: offset, stored size, size, checksum, compression, name length, name
+//TOC entries are sorted by name so readers can binary search them
+
+const uint32_t ARCHIVE_MAGIC   = 0x4B41504C;
+const uint32_t ARCHIVE_VERSION = 1;
+const int      HEADER_SIZE     = 32;
+
+//Entry compression
+enum ArchiveCompression {
+  COMPRESSION_NONE = 0,
+  COMPRESSION_LZ4  = 1
+};
+
+//Default data alignment, override with --align
+const int DEFAULT_ALIGNMENT = 16;
+
+//LZ4 block format limits
+const int LZ4_MIN_MATCH     = 4;
+const int LZ4_LAST_LITERALS = 5;
+const int LZ4_MATCH_LIMIT   = 12;
+const int LZ4_MAX_OFFSET    = 65535;
+const int LZ4_HASH_BITS     = 16;
+
+//An input file
+struct PackEntry {
+  std::string name;
+  std::vector<uint8_t> stored;
+  uint64_t size;
+  uint32_t checksum;
+  uint16_t compression;
+  uint64_t offset;
+};
+
+//FNV-1a hash of the uncompressed bytes
+uint32_t checksum(const uint8_t *data, size_t size) {
+  uint32_t hash = 2166136261u;
+  for(size_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+//Writes an LZ4 length continuation, 255s then the remainder
+void putLength(std::vector<uint8_t> &out, size_t length) {
+  while(length >= 255) {
+    out.push_back(255);
+    length -= 255;
+  }
+  out.push_back((uint8_t)length);
+}
+
+//Compresses to an LZ4 block with a greedy single-probe hash table
+void lz4Compress(const uint8_t *src, size_t size, std::vector<uint8_t> &out) {
+  std::vector<int64_t> table((size_t)1 << LZ4_HASH_BITS, -1);
+  size_t anchor = 0;
+  size_t ip     = 0;
+
+  //Matches must end before the last literals and start before the match limit
+  size_t matchEnd   = size > (size_t)LZ4_LAST_LITERALS ? size - LZ4_LAST_LITERALS : 0;
+  size_t matchStart = size > (size_t)LZ4_MATCH_LIMIT ? size - LZ4_MATCH_LIMIT : 0;
+
+  while(ip < matchStart) {
+    uint32_t sequence;
+    memcpy(&sequence, src + ip, 4);
+    uint32_t hash = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+    int64_t ref = table[hash];
+    table[hash] = ip;
+
+    //No match here, try the next byte
+    uint32_t candidate = 0;
+    if(ref >= 0) {
+      memcpy(&candidate, src + ref, 4);
+    }
+    if(ref < 0 || ip - ref > (size_t)LZ4_MAX_OFFSET || candidate != sequence) {
+      ++ip;
+      continue;
+    }
+
+    //Extend the match
+    size_t length = LZ4_MIN_MATCH;
+    while(ip + length < matchEnd && src[ref + length] == src[ip + length]) {
+      ++length;
+    }
+
+    //Token, literals, offset, then the rest of the match length
+    size_t literals = ip - anchor;
+    size_t extra    = length - LZ4_MIN_MATCH;
+    out.push_back((uint8_t)((std::min(literals, (size_t)15) << 4) | std::min(extra, (size_t)15)));
+    if(literals >= 15) {
+      putLength(out, literals - 15);
+    }
+    out.insert(out.end(), src + anchor, src + ip);
+    size_t offset = ip - ref;
+    out.push_back((uint8_t)(offset & 0xFF));
+    out.push_back((uint8_t)(offset >> 8));
+    if(extra >= 15) {
+      putLength(out, extra - 15);
+    }
+
+    ip    += length;
+    anchor = ip;
+  }
+
+  //The rest goes out as literals
+  size_t literals = size - anchor;
+  out.push_back((uint8_t)(std::min(literals, (size_t)15) << 4));
+  if(literals >= 15) {
+    putLength(out, literals - 15);
+  }
+  out.insert(out.end(), src + anchor, src + size);
+}
+
+void put16(std::vector<uint8_t> &out, uint16_t value) {
+  for(int i = 0; i < 2; ++i) {
+    out.push_back((uint8_t)(value >> (8 * i)));
+  }
+}
+
+void put32(std::vector<uint8_t> &out, uint32_t value) {
+  for(int i = 0; i < 4; ++i) {
+    out.push_back((uint8_t)(value >> (8 * i)));
+  }
+}
+
+void put64(std::vector<uint8_t> &out, uint64_t value) {
+  for(int i = 0; i < 8; ++i) {
+    out.push_back((uint8_t)(value >> (8 * i)));
+  }
+}
+
+//Reads a whole file
+bool readFile(std::string path, std::vector<uint8_t> &contents) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if(file == NULL) {
+    printf("Unable to open %s!\n", path.c_str());
+    return false;
+  }
+
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  contents.resize(size);
+  bool success = size == 0 || fread(&contents[0], size, 1, file) == 1;
+  if(!success) {
+    printf("Unable to read %s!\n", path.c_str());
+  }
+  fclose(file);
+  return success;
+}
+
+//Entries are named by file name, the tutorials open assets without a directory
+std::string entryName(std::string path) {
+  size_t slash = path.find_last_of("/\\");
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+bool byName(const PackEntry &a, const PackEntry &b) {
+  return a.name < b.name;
+}
+
+void usage() {
+  printf("Usage: assetPack [--align BYTES] [--compress] ARCHIVE FILE...\n");
+}
+
+int main(int argc, char *argv[]) {
+  int alignment = DEFAULT_ALIGNMENT;
+  bool compress = false;
+
+  //Parse command line
+  int arg = 1;
+  for(; arg < argc && strncmp(argv[arg], "--", 2) == 0; ++arg) {
+    if(strcmp(argv[arg], "--align") == 0 && arg + 1 < argc) {
+      alignment = atoi(argv[++arg]);
+    } else if(strcmp(argv[arg], "--compress") == 0) {
+      compress = true;
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  if(argc - arg < 2 || alignment <= 0 || (alignment & (alignment - 1)) != 0) {
+    usage();
+    return 1;
+  }
+  std::string archivePath = argv[arg++];
+
+  //Read the inputs
+  std::vector<PackEntry> entries;
+  for(; arg < argc; ++arg) {
+    PackEntry entry;
+    entry.name = entryName(argv[arg]);
+    if(!readFile(argv[arg], entry.stored)) {
+      return 1;
+    }
+    entry.size        = entry.stored.size();
+    entry.checksum    = checksum(entry.stored.empty() ? NULL : &entry.stored[0], entry.stored.size());
+    entry.compression = COMPRESSION_NONE;
+    entry.offset      = 0;
+
+    //Keep the compressed copy only if it saves an eighth, already compressed files like PNG rarely do
+    if(compress && !entry.stored.empty()) {
+      std::vector<uint8_t> packed;
+      lz4Compress(&entry.stored[0], entry.stored.size(), packed);
+      if(packed.size() < entry.size - entry.size / 8) {
+        entry.stored.swap(packed);
+        entry.compression = COMPRESSION_LZ4;
+      }
+    }
+    entries.push_back(entry);
+  }
+
+  //Sort for lookup and refuse duplicate names
+  std::sort(entries.begin(), entries.end(), byName);
+  for(size_t i = 1; i < entries.size(); ++i) {
+    if(entries[i].name == entries[i - 1].name) {
+      printf("%s was given twice!\n", entries[i].name.c_str());
+      return 1;
+    }
+  }
+
+  //Lay out the data
+  uint64_t offset = HEADER_SIZE;
+  for(size_t i = 0; i < entries.size(); ++i) {
+    offset = (offset + alignment - 1) & ~(uint64_t)(alignment - 1);
+    entries[i].offset = offset;
+    offset += entries[i].stored.size();
+  }
+  uint64_t tocOffset = offset;
+
+  //Build the TOC
+  std::vector<uint8_t> toc;
+  for(size_t i = 0; i < entries.size(); ++i) {
+    put64(toc, entries[i].offset);
+    put64(toc, entries[i].stored.size());
+    put64(toc, entries[i].size);
+    put32(toc, entries[i].checksum);
+    put16(toc, entries[i].compression);
+    put16(toc, (uint16_t)entries[i].name.size());
+    toc.insert(toc.end(), entries[i].name.begin(), entries[i].name.end());
+  }
+
+  std::vector<uint8_t> header;
+  put32(header, ARCHIVE_MAGIC);
+  put32(header, ARCHIVE_VERSION);
+  put32(header, (uint32_t)entries.size());
+  put32(header, (uint32_t)alignment);
+  put64(header, tocOffset);
+  put64(header, toc.size());
+
+  //Write it all out
+  FILE *file = fopen(archivePath.c_str(), "wb");
+  if(file == NULL) {
+    printf("Unable to create %s!\n", archivePath.c_str());
+    return 1;
+  }
+
+  bool success = fwrite(&header[0], header.size(), 1, file) == 1;
+  uint64_t written = header.size();
+  for(size_t i = 0; i < entries.size() && success; ++i) {
+    //Pad up to the entry
+    std::vector<uint8_t> padding(entries[i].offset - written, 0);
+    if(!padding.empty()) {
+      success = fwrite(&padding[0], padding.size(), 1, file) == 1;
+    }
+    if(success && !entries[i].stored.empty()) {
+      success = fwrite(&entries[i].stored[0], entries[i].stored.size(), 1, file) == 1;
+    }
+    written = entries[i].offset + entries[i].stored.size();
+
+    printf("%-24s %10lu -> %10lu%s\n", entries[i].name.c_str(), (unsigned long)entries[i].size,
+           (unsigned long)entries[i].stored.size(), entries[i].compression == COMPRESSION_LZ4 ? " lz4" : "");
+  }
+  if(success && !toc.empty()) {
+    success = fwrite(&toc[0], toc.size(), 1, file) == 1;
+  }
+  if(fclose(file) != 0) {
+    success = false;
+  }
+
+  if(!success) {
+    printf("Unable to write %s!\n", archivePath.c_str());
+    remove(archivePath.c_str());
+    return 1;
+  }
+
+  printf("Packed %lu files into %s\n", (unsigned long)entries.size(), archivePath.c_str());
+  return 0;
+}
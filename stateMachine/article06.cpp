@@ -6,6 +6,20 @@ and may not be redistributed without written permission.*/
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_ttf.h>
 #include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <utility>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 /*Constants*/
 //Screen attributes
@@ -13,13 +27,43 @@ const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 const int SCREEN_BPP = 32;
 
-//The frame rate
+//The frame rate, override with --fps
 const int FRAMES_PER_SECOND = 20;
 
+//How long before a frame is due the frame pacer stops sleeping and spins
+const Uint64 SPIN_NANOSECONDS = 2000000;
+
 //The dot dimensions
 const int DOT_WIDTH = 20;
 const int DOT_HEIGHT = 20;
 
+//The dot velocity in pixels per tick
+const int DOT_VEL = 2;
+
+//Logic ticks per second
+const int TICKS_PER_SECOND = 120;
+
+//Most logic ticks run for one frame
+const int MAX_TICKS_PER_FRAME = 8;
+
+//Most states stacked at once
+const int MAX_STATE_DEPTH = 4;
+
+//Megabytes of unused images the resource cache keeps, override with --cache-budget
+const int CACHE_BUDGET = 32;
+
+//Time each frame may spend finishing images decoded in the background
+const Uint64 UPLOAD_NANOSECONDS = 2000000;
+
+//Packed assets read before loose files, override with --archive
+const char *ARCHIVE_PATH = "assets.pak";
+
+//Asset archive layout, see assetPack
+const Uint32 ARCHIVE_MAGIC = 0x4B41504C;
+const Uint32 ARCHIVE_VERSION = 1;
+const int ARCHIVE_HEADER_SIZE = 32;
+const int ARCHIVE_ENTRY_SIZE = 32;
+
 //The house dimensions
 const int HOUSE_WIDTH = 40;
 const int HOUSE_HEIGHT = 40;
@@ -37,112 +81,201 @@ enum GameStates
     STATE_GREEN_OVERWORLD,
     STATE_RED_ROOM,
     STATE_BLUE_ROOM,
+    STATE_PAUSED,
     STATE_EXIT,
 };
 
+//State changes
+enum StateActions
+{
+    ACTION_NONE,
+    ACTION_CHANGE,
+    ACTION_PUSH,
+    ACTION_POP
+};
+
 /*Classes*/
 //Game state base class
 class GameState
 {
     public:
+    //Loads the state's assets, called once before the state is first entered.
+    //Images come in over the next frames and are NULL until then
+    virtual void load(){};
+
+    //Sets up the state's objects, prevState is the state that was left
+    virtual void enter( int ){};
+
+    //Removes the state's objects, its assets stay loaded
+    virtual void leave(){};
+
+    //Frees the state's assets
+    virtual void free(){};
+
+    //Overlays are shown over the state beneath them on the stack
+    virtual bool is_overlay(){ return false; };
+
     virtual void handle_events() = 0;
     virtual void logic() = 0;
     virtual void render() = 0;
     virtual ~GameState(){};
 };
 
-//The dot
-class Dot
+//Entities are ids that components are attached to
+typedef int Entity;
+
+//Sprite layers, drawn in order
+enum SpriteLayers
 {
-    private:
-    //The collision box of the dot
-    SDL_Rect box;
+    LAYER_SCENERY,
+    LAYER_ACTORS
+};
+
+//Where an entity is, and where it was before the last tick
+struct Position
+{
+    int x, y;
+    int prevX, prevY;
+};
+
+//How far an entity moves each tick, bouncing entities turn around at the level edge
+struct Velocity
+{
+    int x, y;
+    bool bounce;
+};
 
-    //The velocity of the dot
-    int xVel, yVel;
+//The size of an entity's box
+struct Collider
+{
+    int w, h;
+};
 
-    //The current level dimensions
-    int curLvlWidth;
-    int curLvlHeight;
+//What an entity is drawn with, read through a pointer so images that finish loading
+//show up. No surface, or one still loading, draws a black box the size of its collider
+struct Sprite
+{
+    SDL_Surface **surface;
+    int layer;
+};
 
-    public:
-    //Initializes the variables
-    Dot();
+//Components of one type packed into a dense array, with the entity each one belongs to
+template <class T>
+class ComponentArray
+{
+    private:
+    //The packed components and their entities
+    std::vector<T> components;
+    std::vector<Entity> owners;
+
+    //Where each entity's component is, -1 if it has none
+    std::vector<int> slots;
 
-    //Sets the dot
-    void init( int x, int y, int lvlWidth, int lvlHeight );
+    public:
+    //Gives an entity the component, replacing one it already has
+    void add( Entity entity, const T &component );
 
-    //Handles keypress
-    void handle_input();
+    //Takes the component away, the last component moves into its place
+    void remove( Entity entity );
 
-    //Moves the dot
-    void move();
+    //Checks if an entity has the component
+    bool has( Entity entity );
 
-    //Shows the dot
-    void show();
+    //Gets an entity's component
+    T &get( Entity entity );
 
-    //Sets the camera over the dot
-    void set_camera();
+    //Dense access for systems
+    int size();
+    T &at( int index );
+    Entity owner( int index );
 
-    //Gets the dot's collision box
-    operator SDL_Rect();
+    //Puts components in entity order so systems walking several arrays read them in step
+    void sort();
 };
 
-class House
+//The entities of the game and the systems that run over them
+class World
 {
     private:
-    //The house graphic
-    SDL_Surface *houseGFX;
+    //Next new entity and entities free for reuse
+    Entity nextEntity;
+    std::vector<Entity> freeEntities;
+
+    //The level moving entities are kept inside
+    int levelWidth;
+    int levelHeight;
 
-    //The collision box of the house
-    SDL_Rect box;
+    //The components
+    ComponentArray<Position> positions;
+    ComponentArray<Velocity> velocities;
+    ComponentArray<Collider> colliders;
+    ComponentArray<Sprite> sprites;
 
     public:
     //Initializes variables
-    House();
+    World();
 
-    //Frees graphic
-    ~House();
+    //Makes an entity with no components
+    Entity create();
 
-    //Sets the house
-    void init( int x, int y, SDL_Surface *housePic );
+    //Removes an entity's components and frees its id
+    void destroy( Entity entity );
 
-    //Shows the house
-    void show();
+    //Adds components, a new position is not interpolated from the old one
+    void add_position( Entity entity, int x, int y );
+    void add_velocity( Entity entity, int x, int y, bool bounce );
+    void add_collider( Entity entity, int w, int h );
+    void add_sprite( Entity entity, SDL_Surface **surface, int layer );
 
-    //Gets the collision box
-    operator SDL_Rect();
-};
+    //Gets an entity's velocity
+    Velocity &get_velocity( Entity entity );
 
-class Door
-{
-    private:
-    //The area of the door
-    SDL_Rect box;
+    //Gets an entity's collision box
+    SDL_Rect get_box( Entity entity );
 
-    public:
-    //Initializes variables
-    Door();
+    //Gets where an entity is drawn between its last two ticks
+    int get_render_x( Entity entity );
+    int get_render_y( Entity entity );
+
+    //Sets and gets the level size
+    void set_level( int w, int h );
+    int get_level_width();
+    int get_level_height();
 
-    //Sets the Door
-    void init( int x, int y );
+    //Puts every component array in entity order, call after adding or removing many entities
+    void sort();
 
-    //Shows the door
-    void show();
+    //Moves every entity with a velocity one tick, they need a position and collider
+    void move_all();
 
-    //Gets the collision box
-    operator SDL_Rect();
+    //Puts every entity where its last tick ended, so nothing is drawn between ticks
+    void stop_all();
+
+    //Draws every sprite on a layer that the camera sees
+    void show_all( int layer );
 };
 
-//The timer
+//The timer, runs off the performance counter in 64 bits
 class Timer
 {
+    public:
+    //Laps kept for the rolling statistics
+    static const int ROLLING_LAPS = 64;
+
     private:
-    //The clock time when the timer started
-    int startTicks;
+    //The counter value when the timer started
+    Uint64 startCounts;
+
+    //The counts stored when the timer was paused
+    Uint64 pausedCounts;
 
-    //The ticks stored when the timer was paused
-    int pausedTicks;
+    //Timer time the current lap started at
+    Uint64 lapStart;
+
+    //Lap lengths, the oldest is overwritten first
+    Uint64 laps[ ROLLING_LAPS ];
+    int lapCount;
+    int nextLap;
 
     //The timer status
     bool paused;
@@ -158,12 +291,406 @@ class Timer
     void pause();
     void unpause();
 
-    //Gets the timer's time
+    //Gets the timer's time in milliseconds
     int get_ticks();
 
+    //Gets the timer's time in nanoseconds
+    Uint64 get_nanoseconds();
+
+    //Ends the current lap and returns its length in nanoseconds
+    Uint64 lap();
+
+    //Gets the time into the current lap in nanoseconds
+    Uint64 split();
+
+    //Statistics over the last laps in nanoseconds
+    int get_lap_count();
+    Uint64 get_lap_average();
+    Uint64 get_lap_min();
+    Uint64 get_lap_max();
+
     //Checks the status of the timer
     bool is_started();
     bool is_paused();
+
+    //Converts performance counter ticks to nanoseconds
+    static Uint64 to_nanoseconds( Uint64 counts );
+};
+
+//Records timed zones into a buffer per thread and writes them as a Chrome trace_event file
+class Profiler
+{
+    public:
+    //Zones kept per thread, later ones are counted and dropped
+    static const int MAX_EVENTS = 1 << 20;
+
+    private:
+    //A finished zone in performance counter ticks
+    struct Event
+    {
+        const char *name;
+        Uint64 start;
+        Uint64 end;
+    };
+
+    //Zones recorded by one thread, only that thread appends to it
+    struct ThreadBuffer
+    {
+        int id;
+        std::string name;
+        std::vector<Event> events;
+        int dropped;
+    };
+
+    //Recording flag
+    bool enabled;
+
+    //Where each thread keeps its buffer
+    SDL_TLSID buffer;
+
+    //Guards the list of buffers
+    SDL_mutex *lock;
+    std::vector<ThreadBuffer*> buffers;
+
+    //Counter value trace times are measured from
+    Uint64 startCounts;
+
+    //Gets the calling thread's buffer, creating it on first use
+    ThreadBuffer *get_buffer();
+
+    public:
+    //Initializes variables
+    Profiler();
+
+    //Frees the buffers
+    ~Profiler();
+
+    //Starts recording
+    bool enable();
+
+    //Checks if zones are being recorded
+    bool is_enabled();
+
+    //Names the calling thread in the trace
+    void name_thread( const char *name );
+
+    //Records a finished zone on the calling thread
+    void record( const char *name, Uint64 start, Uint64 end );
+
+    //Writes every thread's zones
+    bool write( std::string path );
+
+    //Stops recording and frees the buffers
+    void free();
+};
+
+//Times the scope it is declared in, costs one check while the profiler is off
+class ProfileZone
+{
+    private:
+    //Zone name and start, start is 0 when not recording
+    const char *name;
+    Uint64 start;
+
+    public:
+    //Starts timing
+    ProfileZone( const char *zoneName );
+
+    //Records the zone
+    ~ProfileZone();
+};
+
+//Holds frames to a steady rate by sleeping most of the wait and
+//spinning on the performance counter for the last stretch
+class FramePacer
+{
+    private:
+    //Counter ticks per frame, fractional so any rate works
+    double periodCounts;
+
+    //Counter ticks spun instead of slept
+    Uint64 spinCounts;
+
+    //Deadlines are counted from here so rounding never builds up
+    Uint64 startCounts;
+    Uint64 frames;
+
+    //How late frames were released
+    Uint64 totalError;
+    Uint64 maxError;
+    Uint64 pacedFrames;
+    Uint64 missedFrames;
+
+    //Counts how late a frame was released, late frames included
+    void record_error( Uint64 lateCounts );
+
+    public:
+    //Initializes variables
+    FramePacer();
+
+    //Sets the frame rate and starts timing from now
+    void start( double framesPerSecond );
+
+    //Waits until the next frame is due
+    void wait();
+
+    //Gets how late frames were released in nanoseconds
+    Uint64 get_average_error();
+    Uint64 get_max_error();
+
+    //Gets the number of frames that were already late
+    Uint64 get_missed_frames();
+};
+
+//Runs the logic in fixed ticks however often frames are drawn
+class FixedTimestep
+{
+    private:
+    //Performance counter ticks per logic tick
+    Uint64 tickCounts;
+
+    //Counter value at the last advance
+    Uint64 lastCounts;
+
+    //Time not yet simulated
+    Uint64 accumulator;
+
+    //Ticks dropped by the frame limit
+    Uint64 dropped;
+
+    public:
+    //Initializes variables
+    FixedTimestep();
+
+    //Starts timing from now
+    void start();
+
+    //Adds the time since the last call and returns how many ticks to run,
+    //time past MAX_TICKS_PER_FRAME is dropped so a slow frame cannot slow the next
+    int advance();
+
+    //Gets how far the time is from the last tick to the next, from 0 to 1
+    double get_alpha();
+
+    //Gets the number of ticks dropped by the frame limit
+    Uint64 get_dropped_ticks();
+};
+
+//Archive entry compression
+enum ArchiveCompression
+{
+    COMPRESSION_NONE,
+    COMPRESSION_LZ4
+};
+
+//Serves assets out of one memory mapped archive made by assetPack
+class AssetArchive
+{
+    private:
+    //A packed file
+    struct Entry
+    {
+        std::string name;
+        Uint64 offset;
+        Uint64 storedSize;
+        Uint64 size;
+        Uint32 checksum;
+        int compression;
+    };
+
+    //Where an open stream is in its entry
+    struct Stream
+    {
+        const Uint8 *base;
+        Sint64 size;
+        Sint64 position;
+
+        //Unpacked copy of a compressed entry, freed with the stream
+        Uint8 *unpacked;
+    };
+
+    //The archive's bytes
+    Uint8 *data;
+    Uint64 dataSize;
+    bool mapped;
+
+    //The TOC, sorted by name
+    std::vector<Entry> entries;
+
+    //Finds an entry
+    Entry *find( std::string name );
+
+    //Unpacks an LZ4 block, false if it is damaged
+    static bool unpack( const Uint8 *source, Uint64 sourceSize, Uint8 *destination, Uint64 destinationSize );
+
+    //FNV-1a hash of unpacked bytes
+    static Uint32 checksum( const Uint8 *bytes, Uint64 size );
+
+    //Stream callbacks
+    static Sint64 stream_size( SDL_RWops *rw );
+    static Sint64 stream_seek( SDL_RWops *rw, Sint64 offset, int whence );
+    static size_t stream_read( SDL_RWops *rw, void *ptr, size_t size, size_t maxnum );
+    static size_t stream_write( SDL_RWops *rw, const void *ptr, size_t size, size_t num );
+    static int stream_close( SDL_RWops *rw );
+
+    public:
+    //Initializes variables
+    AssetArchive();
+
+    //Maps an archive, false if it's missing or damaged
+    bool load( std::string path );
+
+    //Opens an entry as a stream, NULL if the archive doesn't have it
+    SDL_RWops *open( std::string name );
+
+    //Gets how many files are packed
+    int get_count();
+
+    //Unmaps the archive, close streams over it first
+    void free();
+};
+
+//Decodes image files on a worker thread, the main thread collects the results
+class ImageLoader
+{
+    private:
+    //A file to decode and the image it gave, NULL if it failed
+    struct Job
+    {
+        std::string key;
+        std::string filename;
+        SDL_Surface *image;
+    };
+
+    //The worker, NULL when jobs are decoded as they are requested
+    SDL_Thread *thread;
+
+    //Guards the queues, the worker waits on wake for jobs
+    SDL_mutex *lock;
+    SDL_cond *wake;
+    bool quit;
+
+    //Jobs waiting for the worker and jobs it finished
+    std::deque<Job> waiting;
+    std::deque<Job> decoded;
+
+    //Decodes jobs until told to quit
+    static int decode_thread( void *data );
+
+    public:
+    //Initializes variables
+    ImageLoader();
+
+    //Starts the worker, without one jobs are decoded right away
+    bool start();
+
+    //Queues a file to decode, key comes back with the image
+    void request( std::string key, std::string filename );
+
+    //Takes one decoded image, false if none are ready
+    bool collect( std::string &key, SDL_Surface *&image );
+
+    //Stops the worker and frees images nobody collected
+    void free();
+};
+
+//Shares loaded images and fonts by file and settings. Each get is matched by a
+//release, unused assets stay cached within the budget, least recently used go first
+class ResourceCache
+{
+    private:
+    //A cached asset
+    struct Resource
+    {
+        SDL_Surface *image;
+        TTF_Font *font;
+
+        //Bytes of pixel data
+        int bytes;
+
+        //Users and when it was last used
+        int refs;
+        Uint64 lastUsed;
+    };
+
+    //Assets by key and keys by asset
+    std::map<std::string, Resource> resources;
+    std::map<void*, std::string> keys;
+
+    //Bytes of unused assets that may stay loaded, -1 keeps everything
+    Sint64 budget;
+
+    //Bytes of all cached assets
+    Sint64 totalBytes;
+
+    //Use counter for eviction order
+    Uint64 useClock;
+
+    //Loads a key or reuses it
+    Resource *get( std::string key );
+
+    //Drops a user of an asset
+    void release( void *asset );
+
+    //Frees unused assets until the cache fits its budget
+    void trim();
+
+    //Frees an asset
+    void destroy( std::map<std::string, Resource>::iterator it );
+
+    //An image being decoded and where it goes when it's finished
+    struct Request
+    {
+        bool colorKey;
+        std::vector<SDL_Surface**> targets;
+    };
+
+    //Decodes requested images, by key
+    ImageLoader loader;
+    std::map<std::string, Request> pending;
+
+    //Makes the key an image is cached under
+    static std::string image_key( std::string filename, bool colorKey );
+
+    //Adds a finished image with a use for each of its users
+    void insert_image( std::string key, SDL_Surface *image, int refs );
+
+    public:
+    //Initializes variables
+    ResourceCache();
+
+    //Starts decoding requested images in the background
+    bool start();
+
+    //Sets the budget in bytes, -1 keeps everything
+    void set_budget( Sint64 bytes );
+
+    //Gets a shared optimized image
+    SDL_Surface *get_image( std::string filename, bool colorKey = true );
+
+    //Gets a shared optimized image without waiting for it. The target is NULL
+    //until the image is decoded and update() stores it there with a use taken
+    void request_image( std::string filename, SDL_Surface **target, bool colorKey = true );
+
+    //Stores decoded images, spending at most budget nanoseconds
+    void update( Uint64 budget );
+
+    //Checks if requested images are still on their way
+    bool is_loading();
+
+    //Gets a shared font
+    TTF_Font *get_font( std::string filename, int size );
+
+    //Gives back what get_image or get_font returned
+    void release_image( SDL_Surface *image );
+    void release_font( TTF_Font *font );
+
+    //Gets how many assets and bytes are cached
+    int get_count();
+    Sint64 get_bytes();
+
+    //Stops loading and frees everything
+    void free();
 };
 
 class Intro : public GameState
@@ -176,10 +703,13 @@ class Intro : public GameState
     SDL_Surface *message;
 
     public:
-    //Loads intro resources
+    //Initializes variables
     Intro();
+
+    //Loads intro resources
+    void load();
     //Frees intro resources
-    ~Intro();
+    void free();
 
     //Main loop functions
     void handle_events();
@@ -197,10 +727,13 @@ class Title : public GameState
     SDL_Surface *message;
 
     public:
-    //Loads title screen resources
+    //Initializes variables
     Title();
-    //Frees title resources
-    ~Title();
+
+    //Loads title screen resources
+    void load();
+    //Frees title screen resources
+    void free();
 
     //Main loop functions
     void handle_events();
@@ -218,16 +751,32 @@ class OverWorld : public GameState
     //Overworld background
     SDL_Surface *background;
 
+    //The house graphics
+    SDL_Surface *redHouseGFX;
+    SDL_Surface *blueHouseGFX;
+
     //The houses
-    House redHouse;
-    House blueHouse;
+    Entity redHouse;
+    Entity blueHouse;
+
+    //Dots wandering the overworld
+    std::vector<Entity> wanderers;
 
     public:
-    //Loads resources and initializes objects
-    OverWorld( int prevState );
+    //Initializes variables
+    OverWorld();
+
+    //Loads resources
+    void load();
+
+    //Sets up the houses and dots
+    void enter( int prevState );
+
+    //Removes the houses and dots
+    void leave();
 
     //Frees resources
-    ~OverWorld();
+    void free();
 
     //Main loop functions
     void handle_events();
@@ -246,14 +795,23 @@ class RedRoom : public GameState
     SDL_Surface *background;
 
     //The exit door
-    Door exit;
+    Entity exit;
 
     public:
-    //Loads resources and intializes objects
+    //Initializes variables
     RedRoom();
 
+    //Loads resources
+    void load();
+
+    //Sets up the door and the dot
+    void enter( int prevState );
+
+    //Removes the door
+    void leave();
+
     //Frees resources
-    ~RedRoom();
+    void free();
 
     //Main loop functions
     void handle_events();
@@ -272,14 +830,47 @@ class BlueRoom : public GameState
     SDL_Surface *background;
 
     //The exit door
-    Door exit;
+    Entity exit;
 
     public:
-    //Loads resources and intializes objects
+    //Initializes variables
     BlueRoom();
 
+    //Loads resources
+    void load();
+
+    //Sets up the door and the dot
+    void enter( int prevState );
+
+    //Removes the door
+    void leave();
+
     //Frees resources
-    ~BlueRoom();
+    void free();
+
+    //Main loop functions
+    void handle_events();
+    void logic();
+    void render();
+};
+
+class Paused : public GameState
+{
+    private:
+    //Pause message
+    SDL_Surface *message;
+
+    public:
+    //Initializes variables
+    Paused();
+
+    //Loads pause resources
+    void load();
+    //Frees pause resources
+    void free();
+
+    //Shows over the paused state
+    bool is_overlay();
 
     //Main loop functions
     void handle_events();
@@ -287,9 +878,69 @@ class BlueRoom : public GameState
     void render();
 };
 
+//Runs the state stack, every state is made once and keeps the assets it loads
+//on its first visit until shutdown, the resource cache shares them between states
+class StateManager
+{
+    private:
+    //The states
+    Intro intro;
+    Title title;
+    OverWorld overWorld;
+    RedRoom redRoom;
+    BlueRoom blueRoom;
+    Paused paused;
+
+    //The states by ID and whether their assets are loaded
+    GameState *pool[ STATE_EXIT ];
+    bool loaded[ STATE_EXIT ];
+
+    //The state stack, the top state runs
+    int stack[ MAX_STATE_DEPTH ];
+    int depth;
+
+    //The requested change
+    int nextState;
+    int nextAction;
+
+    //If the user quit
+    bool exiting;
+
+    //Loads a state if it needs to and puts it on top of the stack
+    void enter( int id, int prevState );
+
+    public:
+    //Initializes variables
+    StateManager();
+
+    //Requests a change, applied by change()
+    void set_next( int id );
+    void push( int id );
+    void pop();
+
+    //Applies the requested change
+    void change();
+
+    //Gets the running state
+    int get_id();
+    GameState *get_current();
+
+    //Shows the running state and any states under its overlays
+    void render();
+
+    //Leaves every state and frees their assets
+    void free();
+};
+
 /*Functions*/
 //Image loader
-SDL_Surface *load_image( std::string filename );
+SDL_Surface *load_image( std::string filename, bool colorKey = true );
+
+//Reads an image file as it is, safe on any thread
+SDL_Surface *decode_image( std::string filename );
+
+//Converts a decoded image to the screen format and frees the original
+SDL_Surface *optimize_image( SDL_Surface *loadedImage, bool colorKey );
 
 //Surface blitter
 void apply_surface( int x, int y, SDL_Surface* source, SDL_Surface* destination, SDL_Rect* clip = NULL );
@@ -309,14 +960,29 @@ void clean_up();
 //State status manager
 void set_next_state( int newState );
 
+//Puts a state over the current one
+void push_state( int newState );
+
+//Goes back to the state under the current one
+void pop_state();
+
 //State changer
 void change_state();
 
+//Steers the player from key presses
+void handle_player_input();
+
+//Centers the camera over the player
+void set_camera();
+
 /*Globals*/
 //The surfaces
 SDL_Surface *dot = NULL;
 SDL_Surface *screen = NULL;
 
+//Shown under a state while its images load
+SDL_Surface *placeholder = NULL;
+
 //The event structure
 SDL_Event event;
 
@@ -329,299 +995,1615 @@ TTF_Font *font = NULL;
 //The color of the font
 SDL_Color textColor = { 0, 0, 0 };
 
-//The dot
-Dot myDot;
+//The game's entities
+World world;
+
+//The dot the player moves
+Entity player = 0;
 
-//State variables
-int stateID = STATE_NULL;
-int nextState = STATE_NULL;
+//Dots wandering the overworld, set with --dots
+int wanderingDots = 0;
 
-//Game state object
-GameState *currentState = NULL;
+//Packed assets
+AssetArchive archive;
+
+//Loaded images and fonts
+ResourceCache resources;
+
+//The game states
+StateManager states;
+
+//Frame profiler, enabled with --trace
+Profiler profiler;
+
+//The logic clock
+FixedTimestep timestep;
+
+/*Class Definitions*/
+template <class T>
+void ComponentArray<T>::add( Entity entity, const T &component )
+{
+    if( entity >= (int)slots.size() )
+    {
+        slots.resize( entity + 1, -1 );
+    }
+
+    //Replace an existing component
+    if( slots[ entity ] != -1 )
+    {
+        components[ slots[ entity ] ] = component;
+        return;
+    }
+
+    //Pack the new one at the end
+    slots[ entity ] = components.size();
+    components.push_back( component );
+    owners.push_back( entity );
+}
+
+template <class T>
+void ComponentArray<T>::remove( Entity entity )
+{
+    if( has( entity ) == false )
+    {
+        return;
+    }
+
+    //Fill the hole with the last component
+    int slot = slots[ entity ];
+    int last = components.size() - 1;
+    components[ slot ] = components[ last ];
+    owners[ slot ] = owners[ last ];
+    slots[ owners[ slot ] ] = slot;
+    components.pop_back();
+    owners.pop_back();
+    slots[ entity ] = -1;
+}
+
+template <class T>
+bool ComponentArray<T>::has( Entity entity )
+{
+    return ( entity < (int)slots.size() ) && ( slots[ entity ] != -1 );
+}
+
+template <class T>
+T &ComponentArray<T>::get( Entity entity )
+{
+    return components[ slots[ entity ] ];
+}
+
+template <class T>
+int ComponentArray<T>::size()
+{
+    return components.size();
+}
+
+template <class T>
+T &ComponentArray<T>::at( int index )
+{
+    return components[ index ];
+}
+
+template <class T>
+Entity ComponentArray<T>::owner( int index )
+{
+    return owners[ index ];
+}
+
+template <class T>
+void ComponentArray<T>::sort()
+{
+    //Order the slots by entity
+    std::vector< std::pair<Entity, int> > order( owners.size() );
+    for( int i = 0; i < (int)owners.size(); i++ )
+    {
+        order[ i ] = std::make_pair( owners[ i ], i );
+    }
+    std::sort( order.begin(), order.end() );
+
+    //Rebuild the arrays in that order
+    std::vector<T> sorted;
+    sorted.reserve( components.size() );
+    for( int i = 0; i < (int)order.size(); i++ )
+    {
+        sorted.push_back( components[ order[ i ].second ] );
+        owners[ i ] = order[ i ].first;
+        slots[ owners[ i ] ] = i;
+    }
+    components.swap( sorted );
+}
+
+World::World()
+{
+    //Initialize
+    nextEntity = 0;
+    levelWidth = SCREEN_WIDTH;
+    levelHeight = SCREEN_HEIGHT;
+}
+
+Entity World::create()
+{
+    //Reuse a freed id if there is one
+    if( freeEntities.empty() == false )
+    {
+        Entity entity = freeEntities.back();
+        freeEntities.pop_back();
+        return entity;
+    }
+
+    return nextEntity++;
+}
+
+void World::destroy( Entity entity )
+{
+    positions.remove( entity );
+    velocities.remove( entity );
+    colliders.remove( entity );
+    sprites.remove( entity );
+    freeEntities.push_back( entity );
+}
+
+void World::add_position( Entity entity, int x, int y )
+{
+    Position position = { x, y, x, y };
+    positions.add( entity, position );
+}
+
+void World::add_velocity( Entity entity, int x, int y, bool bounce )
+{
+    Velocity velocity = { x, y, bounce };
+    velocities.add( entity, velocity );
+}
+
+void World::add_collider( Entity entity, int w, int h )
+{
+    Collider collider = { w, h };
+    colliders.add( entity, collider );
+}
+
+void World::add_sprite( Entity entity, SDL_Surface **surface, int layer )
+{
+    Sprite sprite = { surface, layer };
+    sprites.add( entity, sprite );
+}
+
+Velocity &World::get_velocity( Entity entity )
+{
+    return velocities.get( entity );
+}
+
+SDL_Rect World::get_box( Entity entity )
+{
+    Position &position = positions.get( entity );
+    Collider &collider = colliders.get( entity );
+    SDL_Rect box = { position.x, position.y, collider.w, collider.h };
+    return box;
+}
+
+int World::get_render_x( Entity entity )
+{
+    Position &position = positions.get( entity );
+    return (int)( position.prevX + ( position.x - position.prevX ) * timestep.get_alpha() + 0.5 );
+}
+
+int World::get_render_y( Entity entity )
+{
+    Position &position = positions.get( entity );
+    return (int)( position.prevY + ( position.y - position.prevY ) * timestep.get_alpha() + 0.5 );
+}
+
+void World::set_level( int w, int h )
+{
+    levelWidth = w;
+    levelHeight = h;
+}
+
+int World::get_level_width()
+{
+    return levelWidth;
+}
+
+int World::get_level_height()
+{
+    return levelHeight;
+}
+
+void World::sort()
+{
+    positions.sort();
+    velocities.sort();
+    colliders.sort();
+    sprites.sort();
+}
+
+void World::move_all()
+{
+    //Walk the velocities, positions and colliders are in the same entity order
+    for( int i = 0; i < velocities.size(); i++ )
+    {
+        Entity entity = velocities.owner( i );
+        Velocity &velocity = velocities.at( i );
+        Position &position = positions.get( entity );
+        Collider &collider = colliders.get( entity );
+
+        //Remember where the tick started for interpolation
+        position.prevX = position.x;
+        position.prevY = position.y;
+
+        //Move left or right
+        position.x += velocity.x;
+
+        //If it went too far to the left or right
+        if( ( position.x < 0 ) || ( position.x + collider.w > levelWidth ) )
+        {
+            //Move back
+            position.x -= velocity.x;
+            if( velocity.bounce == true )
+            {
+                velocity.x = -velocity.x;
+            }
+        }
+
+        //Move up or down
+        position.y += velocity.y;
+
+        //If it went too far up or down
+        if( ( position.y < 0 ) || ( position.y + collider.h > levelHeight ) )
+        {
+            //Move back
+            position.y -= velocity.y;
+            if( velocity.bounce == true )
+            {
+                velocity.y = -velocity.y;
+            }
+        }
+    }
+}
+
+void World::stop_all()
+{
+    for( int i = 0; i < positions.size(); i++ )
+    {
+        Position &position = positions.at( i );
+        position.prevX = position.x;
+        position.prevY = position.y;
+    }
+}
+
+void World::show_all( int layer )
+{
+    double alpha = timestep.get_alpha();
+    for( int i = 0; i < sprites.size(); i++ )
+    {
+        Sprite &sprite = sprites.at( i );
+        if( sprite.layer != layer )
+        {
+            continue;
+        }
+
+        //Where the entity is between ticks
+        Entity entity = sprites.owner( i );
+        Position &position = positions.get( entity );
+        Collider &collider = colliders.get( entity );
+        SDL_Rect box;
+        box.x = (int)( position.prevX + ( position.x - position.prevX ) * alpha + 0.5 );
+        box.y = (int)( position.prevY + ( position.y - position.prevY ) * alpha + 0.5 );
+        box.w = collider.w;
+        box.h = collider.h;
+
+        //Skip it if the camera can't see it
+        if( check_collision( box, camera ) == false )
+        {
+            continue;
+        }
+
+        //Show it
+        if( ( sprite.surface != NULL ) && ( *sprite.surface != NULL ) )
+        {
+            apply_surface( box.x - camera.x, box.y - camera.y, *sprite.surface, screen );
+        }
+        else
+        {
+            box.x -= camera.x;
+            box.y -= camera.y;
+            SDL_FillRect( screen, &box, 0 );
+        }
+    }
+}
+
+Timer::Timer()
+{
+    //Initialize the variables
+    startCounts = 0;
+    pausedCounts = 0;
+    lapStart = 0;
+    lapCount = 0;
+    nextLap = 0;
+    paused = false;
+    started = false;
+}
+
+void Timer::start()
+{
+    //Start the timer
+    started = true;
+
+    //Unpause the timer
+    paused = false;
+
+    //Get the current counter value
+    startCounts = SDL_GetPerformanceCounter();
+
+    //Start over with the laps
+    lapStart = 0;
+    lapCount = 0;
+    nextLap = 0;
+}
+
+void Timer::stop()
+{
+    //Stop the timer
+    started = false;
+
+    //Unpause the timer
+    paused = false;
+
+    //Clear the counters so laps start over
+    startCounts = 0;
+    pausedCounts = 0;
+    lapStart = 0;
+}
+
+void Timer::pause()
+{
+    //If the timer is running and isn't already paused
+    if( ( started == true ) && ( paused == false ) )
+    {
+        //Pause the timer
+        paused = true;
+
+        //Calculate the paused counts
+        pausedCounts = SDL_GetPerformanceCounter() - startCounts;
+    }
+}
+
+void Timer::unpause()
+{
+    //If the timer is paused
+    if( paused == true )
+    {
+        //Unpause the timer
+        paused = false;
+
+        //Reset the starting counts
+        startCounts = SDL_GetPerformanceCounter() - pausedCounts;
+
+        //Reset the paused counts
+        pausedCounts = 0;
+    }
+}
+
+int Timer::get_ticks()
+{
+    return get_nanoseconds() / 1000000;
+}
+
+Uint64 Timer::get_nanoseconds()
+{
+    //If the timer is running
+    if( started == true )
+    {
+        //If the timer is paused
+        if( paused == true )
+        {
+            //Return the number of counts when the the timer was paused
+            return to_nanoseconds( pausedCounts );
+        }
+        else
+        {
+            //Return the current counter minus the start
+            return to_nanoseconds( SDL_GetPerformanceCounter() - startCounts );
+        }
+    }
+
+    //If the timer isn't running
+    return 0;
+}
+
+Uint64 Timer::lap()
+{
+    //Close the lap at the current time
+    Uint64 now = get_nanoseconds();
+    Uint64 length = now - lapStart;
+    lapStart = now;
+
+    //Store it over the oldest
+    laps[ nextLap ] = length;
+    nextLap = ( nextLap + 1 ) % ROLLING_LAPS;
+    if( lapCount < ROLLING_LAPS )
+    {
+        lapCount++;
+    }
+
+    return length;
+}
+
+Uint64 Timer::split()
+{
+    return get_nanoseconds() - lapStart;
+}
+
+int Timer::get_lap_count()
+{
+    return lapCount;
+}
+
+Uint64 Timer::get_lap_average()
+{
+    if( lapCount == 0 )
+    {
+        return 0;
+    }
+
+    Uint64 total = 0;
+    for( int i = 0; i < lapCount; i++ )
+    {
+        total += laps[ i ];
+    }
+
+    return total / lapCount;
+}
+
+Uint64 Timer::get_lap_min()
+{
+    if( lapCount == 0 )
+    {
+        return 0;
+    }
+
+    Uint64 shortest = laps[ 0 ];
+    for( int i = 1; i < lapCount; i++ )
+    {
+        if( laps[ i ] < shortest )
+        {
+            shortest = laps[ i ];
+        }
+    }
+
+    return shortest;
+}
+
+Uint64 Timer::get_lap_max()
+{
+    Uint64 longest = 0;
+    for( int i = 0; i < lapCount; i++ )
+    {
+        if( laps[ i ] > longest )
+        {
+            longest = laps[ i ];
+        }
+    }
+
+    return longest;
+}
+
+bool Timer::is_started()
+{
+    return started;
+}
+
+bool Timer::is_paused()
+{
+    return paused;
+}
+
+Uint64 Timer::to_nanoseconds( Uint64 counts )
+{
+    //Split the division so the multiply cannot overflow
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    return counts / frequency * 1000000000 + counts % frequency * 1000000000 / frequency;
+}
+
+FramePacer::FramePacer()
+{
+    //Initialize
+    periodCounts = 0;
+    spinCounts = 0;
+    startCounts = 0;
+    frames = 0;
+    totalError = 0;
+    maxError = 0;
+    pacedFrames = 0;
+    missedFrames = 0;
+}
+
+void FramePacer::start( double framesPerSecond )
+{
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    periodCounts = frequency / framesPerSecond;
+    spinCounts = SPIN_NANOSECONDS * frequency / 1000000000;
+    startCounts = SDL_GetPerformanceCounter();
+    frames = 0;
+}
+
+void FramePacer::wait()
+{
+    //When the next frame is due
+    frames++;
+    Uint64 deadline = startCounts + (Uint64)( frames * periodCounts );
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    //A frame that ran over a whole period restarts the schedule instead of rushing to catch up
+    if( now >= deadline )
+    {
+        missedFrames++;
+        record_error( now - deadline );
+        if( now - deadline > periodCounts )
+        {
+            startCounts = now;
+            frames = 0;
+        }
+        return;
+    }
+
+    //Sleep while the wake up can be late without missing the deadline
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    if( deadline - now > spinCounts )
+    {
+        SDL_Delay( ( deadline - now - spinCounts ) * 1000 / frequency );
+    }
+
+    //Spin out the rest
+    now = SDL_GetPerformanceCounter();
+    while( now < deadline )
+    {
+        now = SDL_GetPerformanceCounter();
+    }
+
+    //Track how late the frame was let go
+    record_error( now - deadline );
+}
+
+void FramePacer::record_error( Uint64 lateCounts )
+{
+    Uint64 error = Timer::to_nanoseconds( lateCounts );
+    totalError += error;
+    pacedFrames++;
+    if( error > maxError )
+    {
+        maxError = error;
+    }
+}
+
+Uint64 FramePacer::get_average_error()
+{
+    if( pacedFrames == 0 )
+    {
+        return 0;
+    }
+
+    return totalError / pacedFrames;
+}
+
+Uint64 FramePacer::get_max_error()
+{
+    return maxError;
+}
+
+Uint64 FramePacer::get_missed_frames()
+{
+    return missedFrames;
+}
+
+FixedTimestep::FixedTimestep()
+{
+    //Initialize
+    tickCounts = SDL_GetPerformanceFrequency() / TICKS_PER_SECOND;
+    lastCounts = 0;
+    accumulator = 0;
+    dropped = 0;
+}
+
+void FixedTimestep::start()
+{
+    lastCounts = SDL_GetPerformanceCounter();
+    accumulator = 0;
+}
+
+int FixedTimestep::advance()
+{
+    //Bank the time since the last frame
+    Uint64 now = SDL_GetPerformanceCounter();
+    accumulator += now - lastCounts;
+    lastCounts = now;
+
+    //Run the whole ticks that fit, keeping the remainder for the next frame
+    Uint64 ticks = accumulator / tickCounts;
+    if( ticks > MAX_TICKS_PER_FRAME )
+    {
+        //Too far behind to catch up, let the logic fall back instead
+        dropped += ticks - MAX_TICKS_PER_FRAME;
+        ticks = MAX_TICKS_PER_FRAME;
+        accumulator = accumulator % tickCounts + ticks * tickCounts;
+    }
+    accumulator -= ticks * tickCounts;
+
+    return (int)ticks;
+}
+
+double FixedTimestep::get_alpha()
+{
+    return (double)accumulator / tickCounts;
+}
+
+Uint64 FixedTimestep::get_dropped_ticks()
+{
+    return dropped;
+}
+
+Profiler::Profiler()
+{
+    //Initialize
+    enabled = false;
+    buffer = 0;
+    lock = NULL;
+    startCounts = 0;
+}
+
+Profiler::~Profiler()
+{
+    free();
+}
+
+bool Profiler::enable()
+{
+    //Get rid of a previous recording
+    free();
+
+    //Each recording gets its own thread slot so old buffers are never seen again
+    buffer = SDL_TLSCreate();
+    lock = SDL_CreateMutex();
+    if( ( buffer == 0 ) || ( lock == NULL ) )
+    {
+        free();
+        return false;
+    }
+
+    startCounts = SDL_GetPerformanceCounter();
+    enabled = true;
+    return true;
+}
+
+bool Profiler::is_enabled()
+{
+    return enabled;
+}
+
+void Profiler::name_thread( const char *name )
+{
+    if( enabled == true )
+    {
+        get_buffer()->name = name;
+    }
+}
+
+void Profiler::record( const char *name, Uint64 start, Uint64 end )
+{
+    ThreadBuffer *threadBuffer = get_buffer();
+    if( threadBuffer->events.size() >= (size_t)MAX_EVENTS )
+    {
+        threadBuffer->dropped++;
+        return;
+    }
+
+    Event event = { name, start, end };
+    threadBuffer->events.push_back( event );
+}
+
+Profiler::ThreadBuffer *Profiler::get_buffer()
+{
+    ThreadBuffer *threadBuffer = (ThreadBuffer*)SDL_TLSGet( buffer );
+    if( threadBuffer == NULL )
+    {
+        //First zone on this thread, only registering takes the lock
+        threadBuffer = new ThreadBuffer();
+        threadBuffer->dropped = 0;
+        SDL_LockMutex( lock );
+        threadBuffer->id = buffers.size();
+        buffers.push_back( threadBuffer );
+        SDL_UnlockMutex( lock );
+
+        char name[ 32 ];
+        snprintf( name, sizeof( name ), "Thread %d", threadBuffer->id );
+        threadBuffer->name = name;
+        SDL_TLSSet( buffer, threadBuffer, NULL );
+    }
+
+    return threadBuffer;
+}
+
+bool Profiler::write( std::string path )
+{
+    FILE *file = fopen( path.c_str(), "w" );
+    if( file == NULL )
+    {
+        return false;
+    }
+
+    //Complete events in microseconds, one track per thread
+    double microseconds = 1000000.0 / SDL_GetPerformanceFrequency();
+    fprintf( file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n" );
+    SDL_LockMutex( lock );
+    for( int i = 0; i < (int)buffers.size(); i++ )
+    {
+        ThreadBuffer *threadBuffer = buffers[ i ];
+        fprintf( file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                 i == 0 ? "" : ",\n", threadBuffer->id, threadBuffer->name.c_str() );
+        for( int j = 0; j < (int)threadBuffer->events.size(); j++ )
+        {
+            Event &event = threadBuffer->events[ j ];
+            fprintf( file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                     event.name, threadBuffer->id, ( event.start - startCounts ) * microseconds,
+                     ( event.end - event.start ) * microseconds );
+        }
+    }
+    SDL_UnlockMutex( lock );
+    fprintf( file, "\n]}\n" );
+
+    return fclose( file ) == 0;
+}
+
+void Profiler::free()
+{
+    enabled = false;
+    for( int i = 0; i < (int)buffers.size(); i++ )
+    {
+        delete buffers[ i ];
+    }
+    buffers.clear();
+
+    if( lock != NULL )
+    {
+        SDL_DestroyMutex( lock );
+        lock = NULL;
+    }
+    buffer = 0;
+}
+
+ProfileZone::ProfileZone( const char *zoneName )
+{
+    name = zoneName;
+    start = 0;
+    if( profiler.is_enabled() == true )
+    {
+        start = SDL_GetPerformanceCounter();
+    }
+}
+
+ProfileZone::~ProfileZone()
+{
+    if( start != 0 )
+    {
+        profiler.record( name, start, SDL_GetPerformanceCounter() );
+    }
+}
+
+AssetArchive::AssetArchive()
+{
+    //Initialize
+    data = NULL;
+    dataSize = 0;
+    mapped = false;
+}
+
+bool AssetArchive::load( std::string path )
+{
+    //Get rid of the old archive
+    free();
+
+#ifndef _WIN32
+    //Map the file
+    int file = ::open( path.c_str(), O_RDONLY );
+    if( file == -1 )
+    {
+        return false;
+    }
+    struct stat info;
+    if( ( fstat( file, &info ) == 0 ) && ( info.st_size > 0 ) )
+    {
+        void *view = mmap( NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0 );
+        if( view != MAP_FAILED )
+        {
+            data = (Uint8*)view;
+            dataSize = info.st_size;
+            mapped = true;
+        }
+    }
+    close( file );
+#else
+    //Read the file in
+    SDL_RWops *file = SDL_RWFromFile( path.c_str(), "rb" );
+    if( file == NULL )
+    {
+        return false;
+    }
+    Sint64 size = SDL_RWsize( file );
+    if( size > 0 )
+    {
+        data = (Uint8*)SDL_malloc( size );
+        if( ( data != NULL ) && ( SDL_RWread( file, data, size, 1 ) == 1 ) )
+        {
+            dataSize = size;
+        }
+    }
+    SDL_RWclose( file );
+#endif
+
+    //Check the header
+    Uint32 header[ 4 ];
+    Uint64 tocOffset = 0, tocSize = 0;
+    if( dataSize >= (Uint64)ARCHIVE_HEADER_SIZE )
+    {
+        memcpy( header, data, sizeof( header ) );
+        memcpy( &tocOffset, data + 16, 8 );
+        memcpy( &tocSize, data + 24, 8 );
+        tocOffset = SDL_SwapLE64( tocOffset );
+        tocSize = SDL_SwapLE64( tocSize );
+    }
+    if( ( dataSize < (Uint64)ARCHIVE_HEADER_SIZE ) || ( SDL_SwapLE32( header[ 0 ] ) != ARCHIVE_MAGIC ) ||
+        ( SDL_SwapLE32( header[ 1 ] ) != ARCHIVE_VERSION ) || ( tocOffset > dataSize ) || ( tocSize > dataSize - tocOffset ) )
+    {
+        printf( "%s is not an asset archive!\n", path.c_str() );
+        free();
+        return false;
+    }
+
+    //Read the TOC
+    Uint32 count = SDL_SwapLE32( header[ 2 ] );
+    const Uint8 *here = data + tocOffset;
+    const Uint8 *stop = here + tocSize;
+    entries.reserve( count );
+    for( Uint32 i = 0; i < count; i++ )
+    {
+        Entry entry;
+        Uint16 compression, nameLength;
+        if( stop - here < ARCHIVE_ENTRY_SIZE )
+        {
+            break;
+        }
+        memcpy( &entry.offset, here, 8 );
+        memcpy( &entry.storedSize, here + 8, 8 );
+        memcpy( &entry.size, here + 16, 8 );
+        memcpy( &entry.checksum, here + 24, 4 );
+        memcpy( &compression, here + 28, 2 );
+        memcpy( &nameLength, here + 30, 2 );
+        entry.offset = SDL_SwapLE64( entry.offset );
+        entry.storedSize = SDL_SwapLE64( entry.storedSize );
+        entry.size = SDL_SwapLE64( entry.size );
+        entry.checksum = SDL_SwapLE32( entry.checksum );
+        entry.compression = SDL_SwapLE16( compression );
+        nameLength = SDL_SwapLE16( nameLength );
+        here += ARCHIVE_ENTRY_SIZE;
+
+        //The entry has to fit in the file, and stored entries are streamed at their full size
+        if( ( stop - here < nameLength ) || ( entry.offset > dataSize ) || ( entry.storedSize > dataSize - entry.offset ) ||
+            ( ( entry.compression == COMPRESSION_NONE ) && ( entry.storedSize != entry.size ) ) )
+        {
+            break;
+        }
+        entry.name.assign( (const char*)here, nameLength );
+        here += nameLength;
+        entries.push_back( entry );
+    }
+
+    if( entries.size() != count )
+    {
+        printf( "%s has a damaged table of contents!\n", path.c_str() );
+        free();
+        return false;
+    }
+
+    return true;
+}
+
+AssetArchive::Entry *AssetArchive::find( std::string name )
+{
+    //Binary search the sorted TOC
+    int first = 0;
+    int last = (int)entries.size() - 1;
+    while( first <= last )
+    {
+        int middle = ( first + last ) / 2;
+        int order = entries[ middle ].name.compare( name );
+        if( order == 0 )
+        {
+            return &entries[ middle ];
+        }
+        else if( order < 0 )
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle - 1;
+        }
+    }
+
+    return NULL;
+}
+
+SDL_RWops *AssetArchive::open( std::string name )
+{
+    Entry *entry = find( name );
+    if( entry == NULL )
+    {
+        return NULL;
+    }
+
+    Stream *stream = new Stream;
+    stream->size = entry->size;
+    stream->position = 0;
+    stream->unpacked = NULL;
+
+    //Stored entries are read in place
+    if( entry->compression == COMPRESSION_NONE )
+    {
+        stream->base = data + entry->offset;
+    }
+    //Compressed ones are unpacked and checked
+    else
+    {
+        stream->unpacked = (Uint8*)SDL_malloc( entry->size > 0 ? entry->size : 1 );
+        if( ( stream->unpacked == NULL ) || ( entry->compression != COMPRESSION_LZ4 ) ||
+            ( unpack( data + entry->offset, entry->storedSize, stream->unpacked, entry->size ) == false ) ||
+            ( checksum( stream->unpacked, entry->size ) != entry->checksum ) )
+        {
+            printf( "Unable to unpack %s from the asset archive!\n", name.c_str() );
+            SDL_free( stream->unpacked );
+            delete stream;
+            return NULL;
+        }
+        stream->base = stream->unpacked;
+    }
+
+    SDL_RWops *rw = SDL_AllocRW();
+    if( rw == NULL )
+    {
+        SDL_free( stream->unpacked );
+        delete stream;
+        return NULL;
+    }
+    rw->size = stream_size;
+    rw->seek = stream_seek;
+    rw->read = stream_read;
+    rw->write = stream_write;
+    rw->close = stream_close;
+    rw->type = SDL_RWOPS_UNKNOWN;
+    rw->hidden.unknown.data1 = stream;
+    return rw;
+}
+
+bool AssetArchive::unpack( const Uint8 *source, Uint64 sourceSize, Uint8 *destination, Uint64 destinationSize )
+{
+    Uint64 in = 0;
+    Uint64 out = 0;
+    while( in < sourceSize )
+    {
+        //Literal run
+        Uint8 token = source[ in++ ];
+        Uint64 length = token >> 4;
+        if( length == 15 )
+        {
+            Uint8 more = 255;
+            while( ( more == 255 ) && ( in < sourceSize ) )
+            {
+                more = source[ in++ ];
+                length += more;
+            }
+        }
+        if( ( length > sourceSize - in ) || ( length > destinationSize - out ) )
+        {
+            return false;
+        }
+        memcpy( destination + out, source + in, length );
+        in += length;
+        out += length;
+
+        //The last sequence has no match
+        if( in == sourceSize )
+        {
+            break;
+        }
+
+        //Match, copied a byte at a time since it may overlap itself
+        if( sourceSize - in < 2 )
+        {
+            return false;
+        }
+        Uint64 offset = source[ in ] | ( source[ in + 1 ] << 8 );
+        in += 2;
+        length = token & 15;
+        if( length == 15 )
+        {
+            Uint8 more = 255;
+            while( ( more == 255 ) && ( in < sourceSize ) )
+            {
+                more = source[ in++ ];
+                length += more;
+            }
+        }
+        length += 4;
+        if( ( offset == 0 ) || ( offset > out ) || ( length > destinationSize - out ) )
+        {
+            return false;
+        }
+        for( Uint64 i = 0; i < length; i++ )
+        {
+            destination[ out + i ] = destination[ out + i - offset ];
+        }
+        out += length;
+    }
+
+    return out == destinationSize;
+}
+
+Uint32 AssetArchive::checksum( const Uint8 *bytes, Uint64 size )
+{
+    Uint32 hash = 2166136261u;
+    for( Uint64 i = 0; i < size; i++ )
+    {
+        hash ^= bytes[ i ];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+Sint64 AssetArchive::stream_size( SDL_RWops *rw )
+{
+    return ( (Stream*)rw->hidden.unknown.data1 )->size;
+}
+
+Sint64 AssetArchive::stream_seek( SDL_RWops *rw, Sint64 offset, int whence )
+{
+    Stream *stream = (Stream*)rw->hidden.unknown.data1;
+
+    //Find the new position
+    Sint64 position = offset;
+    if( whence == RW_SEEK_CUR )
+    {
+        position += stream->position;
+    }
+    else if( whence == RW_SEEK_END )
+    {
+        position += stream->size;
+    }
+    else if( whence != RW_SEEK_SET )
+    {
+        return SDL_SetError( "Unknown seek origin" );
+    }
+
+    //Stay inside the entry
+    if( position < 0 )
+    {
+        position = 0;
+    }
+    if( position > stream->size )
+    {
+        position = stream->size;
+    }
+
+    stream->position = position;
+    return position;
+}
 
-/*Class Definitions*/
-Dot::Dot()
+size_t AssetArchive::stream_read( SDL_RWops *rw, void *ptr, size_t size, size_t maxnum )
 {
-    //Initialize the offsets
-    init( 0, 0, 0, 0 );
+    Stream *stream = (Stream*)rw->hidden.unknown.data1;
+    if( size == 0 )
+    {
+        return 0;
+    }
 
-    //Set dot dimensions
-    box.w = DOT_WIDTH;
-    box.h = DOT_HEIGHT;
+    //Read whole objects up to the end of the entry
+    size_t count = ( stream->size - stream->position ) / size;
+    if( count > maxnum )
+    {
+        count = maxnum;
+    }
+    memcpy( ptr, stream->base + stream->position, count * size );
+    stream->position += count * size;
+    return count;
+}
 
-    //Initialize the velocity
-    xVel = 0;
-    yVel = 0;
+size_t AssetArchive::stream_write( SDL_RWops*, const void*, size_t, size_t )
+{
+    //Archives are read only
+    SDL_SetError( "Asset archive streams are read only" );
+    return 0;
 }
 
-void Dot::init( int x, int y, int lvlWidth, int lvlHeight )
+int AssetArchive::stream_close( SDL_RWops *rw )
 {
-    //Set dot position
-    box.x = x;
-    box.y = y;
+    Stream *stream = (Stream*)rw->hidden.unknown.data1;
+    SDL_free( stream->unpacked );
+    delete stream;
+    SDL_FreeRW( rw );
+    return 0;
+}
 
-    //Get level dimensions
-    curLvlWidth = lvlWidth;
-    curLvlHeight = lvlHeight;
+int AssetArchive::get_count()
+{
+    return entries.size();
 }
 
-void Dot::handle_input()
+void AssetArchive::free()
 {
-    //If a key was pressed
-    if( event.type == SDL_KEYDOWN )
+    entries.clear();
+    if( data != NULL )
     {
-        //Adjust the velocity
-        switch( event.key.keysym.sym )
+#ifndef _WIN32
+        if( mapped == true )
         {
-            case SDLK_UP: yVel -= DOT_HEIGHT / 2; break;
-            case SDLK_DOWN: yVel += DOT_HEIGHT / 2; break;
-            case SDLK_LEFT: xVel -= DOT_WIDTH / 2; break;
-            case SDLK_RIGHT: xVel += DOT_WIDTH / 2; break;
+            munmap( data, dataSize );
         }
-    }
-    //If a key was released
-    else if( event.type == SDL_KEYUP )
-    {
-        //Adjust the velocity
-        switch( event.key.keysym.sym )
+#endif
+        if( mapped == false )
         {
-            case SDLK_UP: yVel += DOT_HEIGHT / 2; break;
-            case SDLK_DOWN: yVel -= DOT_HEIGHT / 2; break;
-            case SDLK_LEFT: xVel += DOT_WIDTH / 2; break;
-            case SDLK_RIGHT: xVel -= DOT_WIDTH / 2; break;
+            SDL_free( data );
         }
+        data = NULL;
     }
+    dataSize = 0;
+    mapped = false;
 }
 
-void Dot::move()
+ImageLoader::ImageLoader()
 {
-    //Move the dot left or right
-    box.x += xVel;
+    //Initialize
+    thread = NULL;
+    lock = NULL;
+    wake = NULL;
+    quit = false;
+}
 
-    //If the dot went too far to the left or right
-    if( ( box.x < 0 ) || ( box.x + DOT_WIDTH > curLvlWidth ) )
+bool ImageLoader::start()
+{
+    lock = SDL_CreateMutex();
+    wake = SDL_CreateCond();
+    if( ( lock == NULL ) || ( wake == NULL ) )
     {
-        //move back
-        box.x -= xVel;
+        return false;
     }
 
-    //Move the dot up or down
-    box.y += yVel;
+    thread = SDL_CreateThread( decode_thread, "ImageLoader", this );
+    return thread != NULL;
+}
+
+void ImageLoader::request( std::string key, std::string filename )
+{
+    Job job;
+    job.key = key;
+    job.filename = filename;
+    job.image = NULL;
 
-    //If the dot went too far up or down
-    if( ( box.y < 0 ) || ( box.y + DOT_HEIGHT > curLvlHeight ) )
+    //Without a worker decode it now
+    if( thread == NULL )
     {
-        //move back
-        box.y -= yVel;
+        job.image = decode_image( filename );
+        decoded.push_back( job );
+        return;
     }
-}
 
-void Dot::show()
-{
-    //Show the dot
-    apply_surface( box.x - camera.x, box.y - camera.y, dot, screen );
+    //Hand it to the worker
+    SDL_LockMutex( lock );
+    waiting.push_back( job );
+    SDL_CondSignal( wake );
+    SDL_UnlockMutex( lock );
 }
 
-void Dot::set_camera()
+bool ImageLoader::collect( std::string &key, SDL_Surface *&image )
 {
-    //Center the camera over the dot
-    camera.x = ( box.x + DOT_WIDTH / 2 ) - SCREEN_WIDTH / 2;
-    camera.y = ( box.y + DOT_HEIGHT / 2 ) - SCREEN_HEIGHT / 2;
-
-    //Keep the camera in bounds.
-    if( camera.x < 0 )
-    {
-        camera.x = 0;
-    }
-    if( camera.y < 0 )
+    if( thread != NULL )
     {
-        camera.y = 0;
+        SDL_LockMutex( lock );
     }
-    if( camera.x > curLvlWidth - camera.w )
+
+    bool found = ( decoded.empty() == false );
+    if( found == true )
     {
-        camera.x = curLvlWidth - camera.w;
+        key = decoded.front().key;
+        image = decoded.front().image;
+        decoded.pop_front();
     }
-    if( camera.y > curLvlHeight - camera.h )
+
+    if( thread != NULL )
     {
-        camera.y = curLvlHeight - camera.h;
+        SDL_UnlockMutex( lock );
     }
-}
 
-Dot::operator SDL_Rect()
-{
-    return box;
+    return found;
 }
 
-House::House()
+int ImageLoader::decode_thread( void *data )
 {
-    //Initialize house collision box
-    box.x = 0;
-    box.y = 0;
-    box.w = HOUSE_WIDTH;
-    box.h = HOUSE_HEIGHT;
+    ImageLoader *loader = (ImageLoader*)data;
 
-    //Initialize house graphic
-    houseGFX = NULL;
-}
+    SDL_LockMutex( loader->lock );
+    while( true )
+    {
+        //Sleep until there is a job or a stop request
+        while( ( loader->waiting.empty() == true ) && ( loader->quit == false ) )
+        {
+            SDL_CondWait( loader->wake, loader->lock );
+        }
+        if( loader->quit == true )
+        {
+            break;
+        }
 
-House::~House()
-{
-    //Free the house graphic
-    SDL_FreeSurface( houseGFX );
+        Job job = loader->waiting.front();
+        loader->waiting.pop_front();
+        SDL_UnlockMutex( loader->lock );
+
+        //Decode without holding the lock
+        job.image = decode_image( job.filename );
+
+        //Pass it back
+        SDL_LockMutex( loader->lock );
+        loader->decoded.push_back( job );
+    }
+    SDL_UnlockMutex( loader->lock );
+
+    return 0;
 }
 
-void House::init( int x, int y, SDL_Surface *housePic )
+void ImageLoader::free()
 {
-    //Set house position
-    box.x = x;
-    box.y = y;
+    //Stop the worker, it finishes the job it's on
+    if( thread != NULL )
+    {
+        SDL_LockMutex( lock );
+        quit = true;
+        SDL_CondSignal( wake );
+        SDL_UnlockMutex( lock );
+        SDL_WaitThread( thread, NULL );
+        thread = NULL;
+    }
+    SDL_DestroyCond( wake );
+    SDL_DestroyMutex( lock );
+    wake = NULL;
+    lock = NULL;
 
-    //Get house graphic
-    houseGFX = housePic;
+    //Free what was decoded but never collected
+    for( int i = 0; i < (int)decoded.size(); i++ )
+    {
+        SDL_FreeSurface( decoded[ i ].image );
+    }
+    waiting.clear();
+    decoded.clear();
+    quit = false;
 }
 
-void House::show()
+ResourceCache::ResourceCache()
 {
-    //Show the house
-    apply_surface( box.x - camera.x, box.y - camera.y, houseGFX, screen );
+    //Initialize
+    budget = (Sint64)CACHE_BUDGET * 1024 * 1024;
+    totalBytes = 0;
+    useClock = 0;
 }
 
-House::operator SDL_Rect()
+ResourceCache::Resource *ResourceCache::get( std::string key )
 {
-    return box;
+    std::map<std::string, Resource>::iterator it = resources.find( key );
+    if( it == resources.end() )
+    {
+        return NULL;
+    }
+
+    //Take a use
+    it->second.refs++;
+    it->second.lastUsed = ++useClock;
+    return &it->second;
 }
 
-Door::Door()
+void ResourceCache::release( void *asset )
 {
-    //Initialize door collision box
-    box.x = 0;
-    box.y = 0;
-    box.w = DOOR_WIDTH;
-    box.h = DOOR_HEIGHT;
+    std::map<void*, std::string>::iterator key = keys.find( asset );
+    if( key == keys.end() )
+    {
+        return;
+    }
+
+    //Drop a use and let the budget decide whether it stays
+    Resource &resource = resources[ key->second ];
+    resource.refs--;
+    resource.lastUsed = ++useClock;
+    trim();
 }
 
-void Door::init( int x, int y )
+void ResourceCache::trim()
 {
-    //Set door position
-    box.x = x;
-    box.y = y;
+    //Keeping everything
+    if( budget < 0 )
+    {
+        return;
+    }
+
+    while( true )
+    {
+        //Add up the unused assets and find the oldest
+        Sint64 unusedBytes = 0;
+        bool hasUnused = false;
+        std::map<std::string, Resource>::iterator oldest = resources.end();
+        for( std::map<std::string, Resource>::iterator it = resources.begin(); it != resources.end(); ++it )
+        {
+            if( it->second.refs > 0 )
+            {
+                continue;
+            }
+
+            unusedBytes += it->second.bytes;
+            hasUnused = true;
+            if( ( oldest == resources.end() ) || ( it->second.lastUsed < oldest->second.lastUsed ) )
+            {
+                oldest = it;
+            }
+        }
+
+        //Stop when they fit, a budget of 0 keeps nothing unused
+        if( ( hasUnused == false ) || ( ( budget > 0 ) && ( unusedBytes <= budget ) ) )
+        {
+            return;
+        }
+
+        destroy( oldest );
+    }
 }
 
-void Door::show()
+void ResourceCache::destroy( std::map<std::string, Resource>::iterator it )
 {
-    //Show the door
-    SDL_FillRect( screen, &box, 0 );
+    if( it->second.image != NULL )
+    {
+        keys.erase( it->second.image );
+        SDL_FreeSurface( it->second.image );
+    }
+    if( it->second.font != NULL )
+    {
+        keys.erase( it->second.font );
+        TTF_CloseFont( it->second.font );
+    }
+
+    totalBytes -= it->second.bytes;
+    resources.erase( it );
 }
 
-Door::operator SDL_Rect()
+void ResourceCache::set_budget( Sint64 bytes )
 {
-    return box;
+    budget = bytes;
+    trim();
 }
 
-Timer::Timer()
+bool ResourceCache::start()
 {
-    //Initialize the variables
-    startTicks = 0;
-    pausedTicks = 0;
-    paused = false;
-    started = false;
+    return loader.start();
 }
 
-void Timer::start()
+std::string ResourceCache::image_key( std::string filename, bool colorKey )
 {
-    //Start the timer
-    started = true;
-
-    //Unpause the timer
-    paused = false;
-
-    //Get the current clock time
-    startTicks = SDL_GetTicks();
+    return "image:" + filename + ( colorKey == true ? ":key" : "" );
 }
 
-void Timer::stop()
+void ResourceCache::insert_image( std::string key, SDL_Surface *image, int refs )
 {
-    //Stop the timer
-    started = false;
+    Resource resource;
+    resource.image = image;
+    resource.font = NULL;
+    resource.bytes = image->pitch * image->h;
+    resource.refs = refs;
+    resource.lastUsed = ++useClock;
+    resources[ key ] = resource;
+    keys[ image ] = key;
+    totalBytes += resource.bytes;
 
-    //Unpause the timer
-    paused = false;
+    //Make room for it
+    trim();
 }
 
-void Timer::pause()
+SDL_Surface *ResourceCache::get_image( std::string filename, bool colorKey )
 {
-    //If the timer is running and isn't already paused
-    if( ( started == true ) && ( paused == false ) )
+    //Use the loaded copy if there is one
+    std::string key = image_key( filename, colorKey );
+    Resource *cached = get( key );
+    if( cached != NULL )
     {
-        //Pause the timer
-        paused = true;
+        return cached->image;
+    }
 
-        //Calculate the paused ticks
-        pausedTicks = SDL_GetTicks() - startTicks;
+    //Load it
+    SDL_Surface *image = load_image( filename, colorKey );
+    if( image == NULL )
+    {
+        return NULL;
     }
+
+    insert_image( key, image, 1 );
+    return image;
 }
 
-void Timer::unpause()
+void ResourceCache::request_image( std::string filename, SDL_Surface **target, bool colorKey )
 {
-    //If the timer is paused
-    if( paused == true )
+    //Use the loaded copy if there is one
+    std::string key = image_key( filename, colorKey );
+    Resource *cached = get( key );
+    if( cached != NULL )
     {
-        //Unpause the timer
-        paused = false;
-
-        //Reset the starting ticks
-        startTicks = SDL_GetTicks() - pausedTicks;
+        *target = cached->image;
+        return;
+    }
 
-        //Reset the paused ticks
-        pausedTicks = 0;
+    //Wait for it, decoding it only once however many ask
+    *target = NULL;
+    std::map<std::string, Request>::iterator it = pending.find( key );
+    if( it == pending.end() )
+    {
+        Request &request = pending[ key ];
+        request.colorKey = colorKey;
+        request.targets.push_back( target );
+        loader.request( key, filename );
+    }
+    else
+    {
+        it->second.targets.push_back( target );
     }
 }
 
-int Timer::get_ticks()
+void ResourceCache::update( Uint64 budget )
 {
-    //If the timer is running
-    if( started == true )
+    //Finish images until the budget is spent, an image that is too big still goes through
+    Uint64 start = SDL_GetPerformanceCounter();
+    std::string key;
+    SDL_Surface *loadedImage = NULL;
+    while( ( Timer::to_nanoseconds( SDL_GetPerformanceCounter() - start ) < budget ) && ( loader.collect( key, loadedImage ) == true ) )
     {
-        //If the timer is paused
-        if( paused == true )
+        std::map<std::string, Request>::iterator it = pending.find( key );
+        if( it == pending.end() )
         {
-            //Return the number of ticks when the the timer was paused
-            return pausedTicks;
+            SDL_FreeSurface( loadedImage );
+            continue;
         }
-        else
+        Request request = it->second;
+        pending.erase( it );
+
+        //A get_image while it was decoding already loaded it
+        if( resources.find( key ) != resources.end() )
         {
-            //Return the current time minus the start time
-            return SDL_GetTicks() - startTicks;
+            SDL_FreeSurface( loadedImage );
+            for( int i = 0; i < (int)request.targets.size(); i++ )
+            {
+                *request.targets[ i ] = get( key )->image;
+            }
+            continue;
+        }
+
+        //Convert it here, the screen format belongs to this thread
+        SDL_Surface *image = NULL;
+        if( loadedImage != NULL )
+        {
+            image = optimize_image( loadedImage, request.colorKey );
+        }
+        if( image == NULL )
+        {
+            printf( "Unable to load %s!\n", key.c_str() );
+            continue;
+        }
+
+        //Take a use for each target and hand it over
+        insert_image( key, image, request.targets.size() );
+        for( int i = 0; i < (int)request.targets.size(); i++ )
+        {
+            *request.targets[ i ] = image;
         }
     }
+}
 
-    //If the timer isn't running
-    return 0;
+bool ResourceCache::is_loading()
+{
+    return pending.empty() == false;
 }
 
-bool Timer::is_started()
+TTF_Font *ResourceCache::get_font( std::string filename, int size )
 {
-    return started;
+    //Use the opened copy if there is one
+    char sizeText[ 16 ];
+    sprintf( sizeText, ":%d", size );
+    std::string key = "font:" + filename + sizeText;
+    Resource *cached = get( key );
+    if( cached != NULL )
+    {
+        return cached->font;
+    }
+
+    //Open it, from the archive if it has it
+    TTF_Font *font = NULL;
+    SDL_RWops *rw = archive.open( filename );
+    if( rw != NULL )
+    {
+        font = TTF_OpenFontRW( rw, 1, size );
+    }
+    else
+    {
+        font = TTF_OpenFont( filename.c_str(), size );
+    }
+    if( font == NULL )
+    {
+        return NULL;
+    }
+
+    //Glyphs are rendered as needed, the font itself counts as nothing
+    Resource resource;
+    resource.image = NULL;
+    resource.font = font;
+    resource.bytes = 0;
+    resource.refs = 1;
+    resource.lastUsed = ++useClock;
+    resources[ key ] = resource;
+    keys[ font ] = key;
+
+    return font;
 }
 
-bool Timer::is_paused()
+void ResourceCache::release_image( SDL_Surface *image )
 {
-    return paused;
+    release( image );
+}
+
+void ResourceCache::release_font( TTF_Font *font )
+{
+    release( font );
+}
+
+int ResourceCache::get_count()
+{
+    return resources.size();
+}
+
+Sint64 ResourceCache::get_bytes()
+{
+    return totalBytes;
+}
+
+void ResourceCache::free()
+{
+    //Stop decoding, targets still waiting stay NULL
+    loader.free();
+    pending.clear();
+
+    while( resources.empty() == false )
+    {
+        destroy( resources.begin() );
+    }
 }
 
 Intro::Intro()
+{
+    //Initialize
+    background = NULL;
+    message = NULL;
+}
+
+void Intro::load()
 {
     //Load the background
-    background = load_image( "introbg.png" );
+    resources.request_image( "introbg.png", &background );
 
     //Render the intro message
     message = TTF_RenderText_Solid( font, "Lazy Foo' Productions Presents...", textColor );
 }
 
-Intro::~Intro()
+void Intro::free()
 {
     //Free the surfaces
-    SDL_FreeSurface( background );
+    resources.release_image( background );
     SDL_FreeSurface( message );
 }
 
@@ -660,18 +2642,25 @@ void Intro::render()
 }
 
 Title::Title()
+{
+    //Initialize
+    background = NULL;
+    message = NULL;
+}
+
+void Title::load()
 {
     //Load the background
-    background = load_image( "titlebg.png" );
+    resources.request_image( "titlebg.png", &background );
 
     //Render the title message
     message = TTF_RenderText_Solid( font, "A State Machine Demo.", textColor );
 }
 
-Title::~Title()
+void Title::free()
 {
     //Free surfaces
-    SDL_FreeSurface( background );
+    resources.release_image( background );
     SDL_FreeSurface( message );
 }
 
@@ -709,39 +2698,89 @@ void Title::render()
     apply_surface( ( SCREEN_WIDTH - message->w ) / 2, ( SCREEN_HEIGHT - message->h ) / 2, message, screen );
 }
 
-OverWorld::OverWorld( int prevState )
+OverWorld::OverWorld()
+{
+    //Initialize
+    background = NULL;
+    redHouseGFX = NULL;
+    blueHouseGFX = NULL;
+    redHouse = 0;
+    blueHouse = 0;
+}
+
+void OverWorld::load()
 {
     //Load the background
-    background = load_image( "greenoverworld.png" );
+    resources.request_image( "greenoverworld.png", &background );
+
+    //Load the houses
+    resources.request_image( "red.bmp", &redHouseGFX );
+    resources.request_image( "blue.bmp", &blueHouseGFX );
+}
 
+void OverWorld::enter( int prevState )
+{
     //Set the houses
-    redHouse.init( 0, 0, load_image( "red.bmp" ) );
-    blueHouse.init( 1240, 920, load_image( "blue.bmp" ) );
+    redHouse = world.create();
+    world.add_position( redHouse, 0, 0 );
+    world.add_collider( redHouse, HOUSE_WIDTH, HOUSE_HEIGHT );
+    world.add_sprite( redHouse, &redHouseGFX, LAYER_SCENERY );
+    blueHouse = world.create();
+    world.add_position( blueHouse, 1240, 920 );
+    world.add_collider( blueHouse, HOUSE_WIDTH, HOUSE_HEIGHT );
+    world.add_sprite( blueHouse, &blueHouseGFX, LAYER_SCENERY );
+
+    //Scatter the wandering dots
+    world.set_level( LEVEL_WIDTH, LEVEL_HEIGHT );
+    for( int i = 0; i < wanderingDots; i++ )
+    {
+        Entity wanderer = world.create();
+        world.add_position( wanderer, rand() % ( LEVEL_WIDTH - DOT_WIDTH ), rand() % ( LEVEL_HEIGHT - DOT_HEIGHT ) );
+        world.add_velocity( wanderer, rand() % 5 - 2, rand() % 5 - 2, true );
+        world.add_collider( wanderer, DOT_WIDTH, DOT_HEIGHT );
+        world.add_sprite( wanderer, &dot, LAYER_ACTORS );
+        wanderers.push_back( wanderer );
+    }
+    world.sort();
 
     //If the last state was the red room
     if( prevState == STATE_RED_ROOM )
     {
         //Show up in front of the red house
-        myDot.init( 10, 40, LEVEL_WIDTH, LEVEL_HEIGHT );
+        world.add_position( player, 10, 40 );
     }
     //If the last state was the blue room
     else if( prevState == STATE_BLUE_ROOM )
     {
         //Show up in front of the blue house
-        myDot.init( 1250, 900, LEVEL_WIDTH, LEVEL_HEIGHT );
+        world.add_position( player, 1250, 900 );
     }
     //If the last state was something else
     else
     {
         //Show up in the center of the overworld
-        myDot.init( 630, 470, LEVEL_WIDTH, LEVEL_HEIGHT );
+        world.add_position( player, 630, 470 );
+    }
+}
+
+void OverWorld::leave()
+{
+    //Remove the overworld's entities
+    world.destroy( redHouse );
+    world.destroy( blueHouse );
+    for( int i = 0; i < (int)wanderers.size(); i++ )
+    {
+        world.destroy( wanderers[ i ] );
     }
+    wanderers.clear();
 }
 
-OverWorld::~OverWorld()
+void OverWorld::free()
 {
     //Free the resources
-    SDL_FreeSurface( background );
+    resources.release_image( background );
+    resources.release_image( redHouseGFX );
+    resources.release_image( blueHouseGFX );
 }
 
 void OverWorld::handle_events()
@@ -750,7 +2789,7 @@ void OverWorld::handle_events()
     while( SDL_PollEvent( &event ) )
     {
         //Handle events for the dot
-        myDot.handle_input();
+        handle_player_input();
 
         //If the user has Xed out the window
         if( event.type == SDL_QUIT )
@@ -758,69 +2797,183 @@ void OverWorld::handle_events()
             //Quit the program
             set_next_state( STATE_EXIT );
         }
+        //If the user pressed escape
+        else if( ( event.type == SDL_KEYDOWN ) && ( event.key.keysym.sym == SDLK_ESCAPE ) )
+        {
+            //Pause the game
+            push_state( STATE_PAUSED );
+        }
     }
 }
 
 void OverWorld::logic()
 {
     //If the dot touches the red house
-    if( check_collision( myDot, redHouse ) == true )
+    if( check_collision( world.get_box( player ), world.get_box( redHouse ) ) == true )
     {
         //Move to the red room
         set_next_state( STATE_RED_ROOM );
     }
     //If the dot touches the blue house
-    else if( check_collision( myDot, blueHouse ) == true )
+    else if( check_collision( world.get_box( player ), world.get_box( blueHouse ) ) == true )
+    {
+        //Move to the blue room
+        set_next_state( STATE_BLUE_ROOM );
+    }
+
+    //Move the dots
+    world.move_all();
+}
+
+void OverWorld::render()
+{
+    //Set the camera
+    set_camera();
+
+    //Show the background
+    apply_surface( 0, 0, background, screen, &camera );
+
+    //Show the rooms
+    world.show_all( LAYER_SCENERY );
+
+    //Show the dots on the screen
+    world.show_all( LAYER_ACTORS );
+}
+
+RedRoom::RedRoom()
+{
+    //Initialize
+    background = NULL;
+    exit = 0;
+}
+
+void RedRoom::load()
+{
+    //Load the background
+    resources.request_image( "redroom.png", &background );
+}
+
+void RedRoom::enter( int )
+{
+    //Set the exit
+    exit = world.create();
+    world.add_position( exit, 310, 440 );
+    world.add_collider( exit, DOOR_WIDTH, DOOR_HEIGHT );
+    world.add_sprite( exit, NULL, LAYER_SCENERY );
+
+    //Set the dot
+    world.set_level( LEVEL_WIDTH, LEVEL_HEIGHT );
+    world.add_position( player, 310, 420 );
+}
+
+void RedRoom::leave()
+{
+    //Remove the door
+    world.destroy( exit );
+}
+
+void RedRoom::free()
+{
+    //Free the background
+    resources.release_image( background );
+}
+
+void RedRoom::handle_events()
+{
+    //While there's events to handle
+    while( SDL_PollEvent( &event ) )
+    {
+        //Handle events for the dot
+        handle_player_input();
+
+        //If the user has Xed out the window
+        if( event.type == SDL_QUIT )
+        {
+            //Quit the program
+            set_next_state( STATE_EXIT );
+        }
+        //If the user pressed escape
+        else if( ( event.type == SDL_KEYDOWN ) && ( event.key.keysym.sym == SDLK_ESCAPE ) )
+        {
+            //Pause the game
+            push_state( STATE_PAUSED );
+        }
+    }
+}
+
+void RedRoom::logic()
+{
+    //If the dot went to the exit
+    if( check_collision( world.get_box( player ), world.get_box( exit ) ) == true )
     {
-        //Move to the blue room
-        set_next_state( STATE_BLUE_ROOM );
+        //Go to the overworld
+        set_next_state( STATE_GREEN_OVERWORLD );
     }
 
     //Move the dot
-    myDot.move();
+    world.move_all();
 }
 
-void OverWorld::render()
+void RedRoom::render()
 {
     //Set the camera
-    myDot.set_camera();
+    set_camera();
 
     //Show the background
     apply_surface( 0, 0, background, screen, &camera );
 
-    //Show the rooms
-    redHouse.show();
-    blueHouse.show();
+    //Show the door
+    world.show_all( LAYER_SCENERY );
 
     //Show the dot on the screen
-    myDot.show();
+    world.show_all( LAYER_ACTORS );
 }
 
-RedRoom::RedRoom()
+BlueRoom::BlueRoom()
+{
+    //Initialize
+    background = NULL;
+    exit = 0;
+}
+
+void BlueRoom::load()
 {
     //Load the background
-    background = load_image( "redroom.png" );
+    resources.request_image( "blueroom.png", &background );
+}
 
+void BlueRoom::enter( int )
+{
     //Set the exit
-    exit.init( 310, 440 );
+    exit = world.create();
+    world.add_position( exit, 310, 0 );
+    world.add_collider( exit, DOOR_WIDTH, DOOR_HEIGHT );
+    world.add_sprite( exit, NULL, LAYER_SCENERY );
 
     //Set the dot
-    myDot.init( 310, 420, LEVEL_WIDTH, LEVEL_HEIGHT );
+    world.set_level( LEVEL_WIDTH, LEVEL_HEIGHT );
+    world.add_position( player, 310, 40 );
 }
 
-RedRoom::~RedRoom()
+void BlueRoom::leave()
+{
+    //Remove the door
+    world.destroy( exit );
+}
+
+void BlueRoom::free()
 {
     //Free the background
-    SDL_FreeSurface( background );
+    resources.release_image( background );
 }
 
-void RedRoom::handle_events()
+void BlueRoom::handle_events()
 {
     //While there's events to handle
     while( SDL_PollEvent( &event ) )
     {
         //Handle events for the dot
-        myDot.handle_input();
+        handle_player_input();
 
         //If the user has Xed out the window
         if( event.type == SDL_QUIT )
@@ -828,62 +2981,73 @@ void RedRoom::handle_events()
             //Quit the program
             set_next_state( STATE_EXIT );
         }
+        //If the user pressed escape
+        else if( ( event.type == SDL_KEYDOWN ) && ( event.key.keysym.sym == SDLK_ESCAPE ) )
+        {
+            //Pause the game
+            push_state( STATE_PAUSED );
+        }
     }
 }
 
-void RedRoom::logic()
+void BlueRoom::logic()
 {
     //If the dot went to the exit
-    if( check_collision( myDot, exit ) == true )
+    if( check_collision( world.get_box( player ), world.get_box( exit ) ) == true )
     {
         //Go to the overworld
         set_next_state( STATE_GREEN_OVERWORLD );
     }
 
     //Move the dot
-    myDot.move();
+    world.move_all();
 }
 
-void RedRoom::render()
+void BlueRoom::render()
 {
     //Set the camera
-    myDot.set_camera();
+    set_camera();
 
     //Show the background
     apply_surface( 0, 0, background, screen, &camera );
 
     //Show the door
-    exit.show();
+    world.show_all( LAYER_SCENERY );
 
     //Show the dot on the screen
-    myDot.show();
+    world.show_all( LAYER_ACTORS );
 }
 
-BlueRoom::BlueRoom()
+Paused::Paused()
 {
-    //Load the background
-    background = load_image( "blueroom.png" );
+    //Initialize
+    message = NULL;
+}
 
-    //Set the exit
-    exit.init( 310, 0 );
+void Paused::load()
+{
+    //Render the pause message
+    message = TTF_RenderText_Solid( font, "Paused", textColor );
+}
 
-    //Set the dot
-    myDot.init( 310, 40, LEVEL_WIDTH, LEVEL_HEIGHT );
+void Paused::free()
+{
+    //Free the surface
+    SDL_FreeSurface( message );
 }
 
-BlueRoom::~BlueRoom()
+bool Paused::is_overlay()
 {
-    //Free the background
-    SDL_FreeSurface( background );
+    return true;
 }
 
-void BlueRoom::handle_events()
+void Paused::handle_events()
 {
     //While there's events to handle
     while( SDL_PollEvent( &event ) )
     {
-        //Handle events for the dot
-        myDot.handle_input();
+        //Keep following the arrow keys so the dot doesn't drift after unpausing
+        handle_player_input();
 
         //If the user has Xed out the window
         if( event.type == SDL_QUIT )
@@ -891,64 +3055,253 @@ void BlueRoom::handle_events()
             //Quit the program
             set_next_state( STATE_EXIT );
         }
+        //If the user pressed escape or enter
+        else if( ( event.type == SDL_KEYDOWN ) && ( ( event.key.keysym.sym == SDLK_ESCAPE ) || ( event.key.keysym.sym == SDLK_RETURN ) ) )
+        {
+            //Go back to the game
+            pop_state();
+        }
     }
 }
 
-void BlueRoom::logic()
+void Paused::logic()
 {
-    //If the dot went to the exit
-    if( check_collision( myDot, exit ) == true )
+
+}
+
+void Paused::render()
+{
+    //Show the message
+    apply_surface( ( SCREEN_WIDTH - message->w ) / 2, ( SCREEN_HEIGHT - message->h ) / 2, message, screen );
+}
+
+StateManager::StateManager()
+{
+    //Index the states
+    pool[ STATE_NULL ] = NULL;
+    pool[ STATE_INTRO ] = &intro;
+    pool[ STATE_TITLE ] = &title;
+    pool[ STATE_GREEN_OVERWORLD ] = &overWorld;
+    pool[ STATE_RED_ROOM ] = &redRoom;
+    pool[ STATE_BLUE_ROOM ] = &blueRoom;
+    pool[ STATE_PAUSED ] = &paused;
+
+    //Nothing is loaded yet
+    for( int i = 0; i < STATE_EXIT; i++ )
     {
-        //Go to the overworld
-        set_next_state( STATE_GREEN_OVERWORLD );
+        loaded[ i ] = false;
     }
 
-    //Move the dot
-    myDot.move();
+    //Initialize
+    depth = 0;
+    nextState = STATE_NULL;
+    nextAction = ACTION_NONE;
+    exiting = false;
 }
 
-void BlueRoom::render()
+void StateManager::enter( int id, int prevState )
 {
-    //Set the camera
-    myDot.set_camera();
+    //Load the state the first time it's used, without waiting for its images
+    if( loaded[ id ] == false )
+    {
+        pool[ id ]->load();
+        loaded[ id ] = true;
+    }
 
-    //Show the background
-    apply_surface( 0, 0, background, screen, &camera );
+    //Put it on top
+    pool[ id ]->enter( prevState );
+    stack[ depth ] = id;
+    depth++;
+}
 
-    //Show the door
-    exit.show();
+void StateManager::set_next( int id )
+{
+    //If the user doesn't want to exit
+    if( nextState != STATE_EXIT )
+    {
+        //Set the next state
+        nextState = id;
+        nextAction = ACTION_CHANGE;
+    }
+}
 
-    //Show the dot on the screen
-    myDot.show();
+void StateManager::push( int id )
+{
+    //If the user doesn't want to exit
+    if( nextState != STATE_EXIT )
+    {
+        //Stack the next state
+        nextState = id;
+        nextAction = ACTION_PUSH;
+    }
 }
 
-SDL_Surface *load_image( std::string filename )
+void StateManager::pop()
 {
-    //The image that's loaded
-    SDL_Surface* loadedImage = NULL;
+    //If the user doesn't want to exit
+    if( nextState != STATE_EXIT )
+    {
+        //Unstack the current state
+        nextState = STATE_NULL;
+        nextAction = ACTION_POP;
+    }
+}
 
-    //The optimized surface that will be used
-    SDL_Surface* optimizedImage = NULL;
+void StateManager::change()
+{
+    //The state being left
+    int prevState = get_id();
 
-    //Load the image
-    loadedImage = IMG_Load( filename.c_str() );
+    switch( nextAction )
+    {
+        case ACTION_CHANGE:
+            //If the user quit
+            if( nextState == STATE_EXIT )
+            {
+                exiting = true;
+                break;
+            }
+
+            //Swap the top state, its assets stay loaded for the next visit
+            if( depth > 0 )
+            {
+                pool[ prevState ]->leave();
+                depth--;
+            }
+            enter( nextState, prevState );
+            break;
+
+        case ACTION_PUSH:
+            //Stack the state over the current one
+            if( depth < MAX_STATE_DEPTH )
+            {
+                //The world stops ticking underneath, so stop it between ticks too or it jitters
+                world.stop_all();
+                enter( nextState, prevState );
+            }
+            break;
+
+        case ACTION_POP:
+            //Go back to the state underneath
+            if( depth > 1 )
+            {
+                pool[ prevState ]->leave();
+                depth--;
+            }
+            break;
+    }
 
-    //If the image loaded
-    if( loadedImage != NULL )
+    //Clear the request
+    nextState = STATE_NULL;
+    nextAction = ACTION_NONE;
+}
+
+int StateManager::get_id()
+{
+    if( exiting == true )
+    {
+        return STATE_EXIT;
+    }
+
+    if( depth == 0 )
+    {
+        return STATE_NULL;
+    }
+
+    return stack[ depth - 1 ];
+}
+
+GameState *StateManager::get_current()
+{
+    return pool[ stack[ depth - 1 ] ];
+}
+
+void StateManager::render()
+{
+    //Find the lowest state that shows through the overlays
+    int bottom = depth - 1;
+    while( ( bottom > 0 ) && ( pool[ stack[ bottom ] ]->is_overlay() == true ) )
+    {
+        bottom--;
+    }
+
+    //Cover the screen while images are on their way
+    if( resources.is_loading() == true )
+    {
+        apply_surface( 0, 0, placeholder, screen );
+    }
+
+    //Show from the bottom up
+    for( int i = bottom; i < depth; i++ )
     {
-        //Create an optimized surface
-      optimizedImage = SDL_ConvertSurfaceFormat( loadedImage, &screen->format, NULL );
+        pool[ stack[ i ] ]->render();
+    }
+}
 
-        //Free the old surface
-        SDL_FreeSurface( loadedImage );
+void StateManager::free()
+{
+    //Leave the stacked states
+    while( depth > 0 )
+    {
+        depth--;
+        pool[ stack[ depth ] ]->leave();
+    }
 
-        //If the surface was optimized
-        if( optimizedImage != NULL )
+    //Free everything that was loaded
+    for( int i = 0; i < STATE_EXIT; i++ )
+    {
+        if( loaded[ i ] == true )
         {
-            //Color key surface
-            SDL_SetColorKey( optimizedImage, SDL_TRUE, SDL_MapRGB( optimizedImage->format, 0, 0xFF, 0xFF ) );
+            pool[ i ]->free();
+            loaded[ i ] = false;
         }
     }
+}
+
+SDL_Surface *load_image( std::string filename, bool colorKey )
+{
+    //The image that's loaded
+    SDL_Surface* loadedImage = decode_image( filename );
+
+    //If the image loaded
+    if( loadedImage != NULL )
+    {
+        //Return the optimized surface
+        return optimize_image( loadedImage, colorKey );
+    }
+
+    return NULL;
+}
+
+SDL_Surface *decode_image( std::string filename )
+{
+    //Load the image, from the archive if it has it
+    SDL_RWops *rw = archive.open( filename );
+    if( rw != NULL )
+    {
+        return IMG_Load_RW( rw, 1 );
+    }
+
+    return IMG_Load( filename.c_str() );
+}
+
+SDL_Surface *optimize_image( SDL_Surface *loadedImage, bool colorKey )
+{
+    //The optimized surface that will be used
+    SDL_Surface* optimizedImage = NULL;
+
+    //Create an optimized surface
+  optimizedImage = SDL_ConvertSurfaceFormat( loadedImage, &screen->format, NULL );
+
+    //Free the old surface
+    SDL_FreeSurface( loadedImage );
+
+    //If the surface was optimized
+    if( ( optimizedImage != NULL ) && ( colorKey == true ) )
+    {
+        //Color key surface
+        SDL_SetColorKey( optimizedImage, SDL_TRUE, SDL_MapRGB( optimizedImage->format, 0, 0xFF, 0xFF ) );
+    }
 
     //Return the optimized surface
     return optimizedImage;
@@ -956,6 +3309,12 @@ SDL_Surface *load_image( std::string filename )
 
 void apply_surface( int x, int y, SDL_Surface* source, SDL_Surface* destination, SDL_Rect* clip )
 {
+    //Images still loading are NULL
+    if( source == NULL )
+    {
+        return;
+    }
+
     //Holds offsets
     SDL_Rect offset;
 
@@ -1045,7 +3404,7 @@ bool init()
 bool load_files()
 {
     //Load the dot image
-    dot = load_image( "dot.bmp" );
+    dot = resources.get_image( "dot.bmp" );
 
     //If there was a problem in loading the dot
     if( dot == NULL )
@@ -1053,8 +3412,25 @@ bool load_files()
         return false;
     }
 
+    //Make the placeholder
+    placeholder = SDL_CreateRGBSurface( SDL_SWSURFACE, SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_BPP, 0, 0, 0, 0 );
+
+    //If there was a problem in making the placeholder
+    if( placeholder == NULL )
+    {
+        return false;
+    }
+    SDL_FillRect( placeholder, NULL, SDL_MapRGB( placeholder->format, 0x80, 0x80, 0x80 ) );
+
+    //Make the player's dot
+    player = world.create();
+    world.add_position( player, 0, 0 );
+    world.add_velocity( player, 0, 0, false );
+    world.add_collider( player, DOT_WIDTH, DOT_HEIGHT );
+    world.add_sprite( player, &dot, LAYER_ACTORS );
+
     //Open the font
-    font = TTF_OpenFont( "lazy.ttf", 36 );
+    font = resources.get_font( "lazy.ttf", 36 );
 
     //If there was an error in loading the font
     if( font == NULL )
@@ -1068,14 +3444,19 @@ bool load_files()
 
 void clean_up()
 {
-    //Delete game state and free state resources
-    delete currentState;
+    //Leave the game states and free state resources
+    states.free();
 
-    //Free the surfaces
-    SDL_FreeSurface( dot );
+    //Give back the dot and the font
+    resources.release_image( dot );
+    resources.release_font( font );
 
-    //Close the font that was used
-    TTF_CloseFont( font );
+    //Stop loading, free the surfaces and the font
+    resources.free();
+    SDL_FreeSurface( placeholder );
+
+    //Unmap the archive the font was reading from
+    archive.free();
 
     //Quit SDL_ttf
     TTF_Quit();
@@ -1084,59 +3465,128 @@ void clean_up()
     SDL_Quit();
 }
 
-void set_next_state( int newState )
+void handle_player_input()
 {
-    //If the user doesn't want to exit
-    if( nextState != STATE_EXIT )
+    Velocity &velocity = world.get_velocity( player );
+
+    //If a key was pressed
+    if( event.type == SDL_KEYDOWN )
     {
-        //Set the next state
-        nextState = newState;
+        //Adjust the velocity
+        switch( event.key.keysym.sym )
+        {
+            case SDLK_UP: velocity.y -= DOT_VEL; break;
+            case SDLK_DOWN: velocity.y += DOT_VEL; break;
+            case SDLK_LEFT: velocity.x -= DOT_VEL; break;
+            case SDLK_RIGHT: velocity.x += DOT_VEL; break;
+        }
     }
-}
-
-void change_state()
-{
-    //If the state needs to be changed
-    if( nextState != STATE_NULL )
+    //If a key was released
+    else if( event.type == SDL_KEYUP )
     {
-        //Delete the current state
-        if( nextState != STATE_EXIT )
+        //Adjust the velocity
+        switch( event.key.keysym.sym )
         {
-            delete currentState;
+            case SDLK_UP: velocity.y += DOT_VEL; break;
+            case SDLK_DOWN: velocity.y -= DOT_VEL; break;
+            case SDLK_LEFT: velocity.x += DOT_VEL; break;
+            case SDLK_RIGHT: velocity.x -= DOT_VEL; break;
         }
+    }
+}
 
-        //Change the state
-        switch( nextState )
-        {
-            case STATE_TITLE:
-                currentState = new Title();
-                break;
+void set_camera()
+{
+    //Center the camera over the dot
+    camera.x = ( world.get_render_x( player ) + DOT_WIDTH / 2 ) - SCREEN_WIDTH / 2;
+    camera.y = ( world.get_render_y( player ) + DOT_HEIGHT / 2 ) - SCREEN_HEIGHT / 2;
 
-            case STATE_GREEN_OVERWORLD:
-                currentState = new OverWorld( stateID );
-                break;
+    //Keep the camera in bounds.
+    if( camera.x < 0 )
+    {
+        camera.x = 0;
+    }
+    if( camera.y < 0 )
+    {
+        camera.y = 0;
+    }
+    if( camera.x > world.get_level_width() - camera.w )
+    {
+        camera.x = world.get_level_width() - camera.w;
+    }
+    if( camera.y > world.get_level_height() - camera.h )
+    {
+        camera.y = world.get_level_height() - camera.h;
+    }
+}
 
-            case STATE_RED_ROOM:
-                currentState = new RedRoom();
-                break;
+void set_next_state( int newState )
+{
+    states.set_next( newState );
+}
 
-            case STATE_BLUE_ROOM:
-                currentState = new BlueRoom();
-                break;
-        }
+void push_state( int newState )
+{
+    states.push( newState );
+}
 
-        //Change the current state ID
-        stateID = nextState;
+void pop_state()
+{
+    states.pop();
+}
 
-        //NULL the next state ID
-        nextState = STATE_NULL;
-    }
+void change_state()
+{
+    //If the state needs to be changed
+    states.change();
 }
 
 int main( int argc, char* args[] )
 {
     //The frame rate regulator
-    Timer fps;
+    FramePacer pacer;
+    double framesPerSecond = FRAMES_PER_SECOND;
+
+    //Laps once per frame for the frame time statistics
+    Timer frameTimer;
+
+    //Where to write a frame trace
+    std::string tracePath;
+
+    //Where the packed assets are
+    std::string archivePath = ARCHIVE_PATH;
+
+    //Parse command line
+    for( int i = 1; i < argc; i++ )
+    {
+        if( ( strcmp( args[ i ], "--trace" ) == 0 ) && ( i + 1 < argc ) )
+        {
+            tracePath = args[ ++i ];
+        }
+        else if( ( strcmp( args[ i ], "--archive" ) == 0 ) && ( i + 1 < argc ) )
+        {
+            archivePath = args[ ++i ];
+        }
+        else if( ( strcmp( args[ i ], "--cache-budget" ) == 0 ) && ( i + 1 < argc ) )
+        {
+            //Work in 64 bits so budgets of 2048 megabytes and up don't overflow
+            Sint64 megabytes = atoi( args[ ++i ] );
+            resources.set_budget( megabytes < 0 ? -1 : megabytes * 1024 * 1024 );
+        }
+        else if( ( strcmp( args[ i ], "--dots" ) == 0 ) && ( i + 1 < argc ) )
+        {
+            wanderingDots = atoi( args[ ++i ] );
+        }
+        else if( ( strcmp( args[ i ], "--fps" ) == 0 ) && ( i + 1 < argc ) )
+        {
+            framesPerSecond = atof( args[ ++i ] );
+            if( framesPerSecond <= 0 )
+            {
+                printf( "Invalid frame rate, using %d\n", FRAMES_PER_SECOND );
+                framesPerSecond = FRAMES_PER_SECOND;
+            }
+        }
+    }
 
     //Initialize
     if( init() == false )
@@ -1144,47 +3594,111 @@ int main( int argc, char* args[] )
         return 1;
     }
 
+    //Open the packed assets, anything not in them loads from loose files
+    archive.load( archivePath );
+
+    //Decode state images in the background, or as they're asked for if there's no thread
+    if( resources.start() == false )
+    {
+        printf( "Unable to start the image loader, images will load as states need them\n" );
+    }
+
     //Load the files
     if( load_files() == false )
     {
         return 1;
     }
 
-    //Set the current state ID
-    stateID = STATE_INTRO;
+    //Start at the intro
+    set_next_state( STATE_INTRO );
+    change_state();
+
+    //Record where frame time goes
+    if( ( tracePath.empty() == false ) && ( profiler.enable() == true ) )
+    {
+        profiler.name_thread( "Main" );
+    }
 
-    //Set the current game state object
-    currentState = new Intro();
+    //Start the logic clock and the frame schedule
+    timestep.start();
+    pacer.start( framesPerSecond );
+    frameTimer.start();
 
     //While the user hasn't quit
-    while( stateID != STATE_EXIT )
+    while( states.get_id() != STATE_EXIT )
     {
-        //Start the frame timer
-        fps.start();
+        ProfileZone frameZone( "Frame" );
 
         //Do state event handling
-        currentState->handle_events();
+        {
+            ProfileZone zone( "handle_events" );
+            states.get_current()->handle_events();
+        }
 
-        //Do state logic
-        currentState->logic();
+        //Do state logic once for every tick that passed, changing state as it asks
+        {
+            ProfileZone zone( "logic" );
+            int ticks = timestep.advance();
+            for( int i = 0; ( i < ticks ) && ( states.get_id() != STATE_EXIT ); i++ )
+            {
+                states.get_current()->logic();
+                change_state();
+            }
+        }
+
+        //Change state if events asked to
+        {
+            ProfileZone zone( "change_state" );
+            change_state();
+        }
 
-        //Change state if needed
-        change_state();
+        //Take in images that finished decoding
+        {
+            ProfileZone zone( "load_images" );
+            resources.update( UPLOAD_NANOSECONDS );
+        }
 
         //Do state rendering
-        currentState->render();
+        {
+            ProfileZone zone( "render" );
+            states.render();
+        }
 
         //Update the screen
-        if( SDL_Flip( screen ) == -1 )
         {
-            return 1;
+            ProfileZone zone( "Flip" );
+            if( SDL_Flip( screen ) == -1 )
+            {
+                return 1;
+            }
         }
 
         //Cap the frame rate
-        if( fps.get_ticks() < 1000 / FRAMES_PER_SECOND )
         {
-            SDL_Delay( ( 1000 / FRAMES_PER_SECOND ) - fps.get_ticks() );
+            ProfileZone zone( "Cap" );
+            pacer.wait();
+        }
+
+        //Close the frame
+        frameTimer.lap();
+    }
+
+    //Report how steady the frame rate was
+    printf( "Frame pacing error: average %.3f ms, worst %.3f ms, %lu frames late\n",
+            pacer.get_average_error() / 1000000.0, pacer.get_max_error() / 1000000.0,
+            (unsigned long)pacer.get_missed_frames() );
+    printf( "Frame time over the last %d frames: average %.3f ms, shortest %.3f ms, longest %.3f ms\n",
+            frameTimer.get_lap_count(), frameTimer.get_lap_average() / 1000000.0,
+            frameTimer.get_lap_min() / 1000000.0, frameTimer.get_lap_max() / 1000000.0 );
+
+    //Write the trace
+    if( profiler.is_enabled() == true )
+    {
+        if( profiler.write( tracePath ) == false )
+        {
+            printf( "Unable to write %s!\n", tracePath.c_str() );
         }
+        profiler.free();
     }
 
     //Clean up
@@ -5,10 +5,31 @@
 #include <stdio.h>
 #include <string>
 #include <cmath>
+#include <vector>
+#include <deque>
+#include <cstring>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 const int SCREEN_HEIGHT = 480;
 const int SCREEN_WIDTH  = 640;
 
+//Time the main thread may spend uploading decoded images each frame, in nanoseconds
+const Uint64 UPLOAD_BUDGET = 2000000;
+
+//Packed assets read before loose files
+const char *ARCHIVE_PATH = "assets.pak";
+
+//Asset archive layout, see assetPack
+const Uint32 ARCHIVE_MAGIC       = 0x4B41504C;
+const Uint32 ARCHIVE_VERSION     = 1;
+const int    ARCHIVE_HEADER_SIZE = 32;
+const int    ARCHIVE_ENTRY_SIZE  = 32;
+
 //Texture wrapper class
 class LTexture {
 public:
@@ -21,6 +42,12 @@ public:
   //Loads image at specified path
   bool loadFromFile(std::string path);
 
+  //Creates texture from a surface, the surface is left for the caller to free
+  bool loadFromSurface(SDL_Surface *surface);
+
+  //Creates a checkerboard to show while the real image loads
+  bool loadPlaceholder(int width, int height);
+
   #ifdef _SDL_TTF_H
   //Creates image from font string
   bool loadFromRendererdText(std::string textureText, SDL_Color textColor);
@@ -60,8 +87,187 @@ SDL_Window *g_window = NULL;
 //The window renderer
 SDL_Renderer *g_renderer = NULL;
 
+//Archive entry compression
+enum LArchiveCompression {
+  COMPRESSION_NONE,
+  COMPRESSION_LZ4
+};
+
+//Serves assets out of one memory mapped archive made by assetPack.
+//Streams can be opened from any thread once the archive is loaded
+class LAssetArchive {
+public:
+  //Initializes variables
+  LAssetArchive();
+
+  //Unmaps the archive
+  ~LAssetArchive();
+
+  //Maps an archive, false if it's missing or damaged
+  bool loadFromFile(std::string path);
+
+  //Opens an entry as a stream, NULL if the archive doesn't have it
+  SDL_RWops *open(std::string name);
+
+  //Gets how many files are packed
+  int getCount();
+
+  //Unmaps the archive, close streams over it first
+  void free();
+
+private:
+  //A packed file
+  struct Entry {
+    std::string name;
+    Uint64 offset;
+    Uint64 storedSize;
+    Uint64 size;
+    Uint32 checksum;
+    int compression;
+  };
+
+  //Where an open stream is in its entry
+  struct Stream {
+    const Uint8 *base;
+    Sint64 size;
+    Sint64 position;
+
+    //Unpacked copy of a compressed entry, freed with the stream
+    Uint8 *unpacked;
+  };
+
+  //Finds an entry
+  Entry *find(std::string name);
+
+  //Unpacks an LZ4 block, false if it is damaged
+  static bool unpack(const Uint8 *source, Uint64 sourceSize, Uint8 *destination, Uint64 destinationSize);
+
+  //FNV-1a hash of unpacked bytes
+  static Uint32 checksum(const Uint8 *bytes, Uint64 size);
+
+  //Stream callbacks
+  static Sint64 streamSize(SDL_RWops *rw);
+  static Sint64 streamSeek(SDL_RWops *rw, Sint64 offset, int whence);
+  static size_t streamRead(SDL_RWops *rw, void *ptr, size_t size, size_t maxnum);
+  static size_t streamWrite(SDL_RWops *rw, const void *ptr, size_t size, size_t num);
+  static int streamClose(SDL_RWops *rw);
+
+  //The archive's bytes
+  Uint8 *m_data;
+  Uint64 m_size;
+  bool m_mapped;
+
+  //The TOC, sorted by name
+  std::vector<Entry> m_entries;
+};
+
+//States of a queued asset
+enum LAssetState {
+  ASSET_QUEUED,
+  ASSET_DECODED,
+  ASSET_READY,
+  ASSET_FAILED
+};
+
+//Identifies a queued asset
+typedef int LAssetHandle;
+
+//Loads assets without blocking frames. Worker threads decode images and sounds,
+//then the main thread uploads decoded images to textures within a time budget
+class LAssetLoader {
+public:
+  //Initializes variables
+  LAssetLoader();
+
+  //Stops the workers
+  ~LAssetLoader();
+
+  //Starts the decode threads, 0 uses one less than the CPU count
+  bool start(int threads = 0);
+
+  //Queues an image, the texture stays empty until the image is uploaded
+  LAssetHandle loadImage(std::string path, LTexture *texture);
+
+  //Queues a sound, the chunk stays NULL until the sound is decoded
+  LAssetHandle loadSound(std::string path, Mix_Chunk **chunk);
+
+  //Hands over decoded assets until the budget in nanoseconds runs out,
+  //decodes them too if there are no workers. Returns how many finished
+  int update(Uint64 budget);
+
+  //Gets the state of a queued asset
+  LAssetState getState(LAssetHandle handle);
+
+  //Checks if every queued asset has finished
+  bool isDone();
+
+  //Gets how many assets were queued and how many finished
+  int getCount();
+  int getFinished();
+
+  //Stops the workers and frees assets that were not handed over
+  void free();
+
+private:
+  //Asset types
+  enum {
+    REQUEST_IMAGE,
+    REQUEST_SOUND
+  };
+
+  //A queued asset
+  struct Request {
+    int type;
+    std::string path;
+    LAssetState state;
+
+    //Where the asset goes
+    LTexture *texture;
+    Mix_Chunk **chunk;
+
+    //The decoded asset waiting for the main thread
+    SDL_Surface *surface;
+    Mix_Chunk *decoded;
+  };
+
+  //Decodes queued assets until stopped
+  static int decodeThread(void *data);
+
+  //Loads a request from disk, safe off the main thread
+  static void decode(Request *request);
+
+  //Adds a request to the decode queue
+  LAssetHandle queue(Request *request);
+
+  //The workers and their lock
+  std::vector<SDL_Thread*> m_threads;
+  SDL_mutex *m_lock;
+  SDL_cond *m_requestQueued;
+
+  //Every request by handle, the ones waiting to decode and the ones waiting to be handed over
+  std::vector<Request*> m_requests;
+  std::deque<Request*> m_queued;
+  std::deque<Request*> m_decoded;
+
+  //Finished requests
+  int m_finished;
+
+  //Stop flag
+  bool m_quit;
+};
+
+//Packed assets
+LAssetArchive g_archive;
+
 LTexture g_texture;
 
+//Shown until the prompt is uploaded
+LTexture g_placeholder;
+
+//Loads the media in the background
+LAssetLoader g_loader;
+LAssetHandle g_textureHandle = -1;
+
 //The music that will be played
 Mix_Music *g_music = NULL;
 
@@ -118,6 +324,44 @@ bool LTexture::loadFromFile(std::string path) {
   return m_texture != NULL;
 }
 
+bool LTexture::loadFromSurface(SDL_Surface *surface) {
+  //Get rid of preexisting texture
+  free();
+
+  //Create texture from surface pixels
+  m_texture = SDL_CreateTextureFromSurface(g_renderer, surface);
+  if(m_texture == NULL) {
+    printf("Unable to create texture from surface! SDL Error: %s\n", SDL_GetError());
+  } else {
+    //Get image dimensions
+    m_width  = surface->w;
+    m_height = surface->h;
+  }
+  return m_texture != NULL;
+}
+
+bool LTexture::loadPlaceholder(int width, int height) {
+  SDL_Surface *surface = SDL_CreateRGBSurface(0, width, height, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+  if(surface == NULL) {
+    printf("Unable to create placeholder surface! SDL Error: %s\n", SDL_GetError());
+    return false;
+  }
+
+  //Grey and white squares
+  const int SQUARE = 16;
+  for(int y = 0; y < height; y += SQUARE) {
+    for(int x = 0; x < width; x += SQUARE) {
+      SDL_Rect square = {x, y, SQUARE, SQUARE};
+      Uint8 shade = ((x + y) / SQUARE) % 2 == 0 ? 0xC0 : 0xFF;
+      SDL_FillRect(surface, &square, SDL_MapRGBA(surface->format, shade, shade, shade, 0xFF));
+    }
+  }
+
+  bool success = loadFromSurface(surface);
+  SDL_FreeSurface(surface);
+  return success;
+}
+
 #ifdef _SDL_TTF_H
 bool LTexture::loadFromRendererdText(std::string textureText, SDL_Color textColor) {
   bool success = true;
@@ -195,48 +439,612 @@ void LTexture::setAlpha(Uint8 alpha) {
   SDL_SetTextureAlphaMod(m_texture, alpha);
 }
 
-bool loadMedia() {
-  //Loading success flag
-  bool success = true;
+LAssetArchive::LAssetArchive() {
+  //Initialize
+  m_data   = NULL;
+  m_size   = 0;
+  m_mapped = false;
+}
 
-  //Load prompt texture
-  if(!g_texture.loadFromFile("prompt.png")) {
-    printf("Failed to load texture!\n");
-    success = false;
+LAssetArchive::~LAssetArchive() {
+  //Deallocate
+  free();
+}
+
+bool LAssetArchive::loadFromFile(std::string path) {
+  //Get rid of preexisting archive
+  free();
+
+#ifndef _WIN32
+  //Map the file
+  int file = ::open(path.c_str(), O_RDONLY);
+  if(file == -1) {
+    return false;
+  }
+  struct stat info;
+  if(fstat(file, &info) == 0 && info.st_size > 0) {
+    void *view = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    if(view != MAP_FAILED) {
+      m_data   = (Uint8*)view;
+      m_size   = info.st_size;
+      m_mapped = true;
+    }
+  }
+  close(file);
+#else
+  //Read the file in
+  SDL_RWops *file = SDL_RWFromFile(path.c_str(), "rb");
+  if(file == NULL) {
+    return false;
   }
+  Sint64 size = SDL_RWsize(file);
+  if(size > 0) {
+    m_data = (Uint8*)SDL_malloc(size);
+    if(m_data != NULL && SDL_RWread(file, m_data, size, 1) == 1) {
+      m_size = size;
+    }
+  }
+  SDL_RWclose(file);
+#endif
 
-  //Load music
-  g_music = Mix_LoadMUS("beat.wav");
-  if(g_music == NULL) {
-    printf("Failed to load beat music! SDL_mixer Error: %s\n", Mix_GetError());
-    success = false;
+  //Check the header
+  Uint32 header[4];
+  Uint64 tocOffset = 0, tocSize = 0;
+  if(m_size >= (Uint64)ARCHIVE_HEADER_SIZE) {
+    memcpy(header, m_data, sizeof(header));
+    memcpy(&tocOffset, m_data + 16, 8);
+    memcpy(&tocSize, m_data + 24, 8);
+    tocOffset = SDL_SwapLE64(tocOffset);
+    tocSize   = SDL_SwapLE64(tocSize);
+  }
+  if(m_size < (Uint64)ARCHIVE_HEADER_SIZE || SDL_SwapLE32(header[0]) != ARCHIVE_MAGIC ||
+     SDL_SwapLE32(header[1]) != ARCHIVE_VERSION || tocOffset > m_size || tocSize > m_size - tocOffset) {
+    printf("%s is not an asset archive!\n", path.c_str());
+    free();
+    return false;
   }
 
-  //Load sound effects
-  g_scratch = Mix_LoadWAV("scratch.wav");
-  if(g_scratch == NULL) {
-    printf("Failed to load scratch sound effect! SDL_mixer Error: %s\n", Mix_GetError());
-    success = false;
+  //Read the TOC
+  Uint32 count = SDL_SwapLE32(header[2]);
+  const Uint8 *here = m_data + tocOffset;
+  const Uint8 *stop = here + tocSize;
+  m_entries.reserve(count);
+  for(Uint32 i = 0; i < count; ++i) {
+    Entry entry;
+    Uint16 compression, nameLength;
+    if(stop - here < ARCHIVE_ENTRY_SIZE) {
+      break;
+    }
+    memcpy(&entry.offset, here, 8);
+    memcpy(&entry.storedSize, here + 8, 8);
+    memcpy(&entry.size, here + 16, 8);
+    memcpy(&entry.checksum, here + 24, 4);
+    memcpy(&compression, here + 28, 2);
+    memcpy(&nameLength, here + 30, 2);
+    entry.offset      = SDL_SwapLE64(entry.offset);
+    entry.storedSize  = SDL_SwapLE64(entry.storedSize);
+    entry.size        = SDL_SwapLE64(entry.size);
+    entry.checksum    = SDL_SwapLE32(entry.checksum);
+    entry.compression = SDL_SwapLE16(compression);
+    nameLength        = SDL_SwapLE16(nameLength);
+    here += ARCHIVE_ENTRY_SIZE;
+
+    //The entry has to fit in the file, and stored entries are streamed at their full size
+    if(stop - here < nameLength || entry.offset > m_size || entry.storedSize > m_size - entry.offset ||
+       (entry.compression == COMPRESSION_NONE && entry.storedSize != entry.size)) {
+      break;
+    }
+    entry.name.assign((const char*)here, nameLength);
+    here += nameLength;
+    m_entries.push_back(entry);
   }
 
-  g_high = Mix_LoadWAV("high.wav");
-  if(g_high == NULL) {
-    printf("Failed to load high sound effect! SDL_mixer Error: %s\n", Mix_GetError());
-    success = false;
+  if(m_entries.size() != count) {
+    printf("%s has a damaged table of contents!\n", path.c_str());
+    free();
+    return false;
+  }
+  return true;
+}
+
+LAssetArchive::Entry *LAssetArchive::find(std::string name) {
+  //Binary search the sorted TOC
+  int first = 0;
+  int last  = (int)m_entries.size() - 1;
+  while(first <= last) {
+    int middle = (first + last) / 2;
+    int order  = m_entries[middle].name.compare(name);
+    if(order == 0) {
+      return &m_entries[middle];
+    } else if(order < 0) {
+      first = middle + 1;
+    } else {
+      last = middle - 1;
+    }
+  }
+  return NULL;
+}
+
+SDL_RWops *LAssetArchive::open(std::string name) {
+  Entry *entry = find(name);
+  if(entry == NULL) {
+    return NULL;
+  }
+
+  Stream *stream   = new Stream;
+  stream->size     = entry->size;
+  stream->position = 0;
+  stream->unpacked = NULL;
+
+  if(entry->compression == COMPRESSION_NONE) {
+    //Stored entries are read in place
+    stream->base = m_data + entry->offset;
+  } else {
+    //Compressed ones are unpacked and checked
+    stream->unpacked = (Uint8*)SDL_malloc(entry->size > 0 ? entry->size : 1);
+    if(stream->unpacked == NULL || entry->compression != COMPRESSION_LZ4 ||
+       !unpack(m_data + entry->offset, entry->storedSize, stream->unpacked, entry->size) ||
+       checksum(stream->unpacked, entry->size) != entry->checksum) {
+      printf("Unable to unpack %s from the asset archive!\n", name.c_str());
+      SDL_free(stream->unpacked);
+      delete stream;
+      return NULL;
+    }
+    stream->base = stream->unpacked;
   }
 
-  g_medium = Mix_LoadWAV("medium.wav");
-  if(g_medium == NULL) {
-    printf("Failed to load medium sound effect! SDL_mixer Error: %s\n", Mix_GetError());
+  SDL_RWops *rw = SDL_AllocRW();
+  if(rw == NULL) {
+    SDL_free(stream->unpacked);
+    delete stream;
+    return NULL;
+  }
+  rw->size  = streamSize;
+  rw->seek  = streamSeek;
+  rw->read  = streamRead;
+  rw->write = streamWrite;
+  rw->close = streamClose;
+  rw->type  = SDL_RWOPS_UNKNOWN;
+  rw->hidden.unknown.data1 = stream;
+  return rw;
+}
+
+bool LAssetArchive::unpack(const Uint8 *source, Uint64 sourceSize, Uint8 *destination, Uint64 destinationSize) {
+  Uint64 in  = 0;
+  Uint64 out = 0;
+  while(in < sourceSize) {
+    //Literal run
+    Uint8 token   = source[in++];
+    Uint64 length = token >> 4;
+    if(length == 15) {
+      Uint8 more = 255;
+      while(more == 255 && in < sourceSize) {
+        more    = source[in++];
+        length += more;
+      }
+    }
+    if(length > sourceSize - in || length > destinationSize - out) {
+      return false;
+    }
+    memcpy(destination + out, source + in, length);
+    in  += length;
+    out += length;
+
+    //The last sequence has no match
+    if(in == sourceSize) {
+      break;
+    }
+
+    //Match, copied a byte at a time since it may overlap itself
+    if(sourceSize - in < 2) {
+      return false;
+    }
+    Uint64 offset = source[in] | (source[in + 1] << 8);
+    in += 2;
+    length = token & 15;
+    if(length == 15) {
+      Uint8 more = 255;
+      while(more == 255 && in < sourceSize) {
+        more    = source[in++];
+        length += more;
+      }
+    }
+    length += 4;
+    if(offset == 0 || offset > out || length > destinationSize - out) {
+      return false;
+    }
+    for(Uint64 i = 0; i < length; ++i) {
+      destination[out + i] = destination[out + i - offset];
+    }
+    out += length;
+  }
+  return out == destinationSize;
+}
+
+Uint32 LAssetArchive::checksum(const Uint8 *bytes, Uint64 size) {
+  Uint32 hash = 2166136261u;
+  for(Uint64 i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+Sint64 LAssetArchive::streamSize(SDL_RWops *rw) {
+  return ((Stream*)rw->hidden.unknown.data1)->size;
+}
+
+Sint64 LAssetArchive::streamSeek(SDL_RWops *rw, Sint64 offset, int whence) {
+  Stream *stream = (Stream*)rw->hidden.unknown.data1;
+
+  //Find the new position
+  Sint64 position = offset;
+  if(whence == RW_SEEK_CUR) {
+    position += stream->position;
+  } else if(whence == RW_SEEK_END) {
+    position += stream->size;
+  } else if(whence != RW_SEEK_SET) {
+    return SDL_SetError("Unknown seek origin");
+  }
+
+  //Stay inside the entry
+  if(position < 0) {
+    position = 0;
+  }
+  if(position > stream->size) {
+    position = stream->size;
+  }
+  stream->position = position;
+  return position;
+}
+
+size_t LAssetArchive::streamRead(SDL_RWops *rw, void *ptr, size_t size, size_t maxnum) {
+  Stream *stream = (Stream*)rw->hidden.unknown.data1;
+  if(size == 0) {
+    return 0;
+  }
+
+  //Read whole objects up to the end of the entry
+  size_t count = (stream->size - stream->position) / size;
+  if(count > maxnum) {
+    count = maxnum;
+  }
+  memcpy(ptr, stream->base + stream->position, count * size);
+  stream->position += count * size;
+  return count;
+}
+
+size_t LAssetArchive::streamWrite(SDL_RWops*, const void*, size_t, size_t) {
+  //Archives are read only
+  SDL_SetError("Asset archive streams are read only");
+  return 0;
+}
+
+int LAssetArchive::streamClose(SDL_RWops *rw) {
+  Stream *stream = (Stream*)rw->hidden.unknown.data1;
+  SDL_free(stream->unpacked);
+  delete stream;
+  SDL_FreeRW(rw);
+  return 0;
+}
+
+int LAssetArchive::getCount() {
+  return m_entries.size();
+}
+
+void LAssetArchive::free() {
+  m_entries.clear();
+  if(m_data != NULL) {
+#ifndef _WIN32
+    if(m_mapped) {
+      munmap(m_data, m_size);
+    }
+#endif
+    if(!m_mapped) {
+      SDL_free(m_data);
+    }
+    m_data = NULL;
+  }
+  m_size   = 0;
+  m_mapped = false;
+}
+
+LAssetLoader::LAssetLoader() {
+  //Initialize
+  m_lock          = NULL;
+  m_requestQueued = NULL;
+  m_finished      = 0;
+  m_quit          = false;
+}
+
+LAssetLoader::~LAssetLoader() {
+  //Deallocate
+  free();
+}
+
+bool LAssetLoader::start(int threads) {
+  //Get rid of preexisting workers
+  free();
+
+  //Leave a core for the main thread
+  if(threads <= 0) {
+    threads = SDL_GetCPUCount() - 1;
+    if(threads < 1) {
+      threads = 1;
+    }
+  }
+
+  m_quit          = false;
+  m_lock          = SDL_CreateMutex();
+  m_requestQueued = SDL_CreateCond();
+  for(int i = 0; i < threads; ++i) {
+    SDL_Thread *thread = SDL_CreateThread(decodeThread, "AssetDecoder", this);
+    if(thread == NULL) {
+      printf("Asset decoder could not be created! SDL Error: %s\n", SDL_GetError());
+      break;
+    }
+    m_threads.push_back(thread);
+  }
+  return !m_threads.empty();
+}
+
+LAssetHandle LAssetLoader::loadImage(std::string path, LTexture *texture) {
+  Request *request = new Request();
+  request->type    = REQUEST_IMAGE;
+  request->path    = path;
+  request->texture = texture;
+  request->chunk   = NULL;
+  return queue(request);
+}
+
+LAssetHandle LAssetLoader::loadSound(std::string path, Mix_Chunk **chunk) {
+  Request *request = new Request();
+  request->type    = REQUEST_SOUND;
+  request->path    = path;
+  request->texture = NULL;
+  request->chunk   = chunk;
+  return queue(request);
+}
+
+LAssetHandle LAssetLoader::queue(Request *request) {
+  request->state   = ASSET_QUEUED;
+  request->surface = NULL;
+  request->decoded = NULL;
+
+  //Without workers update() decodes it
+  if(m_lock == NULL) {
+    m_lock = SDL_CreateMutex();
+  }
+
+  SDL_LockMutex(m_lock);
+  LAssetHandle handle = m_requests.size();
+  m_requests.push_back(request);
+  m_queued.push_back(request);
+  if(m_requestQueued != NULL) {
+    SDL_CondSignal(m_requestQueued);
+  }
+  SDL_UnlockMutex(m_lock);
+  return handle;
+}
+
+int LAssetLoader::update(Uint64 budget) {
+  if(m_lock == NULL) {
+    return 0;
+  }
+
+  Uint64 start  = SDL_GetPerformanceCounter();
+  Uint64 counts = budget * SDL_GetPerformanceFrequency() / 1000000000;
+  int finished  = 0;
+
+  //Always hand over one asset so loading can't stall
+  do {
+    //Take the next decoded asset
+    Request *request = NULL;
+    SDL_LockMutex(m_lock);
+    if(!m_decoded.empty()) {
+      request = m_decoded.front();
+      m_decoded.pop_front();
+    } else if(m_threads.empty() && !m_queued.empty()) {
+      request = m_queued.front();
+      m_queued.pop_front();
+    }
+    SDL_UnlockMutex(m_lock);
+    if(request == NULL) {
+      break;
+    }
+
+    //Decode it here if there is no one else to
+    if(request->state == ASSET_QUEUED) {
+      decode(request);
+    }
+
+    //Hand it over
+    LAssetState state = ASSET_FAILED;
+    if(request->type == REQUEST_IMAGE) {
+      if(request->surface != NULL) {
+        if(request->texture->loadFromSurface(request->surface)) {
+          state = ASSET_READY;
+        }
+        SDL_FreeSurface(request->surface);
+        request->surface = NULL;
+      }
+    } else if(request->decoded != NULL) {
+      *request->chunk  = request->decoded;
+      request->decoded = NULL;
+      state = ASSET_READY;
+    }
+
+    SDL_LockMutex(m_lock);
+    request->state = state;
+    ++m_finished;
+    SDL_UnlockMutex(m_lock);
+    ++finished;
+  } while(SDL_GetPerformanceCounter() - start < counts);
+
+  return finished;
+}
+
+LAssetState LAssetLoader::getState(LAssetHandle handle) {
+  if(m_lock == NULL || handle < 0) {
+    return ASSET_FAILED;
+  }
+
+  LAssetState state = ASSET_FAILED;
+  SDL_LockMutex(m_lock);
+  if(handle < (int)m_requests.size()) {
+    state = m_requests[handle]->state;
+  }
+  SDL_UnlockMutex(m_lock);
+  return state;
+}
+
+bool LAssetLoader::isDone() {
+  return getFinished() == getCount();
+}
+
+int LAssetLoader::getCount() {
+  if(m_lock == NULL) {
+    return 0;
+  }
+
+  SDL_LockMutex(m_lock);
+  int count = m_requests.size();
+  SDL_UnlockMutex(m_lock);
+  return count;
+}
+
+int LAssetLoader::getFinished() {
+  if(m_lock == NULL) {
+    return 0;
+  }
+
+  SDL_LockMutex(m_lock);
+  int finished = m_finished;
+  SDL_UnlockMutex(m_lock);
+  return finished;
+}
+
+void LAssetLoader::free() {
+  //Stop the workers, queued assets that were not started are dropped
+  if(!m_threads.empty()) {
+    SDL_LockMutex(m_lock);
+    m_quit = true;
+    SDL_CondBroadcast(m_requestQueued);
+    SDL_UnlockMutex(m_lock);
+    for(unsigned i = 0; i < m_threads.size(); ++i) {
+      SDL_WaitThread(m_threads[i], NULL);
+    }
+    m_threads.clear();
+  }
+
+  //Free what was decoded but never handed over
+  for(unsigned i = 0; i < m_requests.size(); ++i) {
+    if(m_requests[i]->surface != NULL) {
+      SDL_FreeSurface(m_requests[i]->surface);
+    }
+    if(m_requests[i]->decoded != NULL) {
+      Mix_FreeChunk(m_requests[i]->decoded);
+    }
+    delete m_requests[i];
+  }
+  m_requests.clear();
+  m_queued.clear();
+  m_decoded.clear();
+  m_finished = 0;
+
+  if(m_requestQueued != NULL) {
+    SDL_DestroyCond(m_requestQueued);
+    m_requestQueued = NULL;
+  }
+  if(m_lock != NULL) {
+    SDL_DestroyMutex(m_lock);
+    m_lock = NULL;
+  }
+}
+
+int LAssetLoader::decodeThread(void *data) {
+  LAssetLoader *loader = (LAssetLoader*)data;
+
+  SDL_LockMutex(loader->m_lock);
+  while(true) {
+    //Sleep until there is an asset or a stop request
+    while(loader->m_queued.empty() && !loader->m_quit) {
+      SDL_CondWait(loader->m_requestQueued, loader->m_lock);
+    }
+    if(loader->m_quit) {
+      break;
+    }
+
+    Request *request = loader->m_queued.front();
+    loader->m_queued.pop_front();
+    SDL_UnlockMutex(loader->m_lock);
+
+    decode(request);
+
+    //Pass it to the main thread
+    SDL_LockMutex(loader->m_lock);
+    request->state = ASSET_DECODED;
+    loader->m_decoded.push_back(request);
+  }
+  SDL_UnlockMutex(loader->m_lock);
+  return 0;
+}
+
+void LAssetLoader::decode(Request *request) {
+  if(request->type == REQUEST_IMAGE) {
+    //Read it from the archive if it has it
+    SDL_RWops *rw = g_archive.open(request->path);
+    request->surface = rw != NULL ? IMG_Load_RW(rw, 1) : IMG_Load(request->path.c_str());
+    if(request->surface == NULL) {
+      printf("Unable to load image %s! SDL_image Error: %s\n", request->path.c_str(), IMG_GetError());
+    } else {
+      //Color key image
+      SDL_SetColorKey(request->surface, SDL_TRUE, SDL_MapRGB(request->surface->format, 0, 0xFF, 0xFF));
+    }
+  } else {
+    SDL_RWops *rw = g_archive.open(request->path);
+    request->decoded = rw != NULL ? Mix_LoadWAV_RW(rw, 1) : Mix_LoadWAV(request->path.c_str());
+    if(request->decoded == NULL) {
+      printf("Failed to load %s! SDL_mixer Error: %s\n", request->path.c_str(), Mix_GetError());
+    }
+  }
+}
+
+bool loadMedia() {
+  //Loading success flag
+  bool success = true;
+
+  //Show a checkerboard until the prompt is ready
+  if(!g_placeholder.loadPlaceholder(SCREEN_WIDTH, SCREEN_HEIGHT)) {
+    printf("Failed to create placeholder texture!\n");
     success = false;
   }
 
-  g_low = Mix_LoadWAV("low.wav");
-  if(g_low == NULL) {
-    printf("Failed to load low sound effect! SDL_mixer Error: %s\n", Mix_GetError());
+  //Open the packed assets, anything not in them loads from loose files
+  g_archive.loadFromFile(ARCHIVE_PATH);
+
+  //Decode in the background, loading on the main thread if no workers start
+  if(!g_loader.start()) {
+    printf("Warning: Loading assets on the main thread\n");
+  }
+
+  //Queue prompt texture
+  g_textureHandle = g_loader.loadImage("prompt.png", &g_texture);
+
+  //Load music, it streams so opening it is cheap
+  SDL_RWops *musicStream = g_archive.open("beat.wav");
+  g_music = musicStream != NULL ? Mix_LoadMUS_RW(musicStream, 1) : Mix_LoadMUS("beat.wav");
+  if(g_music == NULL) {
+    printf("Failed to load beat music! SDL_mixer Error: %s\n", Mix_GetError());
     success = false;
   }
 
+  //Queue sound effects
+  g_loader.loadSound("scratch.wav", &g_scratch);
+  g_loader.loadSound("high.wav", &g_high);
+  g_loader.loadSound("medium.wav", &g_medium);
+  g_loader.loadSound("low.wav", &g_low);
+
   return success;
 }
 
@@ -290,8 +1098,12 @@ bool init() {
 }
 
 void close() {
+  //Stop loading
+  g_loader.free();
+
   //Free loaded images
   g_texture.free();
+  g_placeholder.free();
 
   //Free the sound effects
   Mix_FreeChunk(g_scratch);
@@ -307,6 +1119,9 @@ void close() {
   Mix_FreeMusic(g_music);
   g_music = NULL;
 
+  //Unmap the archive the music was streaming from
+  g_archive.free();
+
   //Destroy window
   SDL_DestroyRenderer(g_renderer);
   SDL_DestroyWindow(g_window);
@@ -392,12 +1207,21 @@ int main() {
       }
     }
 
+    //Finish loading what the workers decoded
+    if(!g_loader.isDone()) {
+      g_loader.update(UPLOAD_BUDGET);
+    }
+
     //Clear screen
     SDL_SetRenderDrawColor(g_renderer, 0xFF, 0xFF, 0xFF, 0xFF);
     SDL_RenderClear(g_renderer);
 
-    //Render current texture
-    g_texture.render(0, 0);
+    //Render current texture, or the placeholder until it is uploaded
+    if(g_loader.getState(g_textureHandle) == ASSET_READY) {
+      g_texture.render(0, 0);
+    } else {
+      g_placeholder.render(0, 0);
+    }
     
     //Update screen
     SDL_RenderPresent(g_renderer);
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <string>
 #include <sstream>
+#include <vector>
 
 const int SCREEN_HEIGHT = 480;
 const int SCREEN_WIDTH  = 640;
@@ -53,6 +54,66 @@ private:
   int m_height;
 };
 
+//Rasterizes a font's glyphs once into an atlas and draws strings from it
+class LGlyphCache {
+public:
+  //First and last cached characters, others are drawn as '?'
+  static const int FIRST_GLYPH  = ' ';
+  static const int LAST_GLYPH   = '~';
+  static const int TOTAL_GLYPHS = LAST_GLYPH - FIRST_GLYPH + 1;
+
+  //Width of the glyph atlas
+  static const int ATLAS_WIDTH = 512;
+
+  //Initializes variables
+  LGlyphCache();
+
+  //Deallocates memory
+  ~LGlyphCache();
+
+  //Rasterizes every cached glyph of the font
+  bool loadFromFont(TTF_Font *font);
+
+  //Deallocates atlas
+  void free();
+
+  //Draws text with its top left at given point in one geometry call
+  void render(const char *text, int x, int y, SDL_Color color);
+
+  //Gets text dimensions
+  int getTextWidth(const char *text);
+  int getLineHeight();
+
+private:
+  //Where a glyph is in the atlas and how it moves the pen
+  struct Glyph {
+    SDL_Rect clip;
+    int offset;
+    int advance;
+  };
+
+  //Gets the cache index of a character
+  static int glyphIndex(char c);
+
+  //The glyph atlas
+  SDL_Texture *m_texture;
+  int m_width;
+  int m_height;
+
+  //Cached glyphs
+  Glyph m_glyphs[TOTAL_GLYPHS];
+
+  //Pen adjustment for each pair of glyphs
+  std::vector<int> m_kerning;
+
+  //Height of a line of text
+  int m_lineHeight;
+
+  //Quads for the text being drawn, kept to avoid allocating every frame
+  std::vector<SDL_Vertex> m_vertices;
+  std::vector<int> m_indices;
+};
+
 //The window we'll be rendering to
 SDL_Window *g_window = NULL;
 
@@ -60,7 +121,9 @@ SDL_Window *g_window = NULL;
 SDL_Renderer *g_renderer = NULL;
 
 LTexture g_texture;
-LTexture g_timeTextTexture;
+
+//Cached glyphs of the global font for the changing time text
+LGlyphCache g_fontGlyphs;
 
 //global font
 TTF_Font *g_font = NULL;
@@ -186,6 +249,206 @@ void LTexture::setAlpha(Uint8 alpha) {
   SDL_SetTextureAlphaMod(m_texture, alpha);
 }
 
+LGlyphCache::LGlyphCache() {
+  //Initialize
+  m_texture    = NULL;
+  m_width      = 0;
+  m_height     = 0;
+  m_lineHeight = 0;
+}
+
+LGlyphCache::~LGlyphCache() {
+  //Deallocate
+  free();
+}
+
+bool LGlyphCache::loadFromFont(TTF_Font *font) {
+  //Get rid of preexisting atlas
+  free();
+
+  //Glyphs are rendered white so any color can be applied when drawing
+  SDL_Color white = {0xFF, 0xFF, 0xFF, 0xFF};
+  SDL_Surface *surfaces[TOTAL_GLYPHS];
+
+  //Render each glyph and place it on a shelf of the atlas
+  int x = 0, y = 0, shelfHeight = 0;
+  for(int i = 0; i < TOTAL_GLYPHS; ++i) {
+    char text[2] = {(char)(FIRST_GLYPH + i), '\0'};
+    surfaces[i] = TTF_RenderText_Blended(font, text, white);
+
+    //Surfaces start at the leftmost pixel the glyph reaches
+    int minX = 0, maxX = 0, minY = 0, maxY = 0, advance = 0;
+    TTF_GlyphMetrics(font, FIRST_GLYPH + i, &minX, &maxX, &minY, &maxY, &advance);
+    m_glyphs[i].offset  = minX < 0 ? minX : 0;
+    m_glyphs[i].advance = advance;
+
+    SDL_Rect clip = {0, 0, 0, 0};
+    if(surfaces[i] != NULL) {
+      if(x + surfaces[i]->w > ATLAS_WIDTH) {
+	x = 0;
+	y += shelfHeight + 1;
+	shelfHeight = 0;
+      }
+      clip.x = x;
+      clip.y = y;
+      clip.w = surfaces[i]->w;
+      clip.h = surfaces[i]->h;
+      x += clip.w + 1;
+      if(clip.h > shelfHeight) {
+	shelfHeight = clip.h;
+      }
+    }
+    m_glyphs[i].clip = clip;
+  }
+
+  //Copy glyphs with their alpha into one surface
+  bool success = true;
+  SDL_Surface *atlasSurface = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_WIDTH, y + shelfHeight, 32, SDL_PIXELFORMAT_RGBA32);
+  if(atlasSurface == NULL) {
+    printf("Unable to create glyph atlas! SDL Error: %s\n", SDL_GetError());
+    success = false;
+  } else {
+    SDL_FillRect(atlasSurface, NULL, SDL_MapRGBA(atlasSurface->format, 0xFF, 0xFF, 0xFF, 0));
+    for(int i = 0; i < TOTAL_GLYPHS; ++i) {
+      if(surfaces[i] != NULL) {
+	SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE);
+	SDL_BlitSurface(surfaces[i], NULL, atlasSurface, &m_glyphs[i].clip);
+      }
+    }
+
+    //Create texture from atlas pixels
+    m_texture = SDL_CreateTextureFromSurface(g_renderer, atlasSurface);
+    if(m_texture == NULL) {
+      printf("Unable to create glyph texture! SDL Error: %s\n", SDL_GetError());
+      success = false;
+    } else {
+      SDL_SetTextureBlendMode(m_texture, SDL_BLENDMODE_BLEND);
+      m_width  = atlasSurface->w;
+      m_height = atlasSurface->h;
+    }
+    SDL_FreeSurface(atlasSurface);
+  }
+
+  //Get rid of glyph surfaces
+  for(int i = 0; i < TOTAL_GLYPHS; ++i) {
+    SDL_FreeSurface(surfaces[i]);
+  }
+
+  //Look up kerning once for every pair
+  m_kerning.assign(TOTAL_GLYPHS * TOTAL_GLYPHS, 0);
+  if(TTF_GetFontKerning(font)) {
+    for(int left = 0; left < TOTAL_GLYPHS; ++left) {
+      for(int right = 0; right < TOTAL_GLYPHS; ++right) {
+	m_kerning[left * TOTAL_GLYPHS + right] =
+	  TTF_GetFontKerningSizeGlyphs(font, FIRST_GLYPH + left, FIRST_GLYPH + right);
+      }
+    }
+  }
+  m_lineHeight = TTF_FontLineSkip(font);
+
+  if(!success) {
+    free();
+  }
+  return success;
+}
+
+void LGlyphCache::free() {
+  //Free atlas if it exists
+  if(m_texture != NULL) {
+    SDL_DestroyTexture(m_texture);
+    m_texture = NULL;
+    m_width   = 0;
+    m_height  = 0;
+  }
+  m_kerning.clear();
+}
+
+int LGlyphCache::glyphIndex(char c) {
+  if(c < FIRST_GLYPH || c > LAST_GLYPH) {
+    c = '?';
+  }
+  return c - FIRST_GLYPH;
+}
+
+void LGlyphCache::render(const char *text, int x, int y, SDL_Color color) {
+  if(m_texture == NULL) {
+    return;
+  }
+
+  //Lay out one quad per glyph
+  m_vertices.clear();
+  int pen = x;
+  int previous = -1;
+  for(const char *c = text; *c != '\0'; ++c) {
+    int index = glyphIndex(*c);
+    Glyph &glyph = m_glyphs[index];
+    if(previous != -1) {
+      pen += m_kerning[previous * TOTAL_GLYPHS + index];
+    }
+    previous = index;
+
+    //Quad corners on screen
+    float left   = (float)(pen + glyph.offset);
+    float top    = (float)y;
+    float right  = left + glyph.clip.w;
+    float bottom = top + glyph.clip.h;
+
+    //Quad corners in the atlas
+    float u0 = (float)glyph.clip.x / m_width;
+    float v0 = (float)glyph.clip.y / m_height;
+    float u1 = (float)(glyph.clip.x + glyph.clip.w) / m_width;
+    float v1 = (float)(glyph.clip.y + glyph.clip.h) / m_height;
+
+    SDL_Vertex quad[4] = {
+      {{left,  top},    color, {u0, v0}},
+      {{right, top},    color, {u1, v0}},
+      {{right, bottom}, color, {u1, v1}},
+      {{left,  bottom}, color, {u0, v1}}
+    };
+    m_vertices.insert(m_vertices.end(), quad, quad + 4);
+    pen += glyph.advance;
+  }
+
+  int totalQuads = m_vertices.size() / 4;
+  if(totalQuads == 0) {
+    return;
+  }
+
+  //Extend the shared index list to cover every quad
+  for(int q = m_indices.size() / 6; q < totalQuads; ++q) {
+    int first = q * 4;
+    int indices[6] = {first, first + 1, first + 2, first, first + 2, first + 3};
+    m_indices.insert(m_indices.end(), indices, indices + 6);
+  }
+
+  //Render the whole string in one call
+  SDL_RenderGeometry(g_renderer, m_texture, &m_vertices[0], m_vertices.size(), &m_indices[0], totalQuads * 6);
+}
+
+int LGlyphCache::getTextWidth(const char *text) {
+  int pen = 0, width = 0;
+  int previous = -1;
+  for(const char *c = text; *c != '\0'; ++c) {
+    int index = glyphIndex(*c);
+    Glyph &glyph = m_glyphs[index];
+    if(previous != -1 && !m_kerning.empty()) {
+      pen += m_kerning[previous * TOTAL_GLYPHS + index];
+    }
+    previous = index;
+
+    //Either the pen or the glyph's right edge may be furthest out
+    if(pen + glyph.offset + glyph.clip.w > width) {
+      width = pen + glyph.offset + glyph.clip.w;
+    }
+    pen += glyph.advance;
+  }
+  return pen > width ? pen : width;
+}
+
+int LGlyphCache::getLineHeight() {
+  return m_lineHeight;
+}
+
 bool loadMedia() {
  //Loading success flag
   bool success = true;
@@ -205,6 +468,12 @@ bool loadMedia() {
       printf( "Unable to render prompt texture!\n" );
       success = false;
     }
+
+    //Cache glyphs for the time text
+    if(!g_fontGlyphs.loadFromFont(g_font)) {
+      printf("Failed to cache font glyphs!\n");
+      success = false;
+    }
   }
   return success;
 }
@@ -264,7 +533,7 @@ bool init() {
 void close() {
   //Free loaded images
   g_texture.free();
-  g_timeTextTexture.free();
+  g_fontGlyphs.free();
 
   //Free global font
   TTF_CloseFont(g_font);
@@ -325,19 +594,14 @@ int main() {
     timeText.str("");
     timeText << "Milliseconds since start time " << SDL_GetTicks() - startTime;
     
-    //Render text
-    if(!g_timeTextTexture.loadFromRenderedText(timeText.str().c_str(), textColor)) {
-      printf("Unable to render time texture!\n");
-    }
-
     //Clear screen
     SDL_SetRenderDrawColor(g_renderer, 0xFF, 0xFF, 0xFF, 0xFF);
     SDL_RenderClear(g_renderer);
     
     //Render current texture
     g_texture.render((SCREEN_WIDTH - g_texture.getWidth()) / 2, 0);
-    g_timeTextTexture.render((SCREEN_WIDTH - g_texture.getWidth()) / 2, 
-			     (SCREEN_HEIGHT - g_texture.getHeight()) / 2);
+    g_fontGlyphs.render(timeText.str().c_str(), (SCREEN_WIDTH - g_texture.getWidth()) / 2,
+			(SCREEN_HEIGHT - g_texture.getHeight()) / 2, textColor);
     
     //Update screen
     SDL_RenderPresent(g_renderer);
@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <string>
 #include <sstream>
+#include <vector>
+#include <algorithm>
 
 const int SCREEN_HEIGHT = 480;
 const int SCREEN_WIDTH  = 640;
@@ -53,9 +55,13 @@ private:
   int m_height;
 };
 
-//The application time based timer
+//The application time based timer, runs off the performance counter
+//and keeps 64 bit times so it neither rounds to milliseconds nor wraps
 class LTimer {
 public:
+  //Laps kept for the rolling statistics
+  static const int ROLLING_LAPS = 64;
+
   //Initializes variables
   LTimer();
 
@@ -65,25 +71,115 @@ public:
   void pause();
   void unpause();
 
-  //Get the timer's time
-  Uint32 getTicks();
+  //Get the timer's time in milliseconds
+  Uint64 getTicks();
+
+  //Get the timer's time in nanoseconds
+  Uint64 getNanoseconds();
+
+  //Get the timer's time in seconds
+  double getSeconds();
+
+  //Ends the current lap, starts the next and returns the lap's length in nanoseconds
+  Uint64 lap();
+
+  //Gets the time into the current lap in nanoseconds without ending it
+  Uint64 split();
+
+  //Statistics over the last laps in nanoseconds
+  int getLapCount();
+  Uint64 getLastLap();
+  Uint64 getLapAverage();
+  Uint64 getLapMin();
+  Uint64 getLapMax();
 
   //Checks the status of the timer
   bool isStarted();
   bool isPaused();
 
+  //Converts performance counter ticks to nanoseconds
+  static Uint64 toNanoseconds(Uint64 counts);
+
 private:
-  //The clock time when the timer started
-  Uint32 m_startTicks;
+  //The counter value when the timer started
+  Uint64 m_startCounts;
+
+  //The counts stored when the timer was paused
+  Uint64 m_pausedCounts;
+
+  //Timer time the current lap started at
+  Uint64 m_lapStart;
 
-  //The ticks stored when the timer was paused
-  Uint32 m_pausedTicks;
+  //Lap lengths, the oldest is overwritten first
+  Uint64 m_laps[ROLLING_LAPS];
+  int m_lapCount;
+  int m_nextLap;
 
   //The timer status
   bool m_paused;
   bool m_started;
 };
 
+//Rasterizes a font's glyphs once into an atlas and draws strings from it
+class LGlyphCache {
+public:
+  //First and last cached characters, others are drawn as '?'
+  static const int FIRST_GLYPH  = ' ';
+  static const int LAST_GLYPH   = '~';
+  static const int TOTAL_GLYPHS = LAST_GLYPH - FIRST_GLYPH + 1;
+
+  //Width of the glyph atlas
+  static const int ATLAS_WIDTH = 512;
+
+  //Initializes variables
+  LGlyphCache();
+
+  //Deallocates memory
+  ~LGlyphCache();
+
+  //Rasterizes every cached glyph of the font
+  bool loadFromFont(TTF_Font *font);
+
+  //Deallocates atlas
+  void free();
+
+  //Draws text with its top left at given point in one geometry call
+  void render(const char *text, int x, int y, SDL_Color color);
+
+  //Gets text dimensions
+  int getTextWidth(const char *text);
+  int getLineHeight();
+
+private:
+  //Where a glyph is in the atlas and how it moves the pen
+  struct Glyph {
+    SDL_Rect clip;
+    int offset;
+    int advance;
+  };
+
+  //Gets the cache index of a character
+  static int glyphIndex(char c);
+
+  //The glyph atlas
+  SDL_Texture *m_texture;
+  int m_width;
+  int m_height;
+
+  //Cached glyphs
+  Glyph m_glyphs[TOTAL_GLYPHS];
+
+  //Pen adjustment for each pair of glyphs
+  std::vector<int> m_kerning;
+
+  //Height of a line of text
+  int m_lineHeight;
+
+  //Quads for the text being drawn, kept to avoid allocating every frame
+  std::vector<SDL_Vertex> m_vertices;
+  std::vector<int> m_indices;
+};
+
 //The window we'll be rendering to
 SDL_Window *g_window = NULL;
 
@@ -92,7 +188,9 @@ SDL_Renderer *g_renderer = NULL;
 
 LTexture g_startTexture;
 LTexture g_pauseTexture;
-LTexture g_timeTextTexture;
+
+//Cached glyphs of the global font for the changing time text
+LGlyphCache g_fontGlyphs;
 
 //global font
 TTF_Font *g_font = NULL;
@@ -220,8 +318,11 @@ void LTexture::setAlpha(Uint8 alpha) {
 
 LTimer::LTimer() {
   //Initialize the variables
-  m_startTicks  = 0;
-  m_pausedTicks = 0;
+  m_startCounts  = 0;
+  m_pausedCounts = 0;
+  m_lapStart     = 0;
+  m_lapCount     = 0;
+  m_nextLap      = 0;
 
   m_paused  = false;
   m_started = false;
@@ -234,9 +335,14 @@ void LTimer::start() {
   //Unpause the timer
   m_paused = false;
 
-  //Get the current clock time 
-  m_startTicks  = SDL_GetTicks();
-  m_pausedTicks = 0;
+  //Get the current counter value
+  m_startCounts  = SDL_GetPerformanceCounter();
+  m_pausedCounts = 0;
+
+  //Start over with the laps
+  m_lapStart = 0;
+  m_lapCount = 0;
+  m_nextLap  = 0;
 }
 
 void LTimer::stop() {
@@ -246,9 +352,10 @@ void LTimer::stop() {
   //Unpause the timer
   m_paused = false;
 
-  //Clear tick variables
-  m_startTicks  = 0;
-  m_pausedTicks = 0;
+  //Clear counter variables
+  m_startCounts  = 0;
+  m_pausedCounts = 0;
+  m_lapStart     = 0;
 }
 
 void LTimer::pause() {
@@ -257,9 +364,9 @@ void LTimer::pause() {
     //Pause the timer
     m_paused = true;
 
-    //Calculate the paused ticks
-    m_pausedTicks = SDL_GetTicks() - m_startTicks;
-    m_startTicks = 0;
+    //Calculate the paused counts
+    m_pausedCounts = SDL_GetPerformanceCounter() - m_startCounts;
+    m_startCounts = 0;
   }
 }
 
@@ -269,30 +376,98 @@ void LTimer::unpause() {
     //Unpause the timer
     m_paused = false;
 
-    //Reset the starting ticks
-    m_startTicks = SDL_GetTicks() - m_pausedTicks;
+    //Reset the starting counts
+    m_startCounts = SDL_GetPerformanceCounter() - m_pausedCounts;
 
-    //Reset the paused ticks
-    m_pausedTicks = 0;
+    //Reset the paused counts
+    m_pausedCounts = 0;
   }
 }
 
-Uint32 LTimer::getTicks() {
+Uint64 LTimer::getTicks() {
+  return getNanoseconds() / 1000000;
+}
+
+Uint64 LTimer::getNanoseconds() {
   //The actual timer time
-  Uint32 time = 0;
+  Uint64 counts = 0;
 
   //If the timer is running
   if(m_started) {
     //If the timer is paused
     if(m_paused) {
-      //Return the number of ticks when the timer was paused
-      time = m_pausedTicks;
+      //Return the number of counts when the timer was paused
+      counts = m_pausedCounts;
     } else {
-      //Return the current time minus the start time
-      time = SDL_GetTicks() - m_startTicks;
+      //Return the current counter minus the start
+      counts = SDL_GetPerformanceCounter() - m_startCounts;
     }
   }
-  return time;
+  return toNanoseconds(counts);
+}
+
+double LTimer::getSeconds() {
+  return getNanoseconds() / 1000000000.0;
+}
+
+Uint64 LTimer::lap() {
+  //Close the lap at the current time
+  Uint64 now = getNanoseconds();
+  Uint64 length = now - m_lapStart;
+  m_lapStart = now;
+
+  //Store it over the oldest
+  m_laps[m_nextLap] = length;
+  m_nextLap = (m_nextLap + 1) % ROLLING_LAPS;
+  if(m_lapCount < ROLLING_LAPS) {
+    ++m_lapCount;
+  }
+  return length;
+}
+
+Uint64 LTimer::split() {
+  return getNanoseconds() - m_lapStart;
+}
+
+int LTimer::getLapCount() {
+  return m_lapCount;
+}
+
+Uint64 LTimer::getLastLap() {
+  if(m_lapCount == 0) {
+    return 0;
+  }
+  return m_laps[(m_nextLap + ROLLING_LAPS - 1) % ROLLING_LAPS];
+}
+
+Uint64 LTimer::getLapAverage() {
+  if(m_lapCount == 0) {
+    return 0;
+  }
+  Uint64 total = 0;
+  for(int i = 0; i < m_lapCount; ++i) {
+    total += m_laps[i];
+  }
+  return total / m_lapCount;
+}
+
+Uint64 LTimer::getLapMin() {
+  if(m_lapCount == 0) {
+    return 0;
+  }
+  Uint64 shortest = m_laps[0];
+  for(int i = 1; i < m_lapCount; ++i) {
+    shortest = std::min(shortest, m_laps[i]);
+  }
+  return shortest;
+}
+
+Uint64 LTimer::getLapMax() {
+  Uint64 longest = 0;
+  for(int i = 0; i < m_lapCount; ++i) {
+    longest = std::max(longest, m_laps[i]);
+  }
+  return longest;
 }
 
 bool LTimer::isStarted() {
@@ -305,6 +480,212 @@ bool LTimer::isPaused() {
   return m_paused && m_started;
 }
 
+Uint64 LTimer::toNanoseconds(Uint64 counts) {
+  //Split the division so the multiply cannot overflow
+  Uint64 frequency = SDL_GetPerformanceFrequency();
+  return counts / frequency * 1000000000 + counts % frequency * 1000000000 / frequency;
+}
+
+LGlyphCache::LGlyphCache() {
+  //Initialize
+  m_texture    = NULL;
+  m_width      = 0;
+  m_height     = 0;
+  m_lineHeight = 0;
+}
+
+LGlyphCache::~LGlyphCache() {
+  //Deallocate
+  free();
+}
+
+bool LGlyphCache::loadFromFont(TTF_Font *font) {
+  //Get rid of preexisting atlas
+  free();
+
+  //Glyphs are rendered white so any color can be applied when drawing
+  SDL_Color white = {0xFF, 0xFF, 0xFF, 0xFF};
+  SDL_Surface *surfaces[TOTAL_GLYPHS];
+
+  //Render each glyph and place it on a shelf of the atlas
+  int x = 0, y = 0, shelfHeight = 0;
+  for(int i = 0; i < TOTAL_GLYPHS; ++i) {
+    char text[2] = {(char)(FIRST_GLYPH + i), '\0'};
+    surfaces[i] = TTF_RenderText_Blended(font, text, white);
+
+    //Surfaces start at the leftmost pixel the glyph reaches
+    int minX = 0, maxX = 0, minY = 0, maxY = 0, advance = 0;
+    TTF_GlyphMetrics(font, FIRST_GLYPH + i, &minX, &maxX, &minY, &maxY, &advance);
+    m_glyphs[i].offset  = minX < 0 ? minX : 0;
+    m_glyphs[i].advance = advance;
+
+    SDL_Rect clip = {0, 0, 0, 0};
+    if(surfaces[i] != NULL) {
+      if(x + surfaces[i]->w > ATLAS_WIDTH) {
+	x = 0;
+	y += shelfHeight + 1;
+	shelfHeight = 0;
+      }
+      clip.x = x;
+      clip.y = y;
+      clip.w = surfaces[i]->w;
+      clip.h = surfaces[i]->h;
+      x += clip.w + 1;
+      if(clip.h > shelfHeight) {
+	shelfHeight = clip.h;
+      }
+    }
+    m_glyphs[i].clip = clip;
+  }
+
+  //Copy glyphs with their alpha into one surface
+  bool success = true;
+  SDL_Surface *atlasSurface = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_WIDTH, y + shelfHeight, 32, SDL_PIXELFORMAT_RGBA32);
+  if(atlasSurface == NULL) {
+    printf("Unable to create glyph atlas! SDL Error: %s\n", SDL_GetError());
+    success = false;
+  } else {
+    SDL_FillRect(atlasSurface, NULL, SDL_MapRGBA(atlasSurface->format, 0xFF, 0xFF, 0xFF, 0));
+    for(int i = 0; i < TOTAL_GLYPHS; ++i) {
+      if(surfaces[i] != NULL) {
+	SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE);
+	SDL_BlitSurface(surfaces[i], NULL, atlasSurface, &m_glyphs[i].clip);
+      }
+    }
+
+    //Create texture from atlas pixels
+    m_texture = SDL_CreateTextureFromSurface(g_renderer, atlasSurface);
+    if(m_texture == NULL) {
+      printf("Unable to create glyph texture! SDL Error: %s\n", SDL_GetError());
+      success = false;
+    } else {
+      SDL_SetTextureBlendMode(m_texture, SDL_BLENDMODE_BLEND);
+      m_width  = atlasSurface->w;
+      m_height = atlasSurface->h;
+    }
+    SDL_FreeSurface(atlasSurface);
+  }
+
+  //Get rid of glyph surfaces
+  for(int i = 0; i < TOTAL_GLYPHS; ++i) {
+    SDL_FreeSurface(surfaces[i]);
+  }
+
+  //Look up kerning once for every pair
+  m_kerning.assign(TOTAL_GLYPHS * TOTAL_GLYPHS, 0);
+  if(TTF_GetFontKerning(font)) {
+    for(int left = 0; left < TOTAL_GLYPHS; ++left) {
+      for(int right = 0; right < TOTAL_GLYPHS; ++right) {
+	m_kerning[left * TOTAL_GLYPHS + right] =
+	  TTF_GetFontKerningSizeGlyphs(font, FIRST_GLYPH + left, FIRST_GLYPH + right);
+      }
+    }
+  }
+  m_lineHeight = TTF_FontLineSkip(font);
+
+  if(!success) {
+    free();
+  }
+  return success;
+}
+
+void LGlyphCache::free() {
+  //Free atlas if it exists
+  if(m_texture != NULL) {
+    SDL_DestroyTexture(m_texture);
+    m_texture = NULL;
+    m_width   = 0;
+    m_height  = 0;
+  }
+  m_kerning.clear();
+}
+
+int LGlyphCache::glyphIndex(char c) {
+  if(c < FIRST_GLYPH || c > LAST_GLYPH) {
+    c = '?';
+  }
+  return c - FIRST_GLYPH;
+}
+
+void LGlyphCache::render(const char *text, int x, int y, SDL_Color color) {
+  if(m_texture == NULL) {
+    return;
+  }
+
+  //Lay out one quad per glyph
+  m_vertices.clear();
+  int pen = x;
+  int previous = -1;
+  for(const char *c = text; *c != '\0'; ++c) {
+    int index = glyphIndex(*c);
+    Glyph &glyph = m_glyphs[index];
+    if(previous != -1) {
+      pen += m_kerning[previous * TOTAL_GLYPHS + index];
+    }
+    previous = index;
+
+    //Quad corners on screen
+    float left   = (float)(pen + glyph.offset);
+    float top    = (float)y;
+    float right  = left + glyph.clip.w;
+    float bottom = top + glyph.clip.h;
+
+    //Quad corners in the atlas
+    float u0 = (float)glyph.clip.x / m_width;
+    float v0 = (float)glyph.clip.y / m_height;
+    float u1 = (float)(glyph.clip.x + glyph.clip.w) / m_width;
+    float v1 = (float)(glyph.clip.y + glyph.clip.h) / m_height;
+
+    SDL_Vertex quad[4] = {
+      {{left,  top},    color, {u0, v0}},
+      {{right, top},    color, {u1, v0}},
+      {{right, bottom}, color, {u1, v1}},
+      {{left,  bottom}, color, {u0, v1}}
+    };
+    m_vertices.insert(m_vertices.end(), quad, quad + 4);
+    pen += glyph.advance;
+  }
+
+  int totalQuads = m_vertices.size() / 4;
+  if(totalQuads == 0) {
+    return;
+  }
+
+  //Extend the shared index list to cover every quad
+  for(int q = m_indices.size() / 6; q < totalQuads; ++q) {
+    int first = q * 4;
+    int indices[6] = {first, first + 1, first + 2, first, first + 2, first + 3};
+    m_indices.insert(m_indices.end(), indices, indices + 6);
+  }
+
+  //Render the whole string in one call
+  SDL_RenderGeometry(g_renderer, m_texture, &m_vertices[0], m_vertices.size(), &m_indices[0], totalQuads * 6);
+}
+
+int LGlyphCache::getTextWidth(const char *text) {
+  int pen = 0, width = 0;
+  int previous = -1;
+  for(const char *c = text; *c != '\0'; ++c) {
+    int index = glyphIndex(*c);
+    Glyph &glyph = m_glyphs[index];
+    if(previous != -1 && !m_kerning.empty()) {
+      pen += m_kerning[previous * TOTAL_GLYPHS + index];
+    }
+    previous = index;
+
+    //Either the pen or the glyph's right edge may be furthest out
+    if(pen + glyph.offset + glyph.clip.w > width) {
+      width = pen + glyph.offset + glyph.clip.w;
+    }
+    pen += glyph.advance;
+  }
+  return pen > width ? pen : width;
+}
+
+int LGlyphCache::getLineHeight() {
+  return m_lineHeight;
+}
+
 bool loadMedia() {
  //Loading success flag
   bool success = true;
@@ -328,6 +709,12 @@ bool loadMedia() {
       printf("Unable to render pause texture!\n");
       success = false;
     }
+
+    //Cache glyphs for the time text
+    if(!g_fontGlyphs.loadFromFont(g_font)) {
+      printf("Failed to cache font glyphs!\n");
+      success = false;
+    }
   }
   return success;
 }
@@ -388,7 +775,7 @@ void close() {
   //Free loaded images
   g_startTexture.free();
   g_pauseTexture.free();
-  g_timeTextTexture.free();
+  g_fontGlyphs.free();
 
   //Free global font
   TTF_CloseFont(g_font);
@@ -457,18 +844,33 @@ int main() {
 	    timer.pause();
 	  }
 	}
+	//Lap
+	else if(e.key.keysym.sym == SDLK_l) {
+	  if(timer.isStarted()) {
+	    timer.lap();
+	  }
+	}
       }
     }
     
     //Set text to be rendered
     timeText.str("");
-    timeText << "Secends since start time " << (timer.getTicks() / 1000.f);
-    
-    //Render text
-    if(!g_timeTextTexture.loadFromRenderedText(timeText.str().c_str(), textColor)) {
-      printf("Unable to render time texture!\n");
+    timeText << "Secends since start time " << timer.getSeconds();
+
+    //Lap times in milliseconds
+    std::stringstream lapText;
+    lapText.setf(std::ios::fixed);
+    lapText.precision(3);
+    lapText << "Lap " << timer.split() / 1000000.0 << " ms";
+    if(timer.getLapCount() > 0) {
+      lapText << ", last " << timer.getLastLap() / 1000000.0 << " ms";
     }
-
+    std::stringstream lapStatsText;
+    lapStatsText.setf(std::ios::fixed);
+    lapStatsText.precision(3);
+    lapStatsText << "Last " << timer.getLapCount() << " laps: avg " << timer.getLapAverage() / 1000000.0
+		 << " min " << timer.getLapMin() / 1000000.0 << " max " << timer.getLapMax() / 1000000.0;
+    
     //Clear screen
     SDL_SetRenderDrawColor(g_renderer, 0xFF, 0xFF, 0xFF, 0xFF);
     SDL_RenderClear(g_renderer);
@@ -476,8 +878,18 @@ int main() {
     //Render current texture
     g_startTexture.render((SCREEN_WIDTH - g_startTexture.getWidth()) / 2, 0);
     g_pauseTexture.render((SCREEN_WIDTH - g_pauseTexture.getWidth()) / 2, g_startTexture.getHeight());
-    g_timeTextTexture.render((SCREEN_WIDTH - g_timeTextTexture.getWidth()) / 2, 
-			     (SCREEN_HEIGHT - g_timeTextTexture.getHeight()) / 2);
+    const char *lapPrompt = "Press l to time a lap.";
+    g_fontGlyphs.render(lapPrompt, (SCREEN_WIDTH - g_fontGlyphs.getTextWidth(lapPrompt)) / 2,
+			g_startTexture.getHeight() + g_pauseTexture.getHeight(), textColor);
+    std::string text = timeText.str();
+    g_fontGlyphs.render(text.c_str(), (SCREEN_WIDTH - g_fontGlyphs.getTextWidth(text.c_str())) / 2,
+			(SCREEN_HEIGHT - g_fontGlyphs.getLineHeight()) / 2, textColor);
+    text = lapText.str();
+    g_fontGlyphs.render(text.c_str(), (SCREEN_WIDTH - g_fontGlyphs.getTextWidth(text.c_str())) / 2,
+			(SCREEN_HEIGHT + g_fontGlyphs.getLineHeight()) / 2, textColor);
+    text = lapStatsText.str();
+    g_fontGlyphs.render(text.c_str(), (SCREEN_WIDTH - g_fontGlyphs.getTextWidth(text.c_str())) / 2,
+			(SCREEN_HEIGHT + 3 * g_fontGlyphs.getLineHeight()) / 2, textColor);
     
     //Update screen
     SDL_RenderPresent(g_renderer);
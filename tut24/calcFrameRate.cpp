@@ -4,10 +4,18 @@
 #include <stdio.h>
 #include <string>
 #include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 
 const int SCREEN_HEIGHT = 480;
 const int SCREEN_WIDTH  = 640;
 
+//Longest a frame may take at 60 fps, override with --budget
+const Uint64 FRAME_BUDGET = 1000000000 / 60;
+
 //Texture wrapper class
 class LTexture {
 public:
@@ -53,9 +61,13 @@ private:
   int m_height;
 };
 
-//The application time based timer
+//The application time based timer, runs off the performance counter
+//and keeps 64 bit times so it neither rounds to milliseconds nor wraps
 class LTimer {
 public:
+  //Laps kept for the rolling statistics
+  static const int ROLLING_LAPS = 64;
+
   //Initializes variables
   LTimer();
 
@@ -65,32 +77,196 @@ public:
   void pause();
   void unpause();
 
-  //Get the timer's time
-  Uint32 getTicks();
+  //Get the timer's time in milliseconds
+  Uint64 getTicks();
+
+  //Get the timer's time in nanoseconds
+  Uint64 getNanoseconds();
+
+  //Get the timer's time in seconds
+  double getSeconds();
+
+  //Ends the current lap, starts the next and returns the lap's length in nanoseconds
+  Uint64 lap();
+
+  //Gets the time into the current lap in nanoseconds without ending it
+  Uint64 split();
+
+  //Statistics over the last laps in nanoseconds
+  int getLapCount();
+  Uint64 getLastLap();
+  Uint64 getLapAverage();
+  Uint64 getLapMin();
+  Uint64 getLapMax();
 
   //Checks the status of the timer
   bool isStarted();
   bool isPaused();
 
+  //Converts performance counter ticks to nanoseconds
+  static Uint64 toNanoseconds(Uint64 counts);
+
 private:
-  //The clock time when the timer started
-  Uint32 m_startTicks;
+  //The counter value when the timer started
+  Uint64 m_startCounts;
+
+  //The counts stored when the timer was paused
+  Uint64 m_pausedCounts;
 
-  //The ticks stored when the timer was paused
-  Uint32 m_pausedTicks;
+  //Timer time the current lap started at
+  Uint64 m_lapStart;
+
+  //Lap lengths, the oldest is overwritten first
+  Uint64 m_laps[ROLLING_LAPS];
+  int m_lapCount;
+  int m_nextLap;
 
   //The timer status
   bool m_paused;
   bool m_started;
 };
 
+//Rasterizes a font's glyphs once into an atlas and draws strings from it
+class LGlyphCache {
+public:
+  //First and last cached characters, others are drawn as '?'
+  static const int FIRST_GLYPH  = ' ';
+  static const int LAST_GLYPH   = '~';
+  static const int TOTAL_GLYPHS = LAST_GLYPH - FIRST_GLYPH + 1;
+
+  //Width of the glyph atlas
+  static const int ATLAS_WIDTH = 512;
+
+  //Initializes variables
+  LGlyphCache();
+
+  //Deallocates memory
+  ~LGlyphCache();
+
+  //Rasterizes every cached glyph of the font
+  bool loadFromFont(TTF_Font *font);
+
+  //Deallocates atlas
+  void free();
+
+  //Draws text with its top left at given point in one geometry call
+  void render(const char *text, int x, int y, SDL_Color color);
+
+  //Gets text dimensions
+  int getTextWidth(const char *text);
+  int getLineHeight();
+
+private:
+  //Where a glyph is in the atlas and how it moves the pen
+  struct Glyph {
+    SDL_Rect clip;
+    int offset;
+    int advance;
+  };
+
+  //Gets the cache index of a character
+  static int glyphIndex(char c);
+
+  //The glyph atlas
+  SDL_Texture *m_texture;
+  int m_width;
+  int m_height;
+
+  //Cached glyphs
+  Glyph m_glyphs[TOTAL_GLYPHS];
+
+  //Pen adjustment for each pair of glyphs
+  std::vector<int> m_kerning;
+
+  //Height of a line of text
+  int m_lineHeight;
+
+  //Quads for the text being drawn, kept to avoid allocating every frame
+  std::vector<SDL_Vertex> m_vertices;
+  std::vector<int> m_indices;
+};
+
+//Collects frame times into a ring of recent frames and a histogram of all of them.
+//One thread records while others may read the window without a lock, the
+//lifetime figures and files are only safe to read on the recording thread
+class LFrameStats {
+public:
+  //Frames in the sliding window
+  static const int WINDOW_FRAMES = 256;
+
+  //Histogram buckets of 0.1 ms, the last one holds everything longer
+  static const int HISTOGRAM_BUCKETS = 1000;
+  static const Uint64 BUCKET_WIDTH   = 100000;
+
+  //Frame time percentiles in nanoseconds and frames over budget
+  struct Summary {
+    int frames;
+    int missed;
+    Uint64 p50;
+    Uint64 p95;
+    Uint64 p99;
+    Uint64 max;
+  };
+
+  //Initializes variables
+  LFrameStats();
+
+  //Sets the frame length counted as a miss
+  void setBudget(Uint64 nanoseconds);
+  Uint64 getBudget();
+
+  //Records one frame's length
+  void record(Uint64 nanoseconds);
+
+  //Gets percentiles over the window
+  Summary getWindow();
+
+  //Gets percentiles over every frame, to histogram precision, from the recording thread
+  Summary getLifetime();
+
+  //Writes the window and the histogram as CSV, from the recording thread
+  bool writeCSV(std::string path);
+
+  //Writes both summaries and the histogram as JSON, from the recording thread
+  bool writeJSON(std::string path);
+
+private:
+  //Picks a percentile from sorted frame times
+  static Uint64 percentile(const std::vector<Uint64> &sorted, double fraction);
+
+  //Picks a percentile from the histogram
+  Uint64 histogramPercentile(double fraction);
+
+  //Copies out the frames in the window, oldest first
+  void copyWindow(std::vector<Uint64> &frames);
+
+  //Recent frame times, written round robin into twice the window
+  //so the recorder can run ahead of a reader copying the window
+  static const int RING_FRAMES = 2 * WINDOW_FRAMES;
+  Uint64 m_window[RING_FRAMES];
+
+  //Frames recorded, published after the frame time is stored
+  SDL_atomic_t m_recorded;
+
+  //Frame counts by length
+  Uint32 m_histogram[HISTOGRAM_BUCKETS];
+
+  //Longest frame and frames over budget since the start
+  Uint64 m_max;
+  int m_missed;
+
+  //Frame length counted as a miss
+  Uint64 m_budget;
+};
+
 //The window we'll be rendering to
 SDL_Window *g_window = NULL;
 
 //The window renderer
 SDL_Renderer *g_renderer = NULL;
 
-LTexture g_FPSTextTexture;
+//Cached glyphs of the global font for the FPS counter
+LGlyphCache g_fontGlyphs;
 
 //global font
 TTF_Font *g_font = NULL;
@@ -218,8 +394,11 @@ void LTexture::setAlpha(Uint8 alpha) {
 
 LTimer::LTimer() {
   //Initialize the variables
-  m_startTicks  = 0;
-  m_pausedTicks = 0;
+  m_startCounts  = 0;
+  m_pausedCounts = 0;
+  m_lapStart     = 0;
+  m_lapCount     = 0;
+  m_nextLap      = 0;
 
   m_paused  = false;
   m_started = false;
@@ -232,9 +411,14 @@ void LTimer::start() {
   //Unpause the timer
   m_paused = false;
 
-  //Get the current clock time 
-  m_startTicks  = SDL_GetTicks();
-  m_pausedTicks = 0;
+  //Get the current counter value
+  m_startCounts  = SDL_GetPerformanceCounter();
+  m_pausedCounts = 0;
+
+  //Start over with the laps
+  m_lapStart = 0;
+  m_lapCount = 0;
+  m_nextLap  = 0;
 }
 
 void LTimer::stop() {
@@ -244,9 +428,10 @@ void LTimer::stop() {
   //Unpause the timer
   m_paused = false;
 
-  //Clear tick variables
-  m_startTicks  = 0;
-  m_pausedTicks = 0;
+  //Clear counter variables
+  m_startCounts  = 0;
+  m_pausedCounts = 0;
+  m_lapStart     = 0;
 }
 
 void LTimer::pause() {
@@ -255,9 +440,9 @@ void LTimer::pause() {
     //Pause the timer
     m_paused = true;
 
-    //Calculate the paused ticks
-    m_pausedTicks = SDL_GetTicks() - m_startTicks;
-    m_startTicks = 0;
+    //Calculate the paused counts
+    m_pausedCounts = SDL_GetPerformanceCounter() - m_startCounts;
+    m_startCounts = 0;
   }
 }
 
@@ -267,30 +452,98 @@ void LTimer::unpause() {
     //Unpause the timer
     m_paused = false;
 
-    //Reset the starting ticks
-    m_startTicks = SDL_GetTicks() - m_pausedTicks;
+    //Reset the starting counts
+    m_startCounts = SDL_GetPerformanceCounter() - m_pausedCounts;
 
-    //Reset the paused ticks
-    m_pausedTicks = 0;
+    //Reset the paused counts
+    m_pausedCounts = 0;
   }
 }
 
-Uint32 LTimer::getTicks() {
+Uint64 LTimer::getTicks() {
+  return getNanoseconds() / 1000000;
+}
+
+Uint64 LTimer::getNanoseconds() {
   //The actual timer time
-  Uint32 time = 0;
+  Uint64 counts = 0;
 
   //If the timer is running
   if(m_started) {
     //If the timer is paused
     if(m_paused) {
-      //Return the number of ticks when the timer was paused
-      time = m_pausedTicks;
+      //Return the number of counts when the timer was paused
+      counts = m_pausedCounts;
     } else {
-      //Return the current time minus the start time
-      time = SDL_GetTicks() - m_startTicks;
+      //Return the current counter minus the start
+      counts = SDL_GetPerformanceCounter() - m_startCounts;
     }
   }
-  return time;
+  return toNanoseconds(counts);
+}
+
+double LTimer::getSeconds() {
+  return getNanoseconds() / 1000000000.0;
+}
+
+Uint64 LTimer::lap() {
+  //Close the lap at the current time
+  Uint64 now = getNanoseconds();
+  Uint64 length = now - m_lapStart;
+  m_lapStart = now;
+
+  //Store it over the oldest
+  m_laps[m_nextLap] = length;
+  m_nextLap = (m_nextLap + 1) % ROLLING_LAPS;
+  if(m_lapCount < ROLLING_LAPS) {
+    ++m_lapCount;
+  }
+  return length;
+}
+
+Uint64 LTimer::split() {
+  return getNanoseconds() - m_lapStart;
+}
+
+int LTimer::getLapCount() {
+  return m_lapCount;
+}
+
+Uint64 LTimer::getLastLap() {
+  if(m_lapCount == 0) {
+    return 0;
+  }
+  return m_laps[(m_nextLap + ROLLING_LAPS - 1) % ROLLING_LAPS];
+}
+
+Uint64 LTimer::getLapAverage() {
+  if(m_lapCount == 0) {
+    return 0;
+  }
+  Uint64 total = 0;
+  for(int i = 0; i < m_lapCount; ++i) {
+    total += m_laps[i];
+  }
+  return total / m_lapCount;
+}
+
+Uint64 LTimer::getLapMin() {
+  if(m_lapCount == 0) {
+    return 0;
+  }
+  Uint64 shortest = m_laps[0];
+  for(int i = 1; i < m_lapCount; ++i) {
+    shortest = std::min(shortest, m_laps[i]);
+  }
+  return shortest;
+}
+
+Uint64 LTimer::getLapMax() {
+  Uint64 longest = 0;
+  for(int i = 0; i < m_lapCount; ++i) {
+    longest = std::max(longest, m_laps[i]);
+  }
+  return longest;
 }
 
 bool LTimer::isStarted() {
@@ -303,6 +556,374 @@ bool LTimer::isPaused() {
   return m_paused && m_started;
 }
 
+Uint64 LTimer::toNanoseconds(Uint64 counts) {
+  //Split the division so the multiply cannot overflow
+  Uint64 frequency = SDL_GetPerformanceFrequency();
+  return counts / frequency * 1000000000 + counts % frequency * 1000000000 / frequency;
+}
+
+LGlyphCache::LGlyphCache() {
+  //Initialize
+  m_texture    = NULL;
+  m_width      = 0;
+  m_height     = 0;
+  m_lineHeight = 0;
+}
+
+LGlyphCache::~LGlyphCache() {
+  //Deallocate
+  free();
+}
+
+bool LGlyphCache::loadFromFont(TTF_Font *font) {
+  //Get rid of preexisting atlas
+  free();
+
+  //Glyphs are rendered white so any color can be applied when drawing
+  SDL_Color white = {0xFF, 0xFF, 0xFF, 0xFF};
+  SDL_Surface *surfaces[TOTAL_GLYPHS];
+
+  //Render each glyph and place it on a shelf of the atlas
+  int x = 0, y = 0, shelfHeight = 0;
+  for(int i = 0; i < TOTAL_GLYPHS; ++i) {
+    char text[2] = {(char)(FIRST_GLYPH + i), '\0'};
+    surfaces[i] = TTF_RenderText_Blended(font, text, white);
+
+    //Surfaces start at the leftmost pixel the glyph reaches
+    int minX = 0, maxX = 0, minY = 0, maxY = 0, advance = 0;
+    TTF_GlyphMetrics(font, FIRST_GLYPH + i, &minX, &maxX, &minY, &maxY, &advance);
+    m_glyphs[i].offset  = minX < 0 ? minX : 0;
+    m_glyphs[i].advance = advance;
+
+    SDL_Rect clip = {0, 0, 0, 0};
+    if(surfaces[i] != NULL) {
+      if(x + surfaces[i]->w > ATLAS_WIDTH) {
+	x = 0;
+	y += shelfHeight + 1;
+	shelfHeight = 0;
+      }
+      clip.x = x;
+      clip.y = y;
+      clip.w = surfaces[i]->w;
+      clip.h = surfaces[i]->h;
+      x += clip.w + 1;
+      if(clip.h > shelfHeight) {
+	shelfHeight = clip.h;
+      }
+    }
+    m_glyphs[i].clip = clip;
+  }
+
+  //Copy glyphs with their alpha into one surface
+  bool success = true;
+  SDL_Surface *atlasSurface = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_WIDTH, y + shelfHeight, 32, SDL_PIXELFORMAT_RGBA32);
+  if(atlasSurface == NULL) {
+    printf("Unable to create glyph atlas! SDL Error: %s\n", SDL_GetError());
+    success = false;
+  } else {
+    SDL_FillRect(atlasSurface, NULL, SDL_MapRGBA(atlasSurface->format, 0xFF, 0xFF, 0xFF, 0));
+    for(int i = 0; i < TOTAL_GLYPHS; ++i) {
+      if(surfaces[i] != NULL) {
+	SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE);
+	SDL_BlitSurface(surfaces[i], NULL, atlasSurface, &m_glyphs[i].clip);
+      }
+    }
+
+    //Create texture from atlas pixels
+    m_texture = SDL_CreateTextureFromSurface(g_renderer, atlasSurface);
+    if(m_texture == NULL) {
+      printf("Unable to create glyph texture! SDL Error: %s\n", SDL_GetError());
+      success = false;
+    } else {
+      SDL_SetTextureBlendMode(m_texture, SDL_BLENDMODE_BLEND);
+      m_width  = atlasSurface->w;
+      m_height = atlasSurface->h;
+    }
+    SDL_FreeSurface(atlasSurface);
+  }
+
+  //Get rid of glyph surfaces
+  for(int i = 0; i < TOTAL_GLYPHS; ++i) {
+    SDL_FreeSurface(surfaces[i]);
+  }
+
+  //Look up kerning once for every pair
+  m_kerning.assign(TOTAL_GLYPHS * TOTAL_GLYPHS, 0);
+  if(TTF_GetFontKerning(font)) {
+    for(int left = 0; left < TOTAL_GLYPHS; ++left) {
+      for(int right = 0; right < TOTAL_GLYPHS; ++right) {
+	m_kerning[left * TOTAL_GLYPHS + right] =
+	  TTF_GetFontKerningSizeGlyphs(font, FIRST_GLYPH + left, FIRST_GLYPH + right);
+      }
+    }
+  }
+  m_lineHeight = TTF_FontLineSkip(font);
+
+  if(!success) {
+    free();
+  }
+  return success;
+}
+
+void LGlyphCache::free() {
+  //Free atlas if it exists
+  if(m_texture != NULL) {
+    SDL_DestroyTexture(m_texture);
+    m_texture = NULL;
+    m_width   = 0;
+    m_height  = 0;
+  }
+  m_kerning.clear();
+}
+
+int LGlyphCache::glyphIndex(char c) {
+  if(c < FIRST_GLYPH || c > LAST_GLYPH) {
+    c = '?';
+  }
+  return c - FIRST_GLYPH;
+}
+
+void LGlyphCache::render(const char *text, int x, int y, SDL_Color color) {
+  if(m_texture == NULL) {
+    return;
+  }
+
+  //Lay out one quad per glyph
+  m_vertices.clear();
+  int pen = x;
+  int previous = -1;
+  for(const char *c = text; *c != '\0'; ++c) {
+    int index = glyphIndex(*c);
+    Glyph &glyph = m_glyphs[index];
+    if(previous != -1) {
+      pen += m_kerning[previous * TOTAL_GLYPHS + index];
+    }
+    previous = index;
+
+    //Quad corners on screen
+    float left   = (float)(pen + glyph.offset);
+    float top    = (float)y;
+    float right  = left + glyph.clip.w;
+    float bottom = top + glyph.clip.h;
+
+    //Quad corners in the atlas
+    float u0 = (float)glyph.clip.x / m_width;
+    float v0 = (float)glyph.clip.y / m_height;
+    float u1 = (float)(glyph.clip.x + glyph.clip.w) / m_width;
+    float v1 = (float)(glyph.clip.y + glyph.clip.h) / m_height;
+
+    SDL_Vertex quad[4] = {
+      {{left,  top},    color, {u0, v0}},
+      {{right, top},    color, {u1, v0}},
+      {{right, bottom}, color, {u1, v1}},
+      {{left,  bottom}, color, {u0, v1}}
+    };
+    m_vertices.insert(m_vertices.end(), quad, quad + 4);
+    pen += glyph.advance;
+  }
+
+  int totalQuads = m_vertices.size() / 4;
+  if(totalQuads == 0) {
+    return;
+  }
+
+  //Extend the shared index list to cover every quad
+  for(int q = m_indices.size() / 6; q < totalQuads; ++q) {
+    int first = q * 4;
+    int indices[6] = {first, first + 1, first + 2, first, first + 2, first + 3};
+    m_indices.insert(m_indices.end(), indices, indices + 6);
+  }
+
+  //Render the whole string in one call
+  SDL_RenderGeometry(g_renderer, m_texture, &m_vertices[0], m_vertices.size(), &m_indices[0], totalQuads * 6);
+}
+
+int LGlyphCache::getTextWidth(const char *text) {
+  int pen = 0, width = 0;
+  int previous = -1;
+  for(const char *c = text; *c != '\0'; ++c) {
+    int index = glyphIndex(*c);
+    Glyph &glyph = m_glyphs[index];
+    if(previous != -1 && !m_kerning.empty()) {
+      pen += m_kerning[previous * TOTAL_GLYPHS + index];
+    }
+    previous = index;
+
+    //Either the pen or the glyph's right edge may be furthest out
+    if(pen + glyph.offset + glyph.clip.w > width) {
+      width = pen + glyph.offset + glyph.clip.w;
+    }
+    pen += glyph.advance;
+  }
+  return pen > width ? pen : width;
+}
+
+int LGlyphCache::getLineHeight() {
+  return m_lineHeight;
+}
+
+LFrameStats::LFrameStats() {
+  //Initialize
+  SDL_AtomicSet(&m_recorded, 0);
+  memset(m_window, 0, sizeof(m_window));
+  memset(m_histogram, 0, sizeof(m_histogram));
+  m_max    = 0;
+  m_missed = 0;
+  m_budget = FRAME_BUDGET;
+}
+
+void LFrameStats::setBudget(Uint64 nanoseconds) {
+  m_budget = nanoseconds;
+}
+
+Uint64 LFrameStats::getBudget() {
+  return m_budget;
+}
+
+void LFrameStats::record(Uint64 nanoseconds) {
+  //Store the frame before publishing the new count
+  int recorded = SDL_AtomicGet(&m_recorded);
+  m_window[recorded % RING_FRAMES] = nanoseconds;
+
+  //Count it for the lifetime figures
+  int bucket = std::min(nanoseconds / BUCKET_WIDTH, (Uint64)HISTOGRAM_BUCKETS - 1);
+  ++m_histogram[bucket];
+  m_max = std::max(m_max, nanoseconds);
+  if(nanoseconds > m_budget) {
+    ++m_missed;
+  }
+  SDL_AtomicSet(&m_recorded, recorded + 1);
+}
+
+void LFrameStats::copyWindow(std::vector<Uint64> &frames) {
+  int recorded = SDL_AtomicGet(&m_recorded);
+  int first = std::max(recorded - WINDOW_FRAMES, 0);
+  frames.clear();
+  for(int i = first; i < recorded; ++i) {
+    frames.push_back(m_window[i % RING_FRAMES]);
+  }
+
+  //Drop frames the recorder wrote over while they were copied, and the one it may be writing
+  int overwritten = SDL_AtomicGet(&m_recorded) + 1 - RING_FRAMES - first;
+  if(overwritten > 0) {
+    frames.erase(frames.begin(), frames.begin() + std::min(overwritten, (int)frames.size()));
+  }
+}
+
+LFrameStats::Summary LFrameStats::getWindow() {
+  std::vector<Uint64> frames;
+  copyWindow(frames);
+
+  Summary summary;
+  summary.frames = frames.size();
+  summary.missed = 0;
+  for(int i = 0; i < (int)frames.size(); ++i) {
+    if(frames[i] > m_budget) {
+      ++summary.missed;
+    }
+  }
+  std::sort(frames.begin(), frames.end());
+  summary.p50 = percentile(frames, 0.50);
+  summary.p95 = percentile(frames, 0.95);
+  summary.p99 = percentile(frames, 0.99);
+  summary.max = frames.empty() ? 0 : frames.back();
+  return summary;
+}
+
+LFrameStats::Summary LFrameStats::getLifetime() {
+  Summary summary;
+  summary.frames = SDL_AtomicGet(&m_recorded);
+  summary.missed = m_missed;
+  summary.p50    = histogramPercentile(0.50);
+  summary.p95    = histogramPercentile(0.95);
+  summary.p99    = histogramPercentile(0.99);
+  summary.max    = m_max;
+  return summary;
+}
+
+Uint64 LFrameStats::percentile(const std::vector<Uint64> &sorted, double fraction) {
+  if(sorted.empty()) {
+    return 0;
+  }
+
+  //Nearest rank
+  int rank = (int)ceil(fraction * sorted.size());
+  return sorted[std::max(rank, 1) - 1];
+}
+
+Uint64 LFrameStats::histogramPercentile(double fraction) {
+  int recorded = SDL_AtomicGet(&m_recorded);
+  if(recorded == 0) {
+    return 0;
+  }
+
+  //Walk up the buckets to the rank, reporting the bucket's upper edge
+  Uint64 rank = std::max((Uint64)ceil(fraction * recorded), (Uint64)1);
+  Uint64 counted = 0;
+  for(int i = 0; i < HISTOGRAM_BUCKETS - 1; ++i) {
+    counted += m_histogram[i];
+    if(counted >= rank) {
+      return std::min((i + 1) * BUCKET_WIDTH, m_max);
+    }
+  }
+  return m_max;
+}
+
+bool LFrameStats::writeCSV(std::string path) {
+  FILE *file = fopen(path.c_str(), "w");
+  if(file == NULL) {
+    printf("Unable to write %s!\n", path.c_str());
+    return false;
+  }
+
+  //Recent frames
+  std::vector<Uint64> frames;
+  copyWindow(frames);
+  int first = SDL_AtomicGet(&m_recorded) - (int)frames.size();
+  fprintf(file, "frame,ms\n");
+  for(int i = 0; i < (int)frames.size(); ++i) {
+    fprintf(file, "%d,%.4f\n", first + i, frames[i] / 1000000.0);
+  }
+
+  //Every frame, by length
+  fprintf(file, "\nbucket_ms,frames\n");
+  for(int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+    if(m_histogram[i] > 0) {
+      fprintf(file, "%.1f,%u\n", i * BUCKET_WIDTH / 1000000.0, m_histogram[i]);
+    }
+  }
+  return fclose(file) == 0;
+}
+
+bool LFrameStats::writeJSON(std::string path) {
+  FILE *file = fopen(path.c_str(), "w");
+  if(file == NULL) {
+    printf("Unable to write %s!\n", path.c_str());
+    return false;
+  }
+
+  Summary summaries[2] = {getWindow(), getLifetime()};
+  const char *names[2] = {"window", "lifetime"};
+  fprintf(file, "{\n  \"budget_ms\": %.4f,\n", m_budget / 1000000.0);
+  for(int i = 0; i < 2; ++i) {
+    fprintf(file, "  \"%s\": {\"frames\": %d, \"missed\": %d, \"p50_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f},\n",
+	    names[i], summaries[i].frames, summaries[i].missed, summaries[i].p50 / 1000000.0,
+	    summaries[i].p95 / 1000000.0, summaries[i].p99 / 1000000.0, summaries[i].max / 1000000.0);
+  }
+
+  //Non empty buckets as [start ms, frames]
+  fprintf(file, "  \"histogram\": [");
+  bool firstBucket = true;
+  for(int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+    if(m_histogram[i] > 0) {
+      fprintf(file, "%s[%.1f, %u]", firstBucket ? "" : ", ", i * BUCKET_WIDTH / 1000000.0, m_histogram[i]);
+      firstBucket = false;
+    }
+  }
+  fprintf(file, "]\n}\n");
+  return fclose(file) == 0;
+}
+
 bool loadMedia() {
  //Loading success flag
   bool success = true;
@@ -312,6 +933,9 @@ bool loadMedia() {
   if(g_font == NULL) {
     printf( "Failed to load lazy font! SDL_ttf Error: %s\n", TTF_GetError() );
     success = false;
+  } else if(!g_fontGlyphs.loadFromFont(g_font)) {
+    printf("Failed to cache font glyphs!\n");
+    success = false;
   }
   return success;
 }
@@ -370,7 +994,7 @@ bool init() {
 
 void close() {
   //Free loaded images
-  g_FPSTextTexture.free();
+  g_fontGlyphs.free();
 
   //Free global font
   TTF_CloseFont(g_font);
@@ -388,7 +1012,30 @@ void close() {
   TTF_Quit();
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+  //Frame statistics
+  LFrameStats frameStats;
+
+  //Where to write the statistics at exit
+  std::string csvPath;
+  std::string jsonPath;
+
+  //Parse command line
+  for(int i = 1; i < argc; ++i) {
+    if(strcmp(argv[i], "--stats-csv") == 0 && i + 1 < argc) {
+      csvPath = argv[++i];
+    } else if(strcmp(argv[i], "--stats-json") == 0 && i + 1 < argc) {
+      jsonPath = argv[++i];
+    } else if(strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+      double budget = atof(argv[++i]);
+      if(budget > 0) {
+	frameStats.setBudget((Uint64)(budget * 1000000.0));
+      } else {
+	printf("Invalid frame budget, using %.2f ms\n", FRAME_BUDGET / 1000000.0);
+      }
+    }
+  }
+
   if(!init()) {
     printf("Failed to initialize!\n");
     return -1;
@@ -418,8 +1065,19 @@ int main() {
   int countedFrames = 0;
   fpsTimer.start();
 
+  //Times each frame, laps run from one frame start to the next
+  LTimer frameTimer;
+  frameTimer.start();
+
   //While application is running
   while(!quit) {
+    //Record how long the last frame took
+    if(countedFrames > 0) {
+      frameStats.record(frameTimer.lap());
+    } else {
+      frameTimer.lap();
+    }
+
     //Handle events on queue
     while(SDL_PollEvent(&e) != 0) {
       //User request quit
@@ -429,7 +1087,7 @@ int main() {
     }
 
     //Calculate and correct fps
-    float avgFPS = countedFrames / (fpsTimer.getTicks() / 1000.f);
+    float avgFPS = countedFrames / fpsTimer.getSeconds();
     if(avgFPS > 2000000) {
       avgFPS = 0;
     }
@@ -437,23 +1095,45 @@ int main() {
     //Set text to be rendered
     timeText.str("");
     timeText << "Average  Frames Per Second " << avgFPS;
-    
-    //Render text
-    if(!g_FPSTextTexture.loadFromRenderedText(timeText.str().c_str(), textColor)) {
-      printf("Unable to render FPS texture!\n");
-    }
 
+    //Recent frame times, where hitches show up
+    LFrameStats::Summary window = frameStats.getWindow();
+    char percentileText[128];
+    snprintf(percentileText, sizeof(percentileText), "p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms",
+	     window.p50 / 1000000.0, window.p95 / 1000000.0, window.p99 / 1000000.0, window.max / 1000000.0);
+    char missedText[128];
+    snprintf(missedText, sizeof(missedText), "Over %.1f ms: %d of last %d, %d in all",
+	     frameStats.getBudget() / 1000000.0, window.missed, window.frames, frameStats.getLifetime().missed);
+    
     //Clear screen
     SDL_SetRenderDrawColor(g_renderer, 0xFF, 0xFF, 0xFF, 0xFF);
     SDL_RenderClear(g_renderer);
     
-    //Render current texture
-    g_FPSTextTexture.render((SCREEN_WIDTH - g_FPSTextTexture.getWidth()) / 2, (SCREEN_HEIGHT - g_FPSTextTexture.getHeight()) / 2);
+    //Render text from the cached glyphs, no texture is created
+    std::string text = timeText.str();
+    g_fontGlyphs.render(text.c_str(), (SCREEN_WIDTH - g_fontGlyphs.getTextWidth(text.c_str())) / 2,
+			(SCREEN_HEIGHT - g_fontGlyphs.getLineHeight()) / 2, textColor);
+    g_fontGlyphs.render(percentileText, (SCREEN_WIDTH - g_fontGlyphs.getTextWidth(percentileText)) / 2,
+			(SCREEN_HEIGHT + g_fontGlyphs.getLineHeight()) / 2, textColor);
+    g_fontGlyphs.render(missedText, (SCREEN_WIDTH - g_fontGlyphs.getTextWidth(missedText)) / 2,
+			(SCREEN_HEIGHT + 3 * g_fontGlyphs.getLineHeight()) / 2, textColor);
     
     //Update screen
     SDL_RenderPresent(g_renderer);
     ++countedFrames;
   }
+
+  //Write statistics for comparing runs
+  LFrameStats::Summary lifetime = frameStats.getLifetime();
+  printf("%d frames, p50 %.2f p95 %.2f p99 %.2f max %.2f ms, %d over budget\n", lifetime.frames,
+	 lifetime.p50 / 1000000.0, lifetime.p95 / 1000000.0, lifetime.p99 / 1000000.0,
+	 lifetime.max / 1000000.0, lifetime.missed);
+  if(!csvPath.empty()) {
+    frameStats.writeCSV(csvPath);
+  }
+  if(!jsonPath.empty()) {
+    frameStats.writeJSON(jsonPath);
+  }
   close();
   return 0;
 }
@@ -61,8 +61,8 @@ public:
   static const int DOT_WIDTH  = 20;
   static const int DOT_HEIGHT = 20;
 
-  //Maximum axis velocity of the dot
-  static const int DOT_VEL = 10;
+  //Maximum axis velocity of the dot in pixels per tick, 600 a second
+  static const int DOT_VEL = 5;
 
   //Initializes the variables
   dot();
@@ -70,22 +70,65 @@ public:
   //Takes key presses and adjusts the dot's velocity
   void handleEvent(SDL_Event &e);
 
-  //Moves the dot
+  //Moves the dot one tick
   void move();
 
-  //Shows the dot on the screen
-  void render();
+  //Shows the dot between its last two ticks
+  void render(double alpha);
 
 private:
   //The X and Y offsets of the dot
   int m_posX;
   int m_posY;
 
+  //The offsets before the last tick
+  int m_prevX;
+  int m_prevY;
+
   //The velocity of the dot
   int m_velX;
   int m_velY;
 };
 
+//Runs the simulation in fixed ticks however often frames are drawn
+class LFixedTimestep {
+public:
+  //Simulation ticks per second
+  static const int TICKS_PER_SECOND = 120;
+
+  //Most ticks run for one frame, time past that is dropped so a slow
+  //frame cannot make the next one slower still
+  static const int MAX_TICKS_PER_FRAME = 8;
+
+  //Initializes variables
+  LFixedTimestep();
+
+  //Starts timing from now
+  void start();
+
+  //Adds the time since the last call and returns how many ticks to run
+  int advance();
+
+  //Gets how far the time is from the last tick to the next, from 0 to 1
+  double getAlpha();
+
+  //Gets the number of ticks dropped by the frame limit
+  Uint64 getDroppedTicks();
+
+private:
+  //Performance counter ticks per simulation tick
+  Uint64 m_tickCounts;
+
+  //Counter value at the last advance
+  Uint64 m_lastCounts;
+
+  //Time not yet simulated
+  Uint64 m_accumulator;
+
+  //Ticks dropped by the frame limit
+  Uint64 m_dropped;
+};
+
 //The window we'll be rendering to
 SDL_Window *g_window = NULL;
 
@@ -220,8 +263,10 @@ void LTexture::setAlpha(Uint8 alpha) {
 
 dot::dot() {
   //Initialize the offsets
-  m_posX = 0;
-  m_posX = 0;
+  m_posX  = 0;
+  m_posY  = 0;
+  m_prevX = 0;
+  m_prevY = 0;
 
   //Initialize the velocity
   m_velX = 0;
@@ -258,6 +303,10 @@ void dot::handleEvent(SDL_Event &e) {
 }
 
 void dot::move() {
+  //Remember where the tick started for interpolation
+  m_prevX = m_posX;
+  m_prevY = m_posY;
+
   //Move the dot left or right
   m_posX += m_velX;
 
@@ -277,9 +326,49 @@ void dot::move() {
   }
 }
 
-void dot::render() {
-  //Show the dot
-  g_dotTexture.render(m_posX, m_posY);
+void dot::render(double alpha) {
+  //Show the dot part way from its last position to its current one
+  g_dotTexture.render((int)floor(m_prevX + (m_posX - m_prevX) * alpha + 0.5),
+		      (int)floor(m_prevY + (m_posY - m_prevY) * alpha + 0.5));
+}
+
+LFixedTimestep::LFixedTimestep() {
+  //Initialize
+  m_tickCounts  = SDL_GetPerformanceFrequency() / TICKS_PER_SECOND;
+  m_lastCounts  = 0;
+  m_accumulator = 0;
+  m_dropped     = 0;
+}
+
+void LFixedTimestep::start() {
+  m_lastCounts  = SDL_GetPerformanceCounter();
+  m_accumulator = 0;
+}
+
+int LFixedTimestep::advance() {
+  //Bank the time since the last frame
+  Uint64 now = SDL_GetPerformanceCounter();
+  m_accumulator += now - m_lastCounts;
+  m_lastCounts = now;
+
+  //Run the whole ticks that fit, keeping the remainder for the next frame
+  Uint64 ticks = m_accumulator / m_tickCounts;
+  if(ticks > (Uint64)MAX_TICKS_PER_FRAME) {
+    //Too far behind to catch up, let the simulation fall back instead
+    m_dropped += ticks - MAX_TICKS_PER_FRAME;
+    ticks = MAX_TICKS_PER_FRAME;
+    m_accumulator = m_accumulator % m_tickCounts + ticks * m_tickCounts;
+  }
+  m_accumulator -= ticks * m_tickCounts;
+  return (int)ticks;
+}
+
+double LFixedTimestep::getAlpha() {
+  return (double)m_accumulator / m_tickCounts;
+}
+
+Uint64 LFixedTimestep::getDroppedTicks() {
+  return m_dropped;
 }
 
 bool loadMedia() {
@@ -376,6 +465,10 @@ int main() {
   //The dot that will be moving around on the screen
   dot dot;
 
+  //Movement runs at a fixed rate whatever the display refresh rate
+  LFixedTimestep timestep;
+  timestep.start();
+
   //While application is running
   while(!quit) {
     //Handle events on queue
@@ -388,15 +481,18 @@ int main() {
       dot.handleEvent(e);
     }
 
-    //Move the dot
-    dot.move();
+    //Move the dot once for every tick that passed
+    int ticks = timestep.advance();
+    for(int i = 0; i < ticks; ++i) {
+      dot.move();
+    }
 
     //Clear screen
     SDL_SetRenderDrawColor(g_renderer, 0xFF, 0xFF, 0xFF, 0xFF);
     SDL_RenderClear(g_renderer);
 
     //render objects
-    dot.render();
+    dot.render(timestep.getAlpha());
     
     //Update screen
     SDL_RenderPresent(g_renderer);
@@ -5,10 +5,62 @@
 #include <string>
 #include <cmath>
 #include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
 const int SCREEN_HEIGHT = 480;
 const int SCREEN_WIDTH  = 640;
 
+//Broad phase grid cell size, a little larger than a dot
+const int GRID_CELL_SIZE = 32;
+
+//Frames between stress mode reports
+const int STRESS_REPORT_FRAMES = 60;
+
+//Dots and collider set tests used by the narrow phase benchmark, few enough dots to stay in cache
+const int BENCHMARK_DOTS  = 256;
+const int BENCHMARK_TESTS = 1 << 21;
+
+//Rectangles stored edge by edge so one box is tested against several at once
+class RectBlock {
+public:
+  //Rectangles per test, one AVX2 register of 32 bit lanes
+  static const int WIDTH = 8;
+
+  //Initializes variables
+  RectBlock();
+
+  //Copies rectangles in, storage only grows when the count does
+  void assign(std::vector<SDL_Rect> &rects);
+
+  //Gets number of rectangles
+  int size();
+
+  //Gets a bit per rectangle in [first, first + WIDTH) that overlaps box
+  Uint32 hitMask(SDL_Rect &box, int first);
+
+  //Gets the first rectangle overlapping box, -1 if none does
+  int firstHit(SDL_Rect &box);
+
+private:
+  //Rectangle edges, padded to a whole number of tests with rectangles nothing overlaps
+  std::vector<Sint32> m_left;
+  std::vector<Sint32> m_top;
+  std::vector<Sint32> m_right;
+  std::vector<Sint32> m_bottom;
+
+  //Number of real rectangles
+  int m_size;
+};
+
 //Texture wrapper class
 class LTexture {
 public:
@@ -54,6 +106,50 @@ private:
   int m_height;
 };
 
+//Pixel exact collision shape stored as one bit per pixel, 64 pixels per word
+class CollisionMask {
+public:
+  //Alpha at or above which a pixel is solid
+  static const Uint8 ALPHA_THRESHOLD = 0x80;
+
+  //Initializes variables
+  CollisionMask();
+
+  //Loads image at specified path, color keyed like LTexture
+  bool loadFromFile(std::string path);
+
+  //Builds mask from surface, color keyed or transparent pixels are empty
+  bool loadFromSurface(SDL_Surface *surface);
+
+  //Deallocates mask
+  void free();
+
+  //Gets 64 bits of a row starting at given column, columns outside the mask are empty
+  Uint64 getBits(int row, int column);
+
+  //Gets mask dimensions
+  int getWidth();
+  int getHeight();
+
+private:
+  //Row bits, each row padded to whole words
+  std::vector<Uint64> m_bits;
+
+  //Words per row
+  int m_wordsPerRow;
+
+  //Mask dimensions
+  int m_width;
+  int m_height;
+};
+
+//Narrow phase used by stress mode
+enum NarrowPhase {
+  NARROW_LOOPS,
+  NARROW_BLOCK,
+  NARROW_MASK
+};
+
 //The dot that will move around on the screen
 class dot {
 public:
@@ -71,7 +167,16 @@ public:
   void handleEvent(SDL_Event &e);
 
   //Moves the dot and checks collision
-  void move(std::vector<SDL_Rect> &otherColliders);
+  void move(dot &other);
+
+  //Checks collision with another dot
+  bool checkCollision(dot &other, NarrowPhase narrow = NARROW_MASK);
+
+  //Moves the dot without collision and bounces off the screen edges
+  void wander();
+
+  //Sets the dot's velocity
+  void setVelocity(int velX, int velY);
 
   //Shows the dot on the screen
   void render();
@@ -79,6 +184,12 @@ public:
   //Gets the collision boxes
   std::vector<SDL_Rect> &getColliders();
 
+  //Gets the collision boxes laid out for batch tests
+  RectBlock &getColliderBlock();
+
+  //Gets the box around every collider
+  SDL_Rect getBox();
+
 private:
   //The X and Y offsets of the dot
   int m_posX;
@@ -88,13 +199,50 @@ private:
   int m_velX;
   int m_velY;
 
-  //Dot's collision boxex
+  //Dot's hand placed collision boxex, kept to compare against the mask
   std::vector<SDL_Rect> m_colliders;
 
+  //Copy of the collision boxes for batch tests
+  RectBlock m_colliderBlock;
+
   //Moves the collision boxes relative to the dot's offset
   void shiftColliders();
 };
 
+//Uniform grid broad phase, buckets boxes by the cells they touch
+class SpatialGrid {
+public:
+  //Covers the level with square cells
+  SpatialGrid(int levelWidth, int levelHeight, int cellSize);
+
+  //Buckets every box, storage is reused between frames
+  void build(std::vector<SDL_Rect> &boxes);
+
+  //Finds every pair of overlapping boxes once, returns the number of box tests made
+  int findPairs(std::vector<SDL_Rect> &boxes, std::vector< std::pair<int, int> > &pairs);
+
+private:
+  //Gets the cells touched by a box, clamped to the grid
+  void cellRange(SDL_Rect &box, int &firstX, int &firstY, int &lastX, int &lastY);
+
+  //Gets the cell holding a point, clamped to the grid
+  int cellAt(int x, int y);
+
+  //Cell dimensions
+  int m_cellSize;
+  int m_columns;
+  int m_rows;
+
+  //Where each cell's entries start, one past the end for the last cell
+  std::vector<int> m_cellStart;
+
+  //Next free entry of each cell while building
+  std::vector<int> m_cursor;
+
+  //Box indices sorted by cell
+  std::vector<int> m_entries;
+};
+
 //Start up SDL and creates window
 bool init();
 
@@ -107,6 +255,24 @@ void close();
 //Box collision detector
 bool checkCollision(std::vector<SDL_Rect> &a, std::vector<SDL_Rect> &b);
 
+//Box collision detector testing each A box against a block of B boxes
+bool checkCollision(std::vector<SDL_Rect> &a, RectBlock &b);
+
+//Single box collision detector
+bool checkCollision(SDL_Rect &a, SDL_Rect &b);
+
+//Pixel collision detector for masks placed at given offsets
+bool checkCollision(CollisionMask &a, int aX, int aY, CollisionMask &b, int bX, int bY);
+
+//Finds overlapping box pairs by testing every box against every other, returns tests made
+int findPairsBruteForce(std::vector<SDL_Rect> &boxes, std::vector< std::pair<int, int> > &pairs);
+
+//Moves many dots and collides them, reporting broad and narrow phase cost
+void runStress(int totalDots, bool bruteForce, NarrowPhase narrow);
+
+//Compares nested loop, batch and mask narrow phases
+void runBenchmark();
+
 //The window we'll be rendering to
 SDL_Window *g_window = NULL;
 
@@ -116,6 +282,9 @@ SDL_Renderer *g_renderer = NULL;
 //Scene textures
 LTexture g_dotTexture;
 
+//Dot collision shape
+CollisionMask g_dotMask;
+
 LTexture::LTexture() {
   //Initialize
   m_texture = NULL;
@@ -315,14 +484,14 @@ void dot::handleEvent(SDL_Event &e) {
     }
   }
 }
-void dot::move( std::vector<SDL_Rect>& otherColliders ) {
+void dot::move(dot &other) {
   //Move the dot left or right
   m_posX += m_velX;
   shiftColliders();
   
   //If the dot collided or went too far to the left or right
   if((m_posX < 0 ) || (m_posX + DOT_WIDTH > SCREEN_WIDTH) || 
-     checkCollision(m_colliders, otherColliders)) {
+     checkCollision(other)) {
     //Move back
     m_posX -= m_velX;
     shiftColliders();
@@ -334,7 +503,7 @@ void dot::move( std::vector<SDL_Rect>& otherColliders ) {
   
   //If the dot collided or went too far up or down
   if((m_posY < 0) || (m_posY + DOT_HEIGHT > SCREEN_HEIGHT) || 
-     checkCollision(m_colliders, otherColliders)) {
+     checkCollision(other)) {
     //Move back
     m_posY -= m_velY;
     shiftColliders();
@@ -361,12 +530,335 @@ void dot::shiftColliders() {
     //Move the row offset down the height of the collision box
     r += m_colliders[set].h;
   }
+
+  //Keep the batch copy in step
+  m_colliderBlock.assign(m_colliders);
 }
 
 std::vector<SDL_Rect> &dot::getColliders() {
   return m_colliders;
 }
 
+RectBlock &dot::getColliderBlock() {
+  return m_colliderBlock;
+}
+
+bool dot::checkCollision(dot &other, NarrowPhase narrow) {
+  switch(narrow) {
+  case NARROW_LOOPS: return ::checkCollision(m_colliders, other.m_colliders);
+  case NARROW_BLOCK: return ::checkCollision(m_colliders, other.m_colliderBlock);
+  default:           return ::checkCollision(g_dotMask, m_posX, m_posY, g_dotMask, other.m_posX, other.m_posY);
+  }
+}
+
+CollisionMask::CollisionMask() {
+  //Initialize
+  m_wordsPerRow = 0;
+  m_width  = 0;
+  m_height = 0;
+}
+
+bool CollisionMask::loadFromFile(std::string path) {
+  //Load image at specified path
+  SDL_Surface *loadedSurface = IMG_Load(path.c_str());
+  if(loadedSurface == NULL) {
+    printf("Unable to load image %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError());
+    return false;
+  }
+
+  //Color key image
+  SDL_SetColorKey(loadedSurface, SDL_TRUE, SDL_MapRGB(loadedSurface->format, 0, 0xFF, 0xFF));
+
+  bool success = loadFromSurface(loadedSurface);
+
+  //Get rid of old loaded surface
+  SDL_FreeSurface(loadedSurface);
+  return success;
+}
+
+bool CollisionMask::loadFromSurface(SDL_Surface *surface) {
+  //Get rid of preexisting mask
+  free();
+
+  //Get the color key if there is one
+  Uint32 colorKey = 0;
+  bool keyed = SDL_GetColorKey(surface, &colorKey) == 0;
+
+  if(SDL_LockSurface(surface) != 0) {
+    printf("Unable to lock surface! SDL Error: %s\n", SDL_GetError());
+    return false;
+  }
+
+  //Allocate empty rows
+  m_width  = surface->w;
+  m_height = surface->h;
+  m_wordsPerRow = (m_width + 63) / 64;
+  m_bits.assign(m_wordsPerRow * m_height, 0);
+
+  //Go through the pixels
+  int bytesPerPixel = surface->format->BytesPerPixel;
+  for(int y = 0; y < m_height; ++y) {
+    Uint8 *row = (Uint8*)surface->pixels + y * surface->pitch;
+    for(int x = 0; x < m_width; ++x) {
+      //Read the raw pixel whatever its size
+      Uint8 *p = row + x * bytesPerPixel;
+      Uint32 pixel = 0;
+      switch(bytesPerPixel) {
+      case 1: pixel = *p; break;
+      case 2: pixel = *(Uint16*)p; break;
+      case 3:
+	if(SDL_BYTEORDER == SDL_BIG_ENDIAN) {
+	  pixel = p[0] << 16 | p[1] << 8 | p[2];
+	} else {
+	  pixel = p[0] | p[1] << 8 | p[2] << 16;
+	}
+	break;
+      case 4: pixel = *(Uint32*)p; break;
+      }
+
+      //Keyed pixels are empty, otherwise go by alpha
+      Uint8 r, g, b, a;
+      SDL_GetRGBA(pixel, surface->format, &r, &g, &b, &a);
+      if(!(keyed && pixel == colorKey) && a >= ALPHA_THRESHOLD) {
+	m_bits[y * m_wordsPerRow + x / 64] |= (Uint64)1 << (x % 64);
+      }
+    }
+  }
+
+  SDL_UnlockSurface(surface);
+  return true;
+}
+
+void CollisionMask::free() {
+  m_bits.clear();
+  m_wordsPerRow = 0;
+  m_width  = 0;
+  m_height = 0;
+}
+
+Uint64 CollisionMask::getBits(int row, int column) {
+  //Split the column into a word and a bit offset, rounding down for negative columns
+  int word  = column >= 0 ? column / 64 : -((63 - column) / 64);
+  int shift = column - word * 64;
+
+  //Fetch the two words the bits straddle
+  Uint64 *bits = &m_bits[row * m_wordsPerRow];
+  Uint64 low  = (word >= 0 && word < m_wordsPerRow) ? bits[word] : 0;
+  Uint64 high = (word + 1 >= 0 && word + 1 < m_wordsPerRow) ? bits[word + 1] : 0;
+  if(shift == 0) {
+    return low;
+  }
+  return (low >> shift) | (high << (64 - shift));
+}
+
+int CollisionMask::getWidth() {
+  return m_width;
+}
+
+int CollisionMask::getHeight() {
+  return m_height;
+}
+
+RectBlock::RectBlock() {
+  m_size = 0;
+}
+
+void RectBlock::assign(std::vector<SDL_Rect> &rects) {
+  m_size = rects.size();
+
+  //Round up to whole tests
+  int padded = (m_size + WIDTH - 1) / WIDTH * WIDTH;
+  m_left.resize(padded);
+  m_top.resize(padded);
+  m_right.resize(padded);
+  m_bottom.resize(padded);
+
+  //Copy edges
+  for(int i = 0; i < m_size; ++i) {
+    m_left[i]   = rects[i].x;
+    m_top[i]    = rects[i].y;
+    m_right[i]  = rects[i].x + rects[i].w;
+    m_bottom[i] = rects[i].y + rects[i].h;
+  }
+
+  //Padding is inside out so every comparison against it fails
+  for(int i = m_size; i < padded; ++i) {
+    m_left[i]   = INT_MAX;
+    m_top[i]    = INT_MAX;
+    m_right[i]  = INT_MIN;
+    m_bottom[i] = INT_MIN;
+  }
+}
+
+int RectBlock::size() {
+  return m_size;
+}
+
+Uint32 RectBlock::hitMask(SDL_Rect &box, int first) {
+  //The sides of the box
+  Sint32 left   = box.x;
+  Sint32 right  = box.x + box.w;
+  Sint32 top    = box.y;
+  Sint32 bottom = box.y + box.h;
+
+  //Overlap needs every side of the box past the opposite side of the rectangle,
+  //the same test as checkCollision with the comparisons flipped
+#ifdef __AVX2__
+  __m256i hit = _mm256_and_si256(
+    _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(bottom), _mm256_loadu_si256((__m256i*)&m_top[first])),
+		     _mm256_cmpgt_epi32(_mm256_loadu_si256((__m256i*)&m_bottom[first]), _mm256_set1_epi32(top))),
+    _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(right), _mm256_loadu_si256((__m256i*)&m_left[first])),
+		     _mm256_cmpgt_epi32(_mm256_loadu_si256((__m256i*)&m_right[first]), _mm256_set1_epi32(left))));
+  return _mm256_movemask_ps(_mm256_castsi256_ps(hit));
+#elif defined(__SSE2__) || defined(_M_X64)
+  Uint32 mask = 0;
+  for(int half = 0; half < WIDTH; half += 4) {
+    int i = first + half;
+    __m128i hit = _mm_and_si128(
+      _mm_and_si128(_mm_cmpgt_epi32(_mm_set1_epi32(bottom), _mm_loadu_si128((__m128i*)&m_top[i])),
+		    _mm_cmpgt_epi32(_mm_loadu_si128((__m128i*)&m_bottom[i]), _mm_set1_epi32(top))),
+      _mm_and_si128(_mm_cmpgt_epi32(_mm_set1_epi32(right), _mm_loadu_si128((__m128i*)&m_left[i])),
+		    _mm_cmpgt_epi32(_mm_loadu_si128((__m128i*)&m_right[i]), _mm_set1_epi32(left))));
+    mask |= _mm_movemask_ps(_mm_castsi128_ps(hit)) << half;
+  }
+  return mask;
+#else
+  Uint32 mask = 0;
+  for(int lane = 0; lane < WIDTH; ++lane) {
+    int i = first + lane;
+    if((bottom > m_top[i]) & (m_bottom[i] > top) & (right > m_left[i]) & (m_right[i] > left)) {
+      mask |= 1u << lane;
+    }
+  }
+  return mask;
+#endif
+}
+
+int RectBlock::firstHit(SDL_Rect &box) {
+  //Go through the rectangles a test at a time
+  for(int first = 0; first < m_size; first += WIDTH) {
+    Uint32 mask = hitMask(box, first);
+    if(mask != 0) {
+      //Find the lowest set bit
+      int lane = 0;
+      while((mask & 1) == 0) {
+	mask >>= 1;
+	++lane;
+      }
+      return first + lane;
+    }
+  }
+  return -1;
+}
+
+SDL_Rect dot::getBox() {
+  SDL_Rect box = {m_posX, m_posY, DOT_WIDTH, DOT_HEIGHT};
+  return box;
+}
+
+void dot::wander() {
+  //Move the dot, turning around at the screen edges
+  m_posX += m_velX;
+  if((m_posX < 0) || (m_posX + DOT_WIDTH > SCREEN_WIDTH)) {
+    m_posX -= m_velX;
+    m_velX = -m_velX;
+  }
+
+  m_posY += m_velY;
+  if((m_posY < 0) || (m_posY + DOT_HEIGHT > SCREEN_HEIGHT)) {
+    m_posY -= m_velY;
+    m_velY = -m_velY;
+  }
+  shiftColliders();
+}
+
+void dot::setVelocity(int velX, int velY) {
+  m_velX = velX;
+  m_velY = velY;
+}
+
+SpatialGrid::SpatialGrid(int levelWidth, int levelHeight, int cellSize) {
+  //Set grid dimensions
+  m_cellSize = cellSize;
+  m_columns  = (levelWidth + cellSize - 1) / cellSize;
+  m_rows     = (levelHeight + cellSize - 1) / cellSize;
+
+  //Allocate cell tables once
+  m_cellStart.resize(m_columns * m_rows + 1);
+  m_cursor.resize(m_columns * m_rows);
+}
+
+void SpatialGrid::cellRange(SDL_Rect &box, int &firstX, int &firstY, int &lastX, int &lastY) {
+  firstX = std::min(std::max(box.x / m_cellSize, 0), m_columns - 1);
+  firstY = std::min(std::max(box.y / m_cellSize, 0), m_rows - 1);
+  lastX  = std::min(std::max((box.x + box.w - 1) / m_cellSize, 0), m_columns - 1);
+  lastY  = std::min(std::max((box.y + box.h - 1) / m_cellSize, 0), m_rows - 1);
+}
+
+int SpatialGrid::cellAt(int x, int y) {
+  int cellX = std::min(std::max(x / m_cellSize, 0), m_columns - 1);
+  int cellY = std::min(std::max(y / m_cellSize, 0), m_rows - 1);
+  return cellY * m_columns + cellX;
+}
+
+void SpatialGrid::build(std::vector<SDL_Rect> &boxes) {
+  int firstX, firstY, lastX, lastY;
+
+  //Count entries per cell
+  std::fill(m_cellStart.begin(), m_cellStart.end(), 0);
+  for(int i = 0; i < (int)boxes.size(); ++i) {
+    cellRange(boxes[i], firstX, firstY, lastX, lastY);
+    for(int y = firstY; y <= lastY; ++y) {
+      for(int x = firstX; x <= lastX; ++x) {
+	++m_cellStart[y * m_columns + x + 1];
+      }
+    }
+  }
+
+  //Turn counts into start offsets
+  for(int c = 1; c < (int)m_cellStart.size(); ++c) {
+    m_cellStart[c] += m_cellStart[c - 1];
+  }
+  m_entries.resize(m_cellStart.back());
+  std::copy(m_cellStart.begin(), m_cellStart.end() - 1, m_cursor.begin());
+
+  //Place every box in its cells
+  for(int i = 0; i < (int)boxes.size(); ++i) {
+    cellRange(boxes[i], firstX, firstY, lastX, lastY);
+    for(int y = firstY; y <= lastY; ++y) {
+      for(int x = firstX; x <= lastX; ++x) {
+	m_entries[m_cursor[y * m_columns + x]++] = i;
+      }
+    }
+  }
+}
+
+int SpatialGrid::findPairs(std::vector<SDL_Rect> &boxes, std::vector< std::pair<int, int> > &pairs) {
+  int tests = 0;
+  pairs.clear();
+
+  //Go through the cells
+  for(int c = 0; c < m_columns * m_rows; ++c) {
+    int begin = m_cellStart[c];
+    int end   = m_cellStart[c + 1];
+
+    //Test every pair sharing this cell
+    for(int i = begin; i < end; ++i) {
+      for(int j = i + 1; j < end; ++j) {
+	SDL_Rect &a = boxes[m_entries[i]];
+	SDL_Rect &b = boxes[m_entries[j]];
+	++tests;
+
+	//Boxes sharing several cells are only reported by the cell holding their overlap's corner
+	if(checkCollision(a, b) && cellAt(std::max(a.x, b.x), std::max(a.y, b.y)) == c) {
+	  pairs.push_back(std::make_pair(m_entries[i], m_entries[j]));
+	}
+      }
+    }
+  }
+  return tests;
+}
+
 bool loadMedia() {
   //Loading success flag
   bool success = true;
@@ -376,6 +868,12 @@ bool loadMedia() {
     success = false;
   }
 
+  //Build the dot's collision shape from the same image
+  if(!g_dotMask.loadFromFile("dot.bmp")) {
+    printf("Failed to load dot collision mask!\n");
+    success = false;
+  }
+
   return success;
 }
 
@@ -414,6 +912,211 @@ bool checkCollision(std::vector<SDL_Rect> &a, std::vector<SDL_Rect> &b) {
   return false;
 }
 
+bool checkCollision(CollisionMask &a, int aX, int aY, CollisionMask &b, int bX, int bY) {
+  //Bounding boxes must overlap first
+  SDL_Rect boxA = {aX, aY, a.getWidth(), a.getHeight()};
+  SDL_Rect boxB = {bX, bY, b.getWidth(), b.getHeight()};
+  if(!checkCollision(boxA, boxB)) {
+    return false;
+  }
+
+  //The rows both masks cover
+  int top    = std::max(aY, bY);
+  int bottom = std::min(aY + a.getHeight(), bY + b.getHeight());
+
+  //The columns both masks cover, relative to A
+  int left  = std::max(aX, bX) - aX;
+  int right = std::min(aX + a.getWidth(), bX + b.getWidth()) - aX;
+
+  //AND each A word with the B bits under it
+  for(int y = top; y < bottom; ++y) {
+    for(int column = left - left % 64; column < right; column += 64) {
+      if(a.getBits(y - aY, column) & b.getBits(y - bY, column + aX - bX)) {
+	//A collision is detected
+	return true;
+      }
+    }
+  }
+  //If no solid pixels touched
+  return false;
+}
+
+bool checkCollision(std::vector<SDL_Rect> &a, RectBlock &b) {
+  //Go through the A boxes
+  for(int Abox = 0; Abox < (int)a.size(); Abox++) {
+    //Test against every B box at once
+    if(b.firstHit(a[Abox]) >= 0) {
+      //A collision is detected
+      return true;
+    }
+  }
+  //If neither set of collision boxes touched
+  return false;
+}
+
+bool checkCollision(SDL_Rect &a, SDL_Rect &b) {
+  //If no sides from A are outside of B
+  return ((a.y + a.h <= b.y) || (a.y >= b.y + b.h) ||
+	  (a.x + a.w <= b.x) || (a.x >= b.x + b.w)) == false;
+}
+
+int findPairsBruteForce(std::vector<SDL_Rect> &boxes, std::vector< std::pair<int, int> > &pairs) {
+  int tests = 0;
+  pairs.clear();
+
+  //Test every box against every later box
+  for(int i = 0; i < (int)boxes.size(); ++i) {
+    for(int j = i + 1; j < (int)boxes.size(); ++j) {
+      ++tests;
+      if(checkCollision(boxes[i], boxes[j])) {
+	pairs.push_back(std::make_pair(i, j));
+      }
+    }
+  }
+  return tests;
+}
+
+void runBenchmark() {
+  //Ticks per second of the high resolution counter
+  double frequency = (double)SDL_GetPerformanceFrequency();
+
+  //The mask comes from the sprite, no window is needed to read it
+  if(!g_dotMask.loadFromFile("dot.bmp")) {
+    printf("Failed to load dot collision mask!\n");
+    return;
+  }
+
+  //Pack dots tightly so a good share of the tests hit
+  std::vector<dot> dots;
+  dots.reserve(BENCHMARK_DOTS);
+  for(int i = 0; i < BENCHMARK_DOTS; ++i) {
+    dots.push_back(dot(rand() % 48, rand() % 48));
+  }
+
+  //Pick the pairs up front so both runs test the same ones
+  std::vector< std::pair<int, int> > pairs(BENCHMARK_TESTS);
+  for(int t = 0; t < BENCHMARK_TESTS; ++t) {
+    pairs[t] = std::make_pair(rand() % BENCHMARK_DOTS, rand() % BENCHMARK_DOTS);
+  }
+
+#ifdef __AVX2__
+  const char *kernel = "AVX2";
+#elif defined(__SSE2__) || defined(_M_X64)
+  const char *kernel = "SSE2";
+#else
+  const char *kernel = "scalar";
+#endif
+  printf("%d collision tests, %s batch kernel\n", BENCHMARK_TESTS, kernel);
+  printf("%12s %10s %8s\n", "narrow", "ns/test", "hits");
+
+  //Time every narrow phase on the same pairs
+  const NarrowPhase phases[] = {NARROW_LOOPS, NARROW_BLOCK, NARROW_MASK};
+  const char *names[] = {"nested loop", "batch", "mask"};
+  int hits[3];
+  for(int n = 0; n < 3; ++n) {
+    hits[n] = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for(int t = 0; t < BENCHMARK_TESTS; ++t) {
+      hits[n] += dots[pairs[t].first].checkCollision(dots[pairs[t].second], phases[n]);
+    }
+    double time = (SDL_GetPerformanceCounter() - start) * 1e9 / frequency / BENCHMARK_TESTS;
+    printf("%12s %10.2f %8d\n", names[n], time, hits[n]);
+  }
+
+  //Boxes only approximate the sprite, so only the two box tests must agree
+  if(hits[0] != hits[1]) {
+    printf("Error: box narrow phases disagree!\n");
+  }
+}
+
+void runStress(int totalDots, bool bruteForce, NarrowPhase narrow) {
+  //Ticks per second of the high resolution counter
+  double frequency = (double)SDL_GetPerformanceFrequency();
+
+  //Scatter dots over the screen with random velocities
+  std::vector<dot> dots;
+  dots.reserve(totalDots);
+  for(int i = 0; i < totalDots; ++i) {
+    dots.push_back(dot(rand() % (SCREEN_WIDTH - dot::DOT_WIDTH), rand() % (SCREEN_HEIGHT - dot::DOT_HEIGHT)));
+    dots.back().setVelocity(rand() % 5 - 2, rand() % 5 - 2);
+  }
+
+  //Per frame collision storage, reused every frame
+  SpatialGrid grid(SCREEN_WIDTH, SCREEN_HEIGHT, GRID_CELL_SIZE);
+  std::vector<SDL_Rect> boxes(totalDots);
+  std::vector< std::pair<int, int> > pairs;
+
+  //Totals since last report
+  Sint64 boxTests = 0;
+  Sint64 narrowTests = 0;
+  Sint64 collisions = 0;
+  Uint64 collisionTicks = 0;
+  Uint64 frameTicks = 0;
+  int frames = 0;
+
+  printf("Stress testing %d dots with %s broad phase and %s narrow phase\n", totalDots,
+	 bruteForce ? "brute force" : "grid", narrow == NARROW_LOOPS ? "nested loop" : narrow == NARROW_BLOCK ? "batch" : "mask");
+
+  bool quit = false;
+  SDL_Event e;
+  while(!quit) {
+    Uint64 frameStart = SDL_GetPerformanceCounter();
+
+    //Handle events on queue
+    while(SDL_PollEvent(&e) != 0) {
+      //User request quit
+      if(e.type == SDL_QUIT) {
+	quit = true;
+      }
+    }
+
+    //Move the dots
+    for(int i = 0; i < totalDots; ++i) {
+      dots[i].wander();
+      boxes[i] = dots[i].getBox();
+    }
+
+    //Broad phase finds candidate pairs, narrow phase tests their collider sets
+    Uint64 collisionStart = SDL_GetPerformanceCounter();
+    if(bruteForce) {
+      boxTests += findPairsBruteForce(boxes, pairs);
+    } else {
+      grid.build(boxes);
+      boxTests += grid.findPairs(boxes, pairs);
+    }
+    for(int p = 0; p < (int)pairs.size(); ++p) {
+      ++narrowTests;
+      if(dots[pairs[p].first].checkCollision(dots[pairs[p].second], narrow)) {
+	++collisions;
+      }
+    }
+    collisionTicks += SDL_GetPerformanceCounter() - collisionStart;
+
+    //Clear screen
+    SDL_SetRenderDrawColor(g_renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+    SDL_RenderClear(g_renderer);
+
+    //Render dots
+    for(int i = 0; i < totalDots; ++i) {
+      dots[i].render();
+    }
+
+    //Update screen
+    SDL_RenderPresent(g_renderer);
+    frameTicks += SDL_GetPerformanceCounter() - frameStart;
+
+    //Report averages per frame
+    if(++frames == STRESS_REPORT_FRAMES) {
+      printf("box tests %lld narrow tests %lld collisions %lld collision ms %.3f frame ms %.3f\n",
+	     (long long)(boxTests / frames), (long long)(narrowTests / frames), (long long)(collisions / frames),
+	     collisionTicks * 1000.0 / frequency / frames, frameTicks * 1000.0 / frequency / frames);
+      boxTests = narrowTests = collisions = 0;
+      collisionTicks = frameTicks = 0;
+      frames = 0;
+    }
+  }
+}
+
 bool init() {
   bool l_success = true;
   
@@ -479,7 +1182,37 @@ void close() {
   Mix_Quit();
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+  //Number of dots in stress mode, 0 runs the normal demo
+  int stressDots = 0;
+
+  //Stress test without the broad phase grid
+  bool bruteForce = false;
+
+  //Stress test narrow phase
+  NarrowPhase narrow = NARROW_MASK;
+
+  //Parse command line
+  for(int i = 1; i < argc; ++i) {
+    if(strcmp(argv[i], "--stress") == 0 && i + 1 < argc) {
+      stressDots = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--brute") == 0) {
+      bruteForce = true;
+    } else if(strcmp(argv[i], "--narrow") == 0 && i + 1 < argc) {
+      ++i;
+      if(strcmp(argv[i], "loops") == 0) {
+	narrow = NARROW_LOOPS;
+      } else if(strcmp(argv[i], "block") == 0) {
+	narrow = NARROW_BLOCK;
+      } else {
+	narrow = NARROW_MASK;
+      }
+    } else if(strcmp(argv[i], "--bench") == 0) {
+      runBenchmark();
+      return 0;
+    }
+  }
+
   if(!init()) {
     printf("Failed to initialize!\n");
     return -1;
@@ -490,6 +1223,12 @@ int main() {
     return -1;
   }
 
+  if(stressDots > 0) {
+    runStress(stressDots, bruteForce, narrow);
+    close();
+    return 0;
+  }
+
   bool quit = false;
   SDL_Event e;
 
@@ -512,7 +1251,7 @@ int main() {
     }
 
     //Move the dot and check collision
-    theDot.move(otherDot.getColliders());
+    theDot.move(otherDot);
 
     //Clear screen
     SDL_SetRenderDrawColor(g_renderer, 0xFF, 0xFF, 0xFF, 0xFF);
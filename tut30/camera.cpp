@@ -5,11 +5,23 @@
 #include <string>
 #include <cmath>
 #include <vector>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <deque>
 
 //The dimensions of the level
 const int LEVEL_WIDTH  = 1280;
 const int LEVEL_HEIGHT =  960;
 
+//Default number of static objects scattered over the level
+const int DEFAULT_LEVEL_OBJECTS = 200;
+
+//Seed for placing the level objects
+const unsigned int LEVEL_SEED = 30;
+
 //Screen domension constants
 const int SCREEN_HEIGHT = 480;
 const int SCREEN_WIDTH  = 640;
@@ -65,6 +77,148 @@ private:
   int m_height;
 };
 
+//Static bounding volume hierarchy over the level object boxes
+class StaticBVH {
+public:
+  //Maximum number of objects in a leaf
+  static const int LEAF_SIZE = 8;
+
+  //Builds the hierarchy, object indices refer to the given boxes
+  void build(std::vector<SDL_Rect> &boxes);
+
+  //Appends every object intersecting the area, returns the nodes visited
+  int query(SDL_Rect &area, std::vector<int> &results);
+
+  //Checks if any object intersects the area
+  bool overlaps(SDL_Rect &area);
+
+  //Gets an object's box
+  SDL_Rect &getBox(int index);
+
+  //Gets the number of objects
+  int size();
+
+private:
+  //Node bounds, leaves own m_order[first, first + count), inner nodes
+  //have their left child next to them and store the right one in first
+  struct Node {
+    int left, top, right, bottom;
+    int first;
+    int count;
+  };
+
+  //Builds the subtree over m_order[first, first + count), returns its node
+  int buildNode(int first, int count);
+
+  //Checks if a node's bounds intersect the area
+  static bool intersects(Node &node, SDL_Rect &area);
+
+  //The nodes in depth first order
+  std::vector<Node> m_nodes;
+
+  //Object indices grouped by leaf
+  std::vector<int> m_order;
+
+  //The object boxes
+  std::vector<SDL_Rect> m_boxes;
+
+  //Traversal stack kept between queries
+  std::vector<int> m_stack;
+};
+
+//Tile map split into chunks that are streamed in around the camera
+class TileMap {
+public:
+  //The dimensions of a tile
+  static const int TILE_SIZE = 80;
+
+  //The dimensions of a chunk in tiles and in pixels
+  static const int CHUNK_TILES = 32;
+  static const int CHUNK_SIZE  = TILE_SIZE * CHUNK_TILES;
+
+  //Chunks kept loaded around the ones the camera sees
+  static const int CHUNK_MARGIN = 1;
+
+  //Maximum number of chunks in memory
+  static const int MAX_RESIDENT_CHUNKS = 64;
+
+  //Initializes variables
+  TileMap();
+
+  //Stops the loader and frees the chunks
+  ~TileMap();
+
+  //Opens a map of the given size in tiles and starts the chunk loader,
+  //chunks without a file in the directory repeat the tileset in order
+  bool open(std::string directory, int widthTiles, int heightTiles, LTexture &tileset);
+
+  //Stops the loader and frees the chunks
+  void free();
+
+  //Picks up loaded chunks and requests the ones near the camera
+  void update(SDL_Rect &camera);
+
+  //Renders the loaded tiles the camera sees
+  void render(SDL_Rect &camera);
+
+  //Gets map dimensions
+  int getWidth();
+  int getHeight();
+
+  //Gets the number of chunks in memory
+  int getResidentChunks();
+
+private:
+  //A square of tile indices
+  struct Chunk {
+    int x, y;
+    bool loaded;
+    Uint32 lastUsed;
+    Uint16 tiles[CHUNK_TILES * CHUNK_TILES];
+  };
+
+  //Loads requested chunks until the map is freed
+  static int loaderThread(void *data);
+
+  //Reads a chunk's file or fills in the default tiles
+  void loadChunk(Chunk *chunk);
+
+  //Gets the chunk at a position if it is in memory
+  Chunk *findChunk(int x, int y);
+
+  //Gets a free chunk, evicting the least recently used one outside the area
+  Chunk *allocateChunk(SDL_Rect &keep);
+
+  //Where chunk files are read from
+  std::string m_directory;
+
+  //Map dimensions in tiles and in chunks
+  int m_widthTiles, m_heightTiles;
+  int m_widthChunks, m_heightChunks;
+
+  //The tile graphics
+  LTexture *m_tileset;
+  int m_tilesetColumns, m_tilesetRows;
+
+  //Every chunk there is memory for, and the ones not in use
+  std::vector<Chunk> m_chunks;
+  std::vector<Chunk*> m_freeChunks;
+
+  //Requested and loaded chunks by position
+  std::map<Sint64, Chunk*> m_resident;
+
+  //Frame counter for eviction
+  Uint32 m_frame;
+
+  //The loader thread and the queues it shares with the main thread
+  SDL_Thread *m_loader;
+  SDL_mutex *m_lock;
+  SDL_cond *m_requestsReady;
+  std::deque<Chunk*> m_requests;
+  std::vector<Chunk*> m_finished;
+  bool m_quit;
+};
+
 //The dot that will move around on the screen
 class dot {
 public:
@@ -72,8 +226,8 @@ public:
   static const int DOT_WIDTH  = 20;
   static const int DOT_HEIGHT = 20;
 
-  //Maximum axis velocity of the dot
-  static const int DOT_VEL = 10;
+  //Maximum axis velocity of the dot in pixels per tick, 600 a second
+  static const int DOT_VEL = 5;
 
   //Initializes the variables
   dot();
@@ -81,16 +235,20 @@ public:
   //Takes key presses and adjusts the dot's velocity
   void handleEvent(SDL_Event &e);
 
-  //Moves the dot and checks collision
-  void move();
+  //Moves the dot one tick and checks collision against the level objects
+  void move(StaticBVH &objects);
 
-  //Shows the dot on the screen
-  void render(int camX, int camY);
+  //Shows the dot on the screen between its last two ticks
+  void render(int camX, int camY, double alpha);
 
   //Position accessors
   int getPosX();
   int getPosY();
 
+  //Position between the last two ticks
+  int getRenderX(double alpha);
+  int getRenderY(double alpha);
+
   //Gets collision circle
   Circle &getCollider();
 
@@ -99,11 +257,54 @@ private:
   int m_posX;
   int m_posY;
 
+  //The offsets before the last tick
+  int m_prevX;
+  int m_prevY;
+
   //The velocity of the dot
   int m_velX;
   int m_velY;
 };
 
+//Runs the simulation in fixed ticks however often frames are drawn
+class LFixedTimestep {
+public:
+  //Simulation ticks per second
+  static const int TICKS_PER_SECOND = 120;
+
+  //Most ticks run for one frame, time past that is dropped so a slow
+  //frame cannot make the next one slower still
+  static const int MAX_TICKS_PER_FRAME = 8;
+
+  //Initializes variables
+  LFixedTimestep();
+
+  //Starts timing from now
+  void start();
+
+  //Adds the time since the last call and returns how many ticks to run
+  int advance();
+
+  //Gets how far the time is from the last tick to the next, from 0 to 1
+  double getAlpha();
+
+  //Gets the number of ticks dropped by the frame limit
+  Uint64 getDroppedTicks();
+
+private:
+  //Performance counter ticks per simulation tick
+  Uint64 m_tickCounts;
+
+  //Counter value at the last advance
+  Uint64 m_lastCounts;
+
+  //Time not yet simulated
+  Uint64 m_accumulator;
+
+  //Ticks dropped by the frame limit
+  Uint64 m_dropped;
+};
+
 //Start up SDL and creates window
 bool init();
 
@@ -119,9 +320,26 @@ bool checkCollision(Circle &a, Circle &b);
 //Circle/Box collision detector
 bool checkCollision(Circle &a, SDL_Rect &b);
 
+//Box/Box collision detector
+bool checkCollision(SDL_Rect &a, SDL_Rect &b);
+
 //Calcilates distance squared between two points
 double distanceSquared(int x1, int y1, int x2, int y2);
 
+//Scatters level objects away from the dot's starting point
+void placeLevelObjects(int totalObjects, std::vector<SDL_Rect> &boxes);
+
+
+//The dimensions of the level
+int g_levelWidth  = LEVEL_WIDTH;
+int g_levelHeight = LEVEL_HEIGHT;
+
+//The static objects placed on the level
+StaticBVH g_levelObjects;
+
+//The streamed level background
+TileMap g_tileMap;
+
 //The window we'll be rendering to
 SDL_Window *g_window = NULL;
 
@@ -255,8 +473,10 @@ void LTexture::setAlpha(Uint8 alpha) {
 
 dot::dot() {
   //Initialize the offsets
-  m_posX = 0;
-  m_posY = 0;
+  m_posX  = 0;
+  m_posY  = 0;
+  m_prevX = 0;
+  m_prevY = 0;
 
   //Initialize the velocity
   m_velX = 0;
@@ -292,29 +512,36 @@ void dot::handleEvent(SDL_Event &e) {
   }
 }
 
-void dot::move() {
+void dot::move(StaticBVH &objects) {
+  //Remember where the tick started for interpolation
+  m_prevX = m_posX;
+  m_prevY = m_posY;
+
   //Move the dot left or right
   m_posX += m_velX;
+  SDL_Rect box = {m_posX, m_posY, DOT_WIDTH, DOT_HEIGHT};
 
-  //If the dot went too far to the left or right
-  if((m_posX < 0) || (m_posX + DOT_WIDTH > LEVEL_WIDTH)) {
+  //If the dot went too far to the left or right or hit an object
+  if((m_posX < 0) || (m_posX + DOT_WIDTH > g_levelWidth) || objects.overlaps(box)) {
     //Move back
     m_posX -= m_velX;
   }
 
   //Move the dot up or down
   m_posY += m_velY;
+  box.x = m_posX;
+  box.y = m_posY;
 
-  //If the dot went too far up or down
-  if((m_posY < 0) || (m_posY + DOT_HEIGHT > LEVEL_HEIGHT)) {
+  //If the dot went too far up or down or hit an object
+  if((m_posY < 0) || (m_posY + DOT_HEIGHT > g_levelHeight) || objects.overlaps(box)) {
     //Move back
     m_posY -= m_velY;
   }
 }
 
-void dot::render(int camX, int camY) {
+void dot::render(int camX, int camY, double alpha) {
   //Show the dot relative to the camera
-  g_dotTexture.render(m_posX - camX, m_posY - camY);
+  g_dotTexture.render(getRenderX(alpha) - camX, getRenderY(alpha) - camY);
 }
 
 int dot::getPosX() {
@@ -325,6 +552,483 @@ int dot::getPosY() {
   return m_posY;
 }
 
+int dot::getRenderX(double alpha) {
+  return (int)floor(m_prevX + (m_posX - m_prevX) * alpha + 0.5);
+}
+
+int dot::getRenderY(double alpha) {
+  return (int)floor(m_prevY + (m_posY - m_prevY) * alpha + 0.5);
+}
+
+LFixedTimestep::LFixedTimestep() {
+  //Initialize
+  m_tickCounts  = SDL_GetPerformanceFrequency() / TICKS_PER_SECOND;
+  m_lastCounts  = 0;
+  m_accumulator = 0;
+  m_dropped     = 0;
+}
+
+void LFixedTimestep::start() {
+  m_lastCounts  = SDL_GetPerformanceCounter();
+  m_accumulator = 0;
+}
+
+int LFixedTimestep::advance() {
+  //Bank the time since the last frame
+  Uint64 now = SDL_GetPerformanceCounter();
+  m_accumulator += now - m_lastCounts;
+  m_lastCounts = now;
+
+  //Run the whole ticks that fit, keeping the remainder for the next frame
+  Uint64 ticks = m_accumulator / m_tickCounts;
+  if(ticks > (Uint64)MAX_TICKS_PER_FRAME) {
+    //Too far behind to catch up, let the simulation fall back instead
+    m_dropped += ticks - MAX_TICKS_PER_FRAME;
+    ticks = MAX_TICKS_PER_FRAME;
+    m_accumulator = m_accumulator % m_tickCounts + ticks * m_tickCounts;
+  }
+  m_accumulator -= ticks * m_tickCounts;
+  return (int)ticks;
+}
+
+double LFixedTimestep::getAlpha() {
+  return (double)m_accumulator / m_tickCounts;
+}
+
+Uint64 LFixedTimestep::getDroppedTicks() {
+  return m_dropped;
+}
+
+void StaticBVH::build(std::vector<SDL_Rect> &boxes) {
+  //Take a copy of the boxes and start with every object in one range
+  m_boxes = boxes;
+  m_order.resize(m_boxes.size());
+  for(int i = 0; i < (int)m_order.size(); i++) {
+    m_order[i] = i;
+  }
+
+  //A binary tree with small leaves has fewer than this many nodes
+  m_nodes.clear();
+  m_nodes.reserve(2 * m_boxes.size() / (LEAF_SIZE / 2) + 1);
+  buildNode(0, m_order.size());
+}
+
+int StaticBVH::buildNode(int first, int count) {
+  int index = m_nodes.size();
+  m_nodes.push_back(Node());
+
+  //Bound the boxes and their centers, centers are kept doubled
+  Node node = {INT_MAX, INT_MAX, INT_MIN, INT_MIN, first, count};
+  int centerLeft = INT_MAX, centerTop = INT_MAX;
+  int centerRight = INT_MIN, centerBottom = INT_MIN;
+  for(int i = first; i < first + count; i++) {
+    SDL_Rect &box = m_boxes[m_order[i]];
+    node.left   = std::min(node.left, box.x);
+    node.top    = std::min(node.top, box.y);
+    node.right  = std::max(node.right, box.x + box.w);
+    node.bottom = std::max(node.bottom, box.y + box.h);
+
+    centerLeft   = std::min(centerLeft, 2 * box.x + box.w);
+    centerTop    = std::min(centerTop, 2 * box.y + box.h);
+    centerRight  = std::max(centerRight, 2 * box.x + box.w);
+    centerBottom = std::max(centerBottom, 2 * box.y + box.h);
+  }
+
+  //Few enough objects become a leaf
+  if(count <= LEAF_SIZE) {
+    m_nodes[index] = node;
+    return index;
+  }
+
+  //Split at the median center along the wider axis
+  bool splitX = centerRight - centerLeft >= centerBottom - centerTop;
+  std::vector<SDL_Rect> &boxes = m_boxes;
+  int half = count / 2;
+  std::nth_element(m_order.begin() + first, m_order.begin() + first + half,
+		   m_order.begin() + first + count, [&boxes, splitX](int a, int b) {
+		     if(splitX) {
+		       return 2 * boxes[a].x + boxes[a].w < 2 * boxes[b].x + boxes[b].w;
+		     }
+		     return 2 * boxes[a].y + boxes[a].h < 2 * boxes[b].y + boxes[b].h;
+		   });
+
+  //The left child follows this node, the right one is remembered
+  buildNode(first, half);
+  node.first = buildNode(first + half, count - half);
+  node.count = 0;
+  m_nodes[index] = node;
+  return index;
+}
+
+bool StaticBVH::intersects(Node &node, SDL_Rect &area) {
+  return node.left < area.x + area.w && area.x < node.right &&
+    node.top < area.y + area.h && area.y < node.bottom;
+}
+
+int StaticBVH::query(SDL_Rect &area, std::vector<int> &results) {
+  int visited = 0;
+  if(m_nodes.empty()) {
+    return visited;
+  }
+
+  m_stack.clear();
+  m_stack.push_back(0);
+  while(!m_stack.empty()) {
+    int index = m_stack.back();
+    m_stack.pop_back();
+    Node &node = m_nodes[index];
+    visited++;
+
+    //Skip subtrees outside the area
+    if(!intersects(node, area)) {
+      continue;
+    }
+
+    if(node.count > 0) {
+      //Test the leaf's objects
+      for(int i = node.first; i < node.first + node.count; i++) {
+	if(checkCollision(m_boxes[m_order[i]], area)) {
+	  results.push_back(m_order[i]);
+	}
+      }
+    } else {
+      //Visit both children
+      m_stack.push_back(node.first);
+      m_stack.push_back(index + 1);
+    }
+  }
+  return visited;
+}
+
+bool StaticBVH::overlaps(SDL_Rect &area) {
+  if(m_nodes.empty()) {
+    return false;
+  }
+
+  m_stack.clear();
+  m_stack.push_back(0);
+  while(!m_stack.empty()) {
+    int index = m_stack.back();
+    m_stack.pop_back();
+    Node &node = m_nodes[index];
+
+    //Skip subtrees outside the area
+    if(!intersects(node, area)) {
+      continue;
+    }
+
+    if(node.count > 0) {
+      //Stop at the first object hit
+      for(int i = node.first; i < node.first + node.count; i++) {
+	if(checkCollision(m_boxes[m_order[i]], area)) {
+	  return true;
+	}
+      }
+    } else {
+      //Visit both children
+      m_stack.push_back(node.first);
+      m_stack.push_back(index + 1);
+    }
+  }
+  return false;
+}
+
+SDL_Rect &StaticBVH::getBox(int index) {
+  return m_boxes[index];
+}
+
+int StaticBVH::size() {
+  return m_boxes.size();
+}
+
+TileMap::TileMap() {
+  //Initialize
+  m_widthTiles     = 0;
+  m_heightTiles    = 0;
+  m_widthChunks    = 0;
+  m_heightChunks   = 0;
+  m_tileset        = NULL;
+  m_tilesetColumns = 0;
+  m_tilesetRows    = 0;
+  m_frame          = 0;
+  m_loader         = NULL;
+  m_lock           = NULL;
+  m_requestsReady  = NULL;
+  m_quit           = false;
+}
+
+TileMap::~TileMap() {
+  //Deallocate
+  free();
+}
+
+bool TileMap::open(std::string directory, int widthTiles, int heightTiles, LTexture &tileset) {
+  //Get rid of preexisting map
+  free();
+
+  m_tileset        = &tileset;
+  m_tilesetColumns = tileset.getWidth() / TILE_SIZE;
+  m_tilesetRows    = tileset.getHeight() / TILE_SIZE;
+  if(m_tilesetColumns == 0 || m_tilesetRows == 0) {
+    printf("Tileset is smaller than one %dx%d tile!\n", TILE_SIZE, TILE_SIZE);
+    return false;
+  }
+
+  m_directory    = directory;
+  m_widthTiles   = widthTiles;
+  m_heightTiles  = heightTiles;
+  m_widthChunks  = (widthTiles + CHUNK_TILES - 1) / CHUNK_TILES;
+  m_heightChunks = (heightTiles + CHUNK_TILES - 1) / CHUNK_TILES;
+
+  //Memory for every chunk is set aside up front
+  m_chunks.resize(MAX_RESIDENT_CHUNKS);
+  for(int i = 0; i < MAX_RESIDENT_CHUNKS; i++) {
+    m_freeChunks.push_back(&m_chunks[i]);
+  }
+
+  //Start the loader
+  m_quit          = false;
+  m_lock          = SDL_CreateMutex();
+  m_requestsReady = SDL_CreateCond();
+  m_loader        = SDL_CreateThread(loaderThread, "ChunkLoader", this);
+  if(m_loader == NULL) {
+    printf("Chunk loader could not be created! SDL Error: %s\n", SDL_GetError());
+    return false;
+  }
+  return true;
+}
+
+void TileMap::free() {
+  //Stop the loader
+  if(m_loader != NULL) {
+    SDL_LockMutex(m_lock);
+    m_quit = true;
+    SDL_CondSignal(m_requestsReady);
+    SDL_UnlockMutex(m_lock);
+    SDL_WaitThread(m_loader, NULL);
+    m_loader = NULL;
+  }
+  if(m_requestsReady != NULL) {
+    SDL_DestroyCond(m_requestsReady);
+    m_requestsReady = NULL;
+  }
+  if(m_lock != NULL) {
+    SDL_DestroyMutex(m_lock);
+    m_lock = NULL;
+  }
+
+  //Free the chunks
+  m_requests.clear();
+  m_finished.clear();
+  m_resident.clear();
+  m_freeChunks.clear();
+  m_chunks.clear();
+  m_tileset = NULL;
+}
+
+int TileMap::loaderThread(void *data) {
+  TileMap *map = (TileMap*)data;
+
+  SDL_LockMutex(map->m_lock);
+  while(!map->m_quit) {
+    //Sleep until there is something to load
+    if(map->m_requests.empty()) {
+      SDL_CondWait(map->m_requestsReady, map->m_lock);
+      continue;
+    }
+    Chunk *chunk = map->m_requests.front();
+    map->m_requests.pop_front();
+
+    //Load without holding the lock so the main thread never waits on disk
+    SDL_UnlockMutex(map->m_lock);
+    map->loadChunk(chunk);
+    SDL_LockMutex(map->m_lock);
+
+    map->m_finished.push_back(chunk);
+  }
+  SDL_UnlockMutex(map->m_lock);
+  return 0;
+}
+
+void TileMap::loadChunk(Chunk *chunk) {
+  const int totalTiles = CHUNK_TILES * CHUNK_TILES;
+  bool loaded = false;
+
+  //Chunk files hold little endian 16 bit tile indices, row by row
+  if(!m_directory.empty()) {
+    char path[64];
+    snprintf(path, sizeof(path), "/chunk_%d_%d.map", chunk->x, chunk->y);
+    SDL_RWops *file = SDL_RWFromFile((m_directory + path).c_str(), "rb");
+    if(file != NULL) {
+      if(SDL_RWread(file, chunk->tiles, sizeof(Uint16), totalTiles) == (size_t)totalTiles) {
+	for(int i = 0; i < totalTiles; i++) {
+	  chunk->tiles[i] = SDL_SwapLE16(chunk->tiles[i]);
+	}
+	loaded = true;
+      } else {
+	printf("Chunk %d,%d is truncated!\n", chunk->x, chunk->y);
+      }
+      SDL_RWclose(file);
+    }
+  }
+
+  //Without a file the tileset repeats over the map
+  if(!loaded) {
+    for(int y = 0; y < CHUNK_TILES; y++) {
+      for(int x = 0; x < CHUNK_TILES; x++) {
+	int tileX = chunk->x * CHUNK_TILES + x;
+	int tileY = chunk->y * CHUNK_TILES + y;
+	chunk->tiles[y * CHUNK_TILES + x] = (tileY % m_tilesetRows) * m_tilesetColumns + tileX % m_tilesetColumns;
+      }
+    }
+  }
+}
+
+TileMap::Chunk *TileMap::findChunk(int x, int y) {
+  std::map<Sint64, Chunk*>::iterator found = m_resident.find((Sint64)y * m_widthChunks + x);
+  if(found == m_resident.end()) {
+    return NULL;
+  }
+  return found->second;
+}
+
+TileMap::Chunk *TileMap::allocateChunk(SDL_Rect &keep) {
+  if(!m_freeChunks.empty()) {
+    Chunk *chunk = m_freeChunks.back();
+    m_freeChunks.pop_back();
+    return chunk;
+  }
+
+  //Evict the least recently used loaded chunk away from the camera
+  std::map<Sint64, Chunk*>::iterator oldest = m_resident.end();
+  for(std::map<Sint64, Chunk*>::iterator i = m_resident.begin(); i != m_resident.end(); ++i) {
+    Chunk *chunk = i->second;
+    if(!chunk->loaded ||
+       (chunk->x >= keep.x && chunk->x < keep.x + keep.w && chunk->y >= keep.y && chunk->y < keep.y + keep.h)) {
+      continue;
+    }
+    if(oldest == m_resident.end() || chunk->lastUsed < oldest->second->lastUsed) {
+      oldest = i;
+    }
+  }
+  if(oldest == m_resident.end()) {
+    return NULL;
+  }
+  Chunk *chunk = oldest->second;
+  m_resident.erase(oldest);
+  return chunk;
+}
+
+void TileMap::update(SDL_Rect &camera) {
+  if(m_loader == NULL) {
+    return;
+  }
+  m_frame++;
+
+  //Pick up finished chunks
+  SDL_LockMutex(m_lock);
+  for(int i = 0; i < (int)m_finished.size(); i++) {
+    m_finished[i]->loaded = true;
+  }
+  m_finished.clear();
+  SDL_UnlockMutex(m_lock);
+
+  //Chunks the camera sees, then the margin around them
+  SDL_Rect visible = {camera.x / CHUNK_SIZE, camera.y / CHUNK_SIZE, 0, 0};
+  visible.w = (camera.x + camera.w - 1) / CHUNK_SIZE - visible.x + 1;
+  visible.h = (camera.y + camera.h - 1) / CHUNK_SIZE - visible.y + 1;
+  SDL_Rect keep = {visible.x - CHUNK_MARGIN, visible.y - CHUNK_MARGIN,
+		   visible.w + 2 * CHUNK_MARGIN, visible.h + 2 * CHUNK_MARGIN};
+  SDL_Rect areas[] = {visible, keep};
+
+  //Request chunks that are not in memory yet
+  std::vector<Chunk*> requests;
+  bool full = false;
+  for(int area = 0; area < 2 && !full; area++) {
+    int top    = std::max(areas[area].y, 0);
+    int bottom = std::min(areas[area].y + areas[area].h, m_heightChunks);
+    int left   = std::max(areas[area].x, 0);
+    int right  = std::min(areas[area].x + areas[area].w, m_widthChunks);
+    for(int y = top; y < bottom && !full; y++) {
+      for(int x = left; x < right; x++) {
+	Chunk *chunk = findChunk(x, y);
+	if(chunk == NULL) {
+	  chunk = allocateChunk(keep);
+	  if(chunk == NULL) {
+	    //Out of memory for chunks until some finish loading
+	    full = true;
+	    break;
+	  }
+	  chunk->x      = x;
+	  chunk->y      = y;
+	  chunk->loaded = false;
+	  m_resident[(Sint64)y * m_widthChunks + x] = chunk;
+	  requests.push_back(chunk);
+	}
+	chunk->lastUsed = m_frame;
+      }
+    }
+  }
+
+  //Hand the requests to the loader
+  if(!requests.empty()) {
+    SDL_LockMutex(m_lock);
+    m_requests.insert(m_requests.end(), requests.begin(), requests.end());
+    SDL_CondSignal(m_requestsReady);
+    SDL_UnlockMutex(m_lock);
+  }
+}
+
+void TileMap::render(SDL_Rect &camera) {
+  if(m_tileset == NULL) {
+    return;
+  }
+
+  //The tiles under the camera
+  int left   = camera.x / TILE_SIZE;
+  int top    = camera.y / TILE_SIZE;
+  int right  = std::min((camera.x + camera.w - 1) / TILE_SIZE + 1, m_widthTiles);
+  int bottom = std::min((camera.y + camera.h - 1) / TILE_SIZE + 1, m_heightTiles);
+
+  //Render chunk by chunk, skipping ones still loading
+  for(int chunkY = top / CHUNK_TILES; chunkY * CHUNK_TILES < bottom; chunkY++) {
+    for(int chunkX = left / CHUNK_TILES; chunkX * CHUNK_TILES < right; chunkX++) {
+      Chunk *chunk = findChunk(chunkX, chunkY);
+      if(chunk == NULL || !chunk->loaded) {
+	continue;
+      }
+
+      int firstX = std::max(left, chunkX * CHUNK_TILES);
+      int lastX  = std::min(right, (chunkX + 1) * CHUNK_TILES);
+      int firstY = std::max(top, chunkY * CHUNK_TILES);
+      int lastY  = std::min(bottom, (chunkY + 1) * CHUNK_TILES);
+      for(int tileY = firstY; tileY < lastY; tileY++) {
+	for(int tileX = firstX; tileX < lastX; tileX++) {
+	  int tile = chunk->tiles[(tileY - chunkY * CHUNK_TILES) * CHUNK_TILES + tileX - chunkX * CHUNK_TILES];
+	  if(tile >= m_tilesetColumns * m_tilesetRows) {
+	    continue;
+	  }
+	  SDL_Rect clip = {tile % m_tilesetColumns * TILE_SIZE, tile / m_tilesetColumns * TILE_SIZE,
+			   TILE_SIZE, TILE_SIZE};
+	  m_tileset->render(tileX * TILE_SIZE - camera.x, tileY * TILE_SIZE - camera.y, &clip);
+	}
+      }
+    }
+  }
+}
+
+int TileMap::getWidth() {
+  return m_widthTiles * TILE_SIZE;
+}
+
+int TileMap::getHeight() {
+  return m_heightTiles * TILE_SIZE;
+}
+
+int TileMap::getResidentChunks() {
+  return m_resident.size();
+}
+
 bool loadMedia() {
   //Loading success flag
   bool success = true;
@@ -387,12 +1091,36 @@ bool checkCollision(Circle &a, SDL_Rect &b) {
   return false;
 }
 
+bool checkCollision(SDL_Rect &a, SDL_Rect &b) {
+  //Boxes that touch only on an edge do not collide
+  return a.x < b.x + b.w && b.x < a.x + a.w &&
+    a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
 double distanceSquared(int x1, int y1, int x2, int y2) {
   int deltaX = x2 - x1;
   int deltaY = y2 - y1;
   return deltaX * deltaX + deltaY * deltaY;
 }
 
+void placeLevelObjects(int totalObjects, std::vector<SDL_Rect> &boxes) {
+  //Keep the area around the starting point free
+  SDL_Rect start = {0, 0, dot::DOT_WIDTH * 3, dot::DOT_HEIGHT * 3};
+
+  //Same level on every run
+  srand(LEVEL_SEED);
+
+  boxes.clear();
+  while((int)boxes.size() < totalObjects) {
+    SDL_Rect box = {rand() % (g_levelWidth  - dot::DOT_WIDTH  + 1),
+		    rand() % (g_levelHeight - dot::DOT_HEIGHT + 1),
+		    dot::DOT_WIDTH, dot::DOT_HEIGHT};
+    if(!checkCollision(box, start)) {
+      boxes.push_back(box);
+    }
+  }
+}
+
 bool init() {
   bool l_success = true;
   
@@ -443,6 +1171,9 @@ bool init() {
 }
 
 void close() {
+  //Stop streaming the level
+  g_tileMap.free();
+
   //Free loaded images
   g_dotTexture.free();
 
@@ -458,7 +1189,25 @@ void close() {
   Mix_Quit();
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+  int totalObjects = DEFAULT_LEVEL_OBJECTS;
+  std::string mapDirectory;
+
+  //Read the level size and object count
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--objects") == 0 && i + 1 < argc) {
+      totalObjects = std::max(0, atoi(argv[++i]));
+    } else if(strcmp(argv[i], "--level") == 0 && i + 2 < argc) {
+      g_levelWidth  = std::max(SCREEN_WIDTH, atoi(argv[++i]));
+      g_levelHeight = std::max(SCREEN_HEIGHT, atoi(argv[++i]));
+    } else if(strcmp(argv[i], "--map") == 0 && i + 1 < argc) {
+      mapDirectory = argv[++i];
+    } else {
+      printf("Usage: %s [--objects N] [--level WIDTH HEIGHT] [--map DIRECTORY]\n", argv[0]);
+      return -1;
+    }
+  }
+
   if(!init()) {
     printf("Failed to initialize!\n");
     return -1;
@@ -475,9 +1224,30 @@ int main() {
   //The dot that will be moving around on the screen
   dot theDot;
 
+  //Open the level in whole tiles
+  if(!g_tileMap.open(mapDirectory, (g_levelWidth + TileMap::TILE_SIZE - 1) / TileMap::TILE_SIZE,
+		     (g_levelHeight + TileMap::TILE_SIZE - 1) / TileMap::TILE_SIZE, g_bgTexture)) {
+    printf("Failed to open the level map!\n");
+    return -1;
+  }
+  g_levelWidth  = g_tileMap.getWidth();
+  g_levelHeight = g_tileMap.getHeight();
+
+  //Place the level objects and index them once
+  std::vector<SDL_Rect> objectBoxes;
+  placeLevelObjects(totalObjects, objectBoxes);
+  g_levelObjects.build(objectBoxes);
+
+  //Objects seen by the camera this frame
+  std::vector<int> visibleObjects;
+
   //The camera area
   SDL_Rect camera = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
 
+  //Movement runs at a fixed rate whatever the display refresh rate
+  LFixedTimestep timestep;
+  timestep.start();
+
   //While application is running
   while(!quit) {
     //Handle events on queue
@@ -490,12 +1260,16 @@ int main() {
       theDot.handleEvent(e);
     }
 
-    //Move the dot
-    theDot.move();
+    //Move the dot once for every tick that passed
+    int ticks = timestep.advance();
+    for(int i = 0; i < ticks; i++) {
+      theDot.move(g_levelObjects);
+    }
+    double alpha = timestep.getAlpha();
 
-    //Center the camera over the dot
-    camera.x = (theDot.getPosX() + dot::DOT_WIDTH  / 2) - SCREEN_WIDTH  / 2;
-    camera.y = (theDot.getPosY() + dot::DOT_HEIGHT / 2) - SCREEN_HEIGHT / 2;
+    //Center the camera over where the dot is drawn
+    camera.x = (theDot.getRenderX(alpha) + dot::DOT_WIDTH  / 2) - SCREEN_WIDTH  / 2;
+    camera.y = (theDot.getRenderY(alpha) + dot::DOT_HEIGHT / 2) - SCREEN_HEIGHT / 2;
 
     //Keep the camera in bounds
     if(camera.x < 0) {
@@ -504,22 +1278,33 @@ int main() {
     if(camera.y < 0) {
       camera.y = 0;
     }
-    if(camera.x > LEVEL_WIDTH - camera.w) {
-      camera.x = LEVEL_WIDTH - camera.w;
+    if(camera.x > g_levelWidth - camera.w) {
+      camera.x = g_levelWidth - camera.w;
     }
-    if(camera.y > LEVEL_HEIGHT - camera.h) {
-      camera.y = LEVEL_HEIGHT - camera.h;
+    if(camera.y > g_levelHeight - camera.h) {
+      camera.y = g_levelHeight - camera.h;
     }
 
     //Clear screen
     SDL_SetRenderDrawColor(g_renderer, 0xFF, 0xFF, 0xFF, 0xFF);
     SDL_RenderClear(g_renderer);
 
+    //Stream in the level around the camera
+    g_tileMap.update(camera);
+
     //Render background
-    g_bgTexture.render(0, 0, &camera);
+    g_tileMap.render(camera);
+
+    //Render the level objects the camera sees
+    visibleObjects.clear();
+    g_levelObjects.query(camera, visibleObjects);
+    for(int i = 0; i < (int)visibleObjects.size(); i++) {
+      SDL_Rect &box = g_levelObjects.getBox(visibleObjects[i]);
+      g_dotTexture.render(box.x - camera.x, box.y - camera.y);
+    }
 
     //Render objects
-    theDot.render(camera.x, camera.y);
+    theDot.render(camera.x, camera.y, alpha);
     
     //Update screen
     SDL_RenderPresent(g_renderer);
@@ -6,15 +6,34 @@
 #include <cmath>
 #include <vector>
 #include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <cstdio>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#define HAVE_POSIX_FILES 1
+#endif
 
 //Screen domension constants
 const int SCREEN_HEIGHT = 480;
 const int SCREEN_WIDTH  = 640;
 
+//Number of data points in a new save, override with --values
 const int TOTAL_DATA = 10;
 
-//Data points
-Sint32 g_data[TOTAL_DATA];
+//The save file
+const std::string SAVE_FILE = "nums.bin";
+
+//Records written and read by the save benchmark
+const int BENCHMARK_RECORDS = 1 << 22;
+
+//Journal entries written before they are compacted into a new save, override with --compact-every
+const int COMPACT_ENTRIES = 4096;
 
 //A circele structure
 struct Circle {
@@ -67,11 +86,294 @@ private:
   int m_height;
 };
 
+//Save file of Sint32 records behind a versioned little endian header:
+//magic "NUMS", version, record count, FNV-1a checksum of the records, generation.
+//The generation ties the save to the journal written on top of it and is 0 in older files
+class LSaveFile {
+public:
+  //File layout constants
+  static const Uint32 MAGIC       = 0x534D554E;
+  static const Uint32 VERSION     = 1;
+  static const int    HEADER_SIZE = 24;
+
+  //Initializes variables
+  LSaveFile();
+
+  //Deallocates memory
+  ~LSaveFile();
+
+  //Starts an unsaved set of zeroed records
+  void create(Uint64 count);
+
+  //Maps the file, or reads it in one call where mapping is not available,
+  //and checks the header and checksum, files without a header are read as raw records
+  bool load(std::string path);
+
+  //Writes a header and the records in bulk to a temporary file, flushes it
+  //to disk and renames it over the save so a crash leaves the old save whole
+  static bool save(std::string path, const Sint32 *values, Uint64 count, Uint32 generation = 0);
+
+  //Changes the number of records, new ones are zero
+  void resize(Uint64 count);
+
+  //Deallocates records and unmaps the file
+  void free();
+
+  //Gets the records, these point into the mapping when mapped
+  Sint32 *getValues();
+  Uint64 getCount();
+
+  //Checks if the records are mapped from the file
+  bool isMapped();
+
+  //Gets the generation read from the header
+  Uint32 getGeneration();
+
+  //Checksums records as little endian words
+  static Uint32 checksum(const Sint32 *values, Uint64 count);
+
+  //Creates a file from a header and a body and flushes it to disk
+  static bool writeFile(std::string path, const Uint8 *header, Uint64 headerSize, const void *body, Uint64 bodySize);
+
+  //Moves a finished file over another, atomically where rename allows it
+  static bool replaceFile(std::string from, std::string to);
+
+private:
+  //Checks a file image and points the records into it
+  bool parse(Uint8 *data, Uint64 size, std::string &path);
+
+  //The file mapping
+  void *m_mapping;
+  size_t m_mappingSize;
+
+  //Records read or created in memory
+  std::vector<Sint32> m_buffer;
+
+  //The records
+  Sint32 *m_values;
+  Uint64 m_count;
+
+  //Save generation
+  Uint32 m_generation;
+};
+
+//Writes saves on a background thread and reports each one with an SDL event
+class LSaveWriter {
+public:
+  //Initializes variables
+  LSaveWriter();
+
+  //Finishes queued saves
+  ~LSaveWriter();
+
+  //Starts the writer thread
+  bool start();
+
+  //Copies the records and queues them, a newer save replaces one not yet started
+  void save(std::string path, const Sint32 *values, Uint64 count, Uint32 generation = 0);
+
+  //Finishes queued saves and stops the thread
+  void free();
+
+  //Gets the event type posted when a save finishes, code is 1 on success
+  Uint32 getEventType();
+
+private:
+  //Writes queued saves until stopped
+  static int writerThread(void *data);
+
+  //Posts the completion event
+  void finished(bool success);
+
+  //The writer thread and its lock
+  SDL_Thread *m_thread;
+  SDL_mutex *m_lock;
+  SDL_cond *m_saveQueued;
+
+  //The queued snapshot
+  std::string m_pendingPath;
+  std::vector<Sint32> m_pending;
+  Uint32 m_pendingGeneration;
+  bool m_hasPending;
+
+  //The snapshot being written, only touched by the writer thread
+  std::vector<Sint32> m_writing;
+
+  //Stop flag
+  bool m_quit;
+
+  //Completion event type
+  Uint32 m_eventType;
+};
+
+//Append-only log of edited records kept beside the save so an edit writes
+//one entry instead of the whole save. Each save generation has its own journal,
+//alternating between two files, which holds the edits made after that save began.
+//Entries hold absolute values so replaying one already in the save is harmless
+class LSaveJournal {
+public:
+  //File layout constants, a header of magic "NJRN" and generation
+  //followed by entries of index, value and entry checksum
+  static const Uint32 MAGIC       = 0x4E524A4E;
+  static const int    HEADER_SIZE = 8;
+  static const int    ENTRY_SIZE  = 12;
+
+  //Initializes variables
+  LSaveJournal();
+
+  //Applies the journals written on top of a save of the given generation and
+  //keeps appending after them, returns the number of entries replayed.
+  //Pass no records for a save that was not loaded from disk
+  int open(std::string savePath, Uint32 generation, Sint32 *values, Uint64 count);
+
+  //Queues an edited record
+  void record(Uint32 index, Sint32 value);
+
+  //Appends queued entries to the journal in one write
+  bool flush();
+
+  //Notes the records changed outside the journal, so a save is needed
+  void markUnsaved();
+
+  //Checks if the records need a save the journal cannot stand in for
+  bool needsSave();
+
+  //Moves the journal on to a new generation and returns it for the save,
+  //a save that never finished is retried under its old generation
+  Uint32 beginSave();
+
+  //Called once the save is written, or failed to be
+  void endSave(bool success);
+
+  //Checks if a save is being written
+  bool isSaving();
+
+  //Gets the number of entries written since the last save began
+  int getEntries();
+
+  //Drops queued entries
+  void free();
+
+  //Gets the journal file of a generation
+  static std::string getPath(std::string savePath, Uint32 generation);
+
+private:
+  //Applies a journal's entries and keeps their bytes, returns -1 when there
+  //is no journal for the generation. Reading stops at a torn last entry
+  static int replay(std::string path, Uint32 generation, Sint32 *values, Uint64 count, std::vector<Uint8> &entries);
+
+  //Starts the journal file of the current generation with the given entries
+  bool writeFile(const std::vector<Uint8> &entries);
+
+  //Checksums one entry
+  static Uint32 entryChecksum(Uint32 generation, Uint32 index, Sint32 value);
+
+  //The save the journal belongs to
+  std::string m_savePath;
+
+  //Generation entries are written to
+  Uint32 m_generation;
+
+  //Whether the save of the current generation is on disk
+  bool m_saved;
+
+  //Whether that save is being written
+  bool m_saving;
+
+  //Entries waiting for a flush
+  std::vector<Uint8> m_queued;
+
+  //Entries since the last save began
+  int m_entries;
+};
+
+//Column of numbers that keeps a rendered texture per cell near the view
+//and re-renders a cell only when its value or highlight changes
+class LTextTable {
+public:
+  //Rows kept rendered above and below the view
+  static const int CACHE_MARGIN = 32;
+
+  //Initializes variables
+  LTextTable();
+
+  //Deallocates memory
+  ~LTextTable();
+
+  //Shows one row per value inside the area
+  void setValues(Sint32 *values, int count, SDL_Rect area);
+
+  //Sets text colors
+  void setColors(SDL_Color textColor, SDL_Color highlightColor);
+
+  //When deferred, changed cells wait for the next flush instead of rendering at once
+  void setDeferred(bool deferred);
+
+  //Marks a cell whose value changed
+  void invalidate(int index);
+
+  //Moves the highlight and scrolls it into view
+  void setHighlight(int index);
+  int getHighlight();
+
+  //Gets the number of rows that fit in the area
+  int getVisibleRows();
+
+  //Renders dirty cells in view, returns how many were rendered
+  int flush();
+
+  //Flushes and shows the cells in view
+  void render();
+
+  //Deallocates cell textures
+  void free();
+
+private:
+  //Renders one cell's text
+  void renderCell(int index);
+
+  //Checks if a row is in view
+  bool inView(int index);
+
+  //Scrolls a row into view and drops textures that left the cache
+  void scrollTo(int index);
+
+  //The values shown
+  Sint32 *m_values;
+
+  //Rendered cells, NULL when not cached
+  std::vector<LTexture*> m_textures;
+
+  //Cells whose texture is out of date
+  std::vector<bool> m_dirty;
+
+  //Area the table is drawn in
+  SDL_Rect m_area;
+  int m_rowHeight;
+
+  //First row in view and highlighted row
+  int m_firstRow;
+  int m_highlight;
+
+  //Whether changes wait for a flush
+  bool m_deferred;
+
+  //Text colors
+  SDL_Color m_textColor;
+  SDL_Color m_highlightColor;
+};
+
 //Start up SDL and creates window
 bool init();
 
-//Loads media
-bool loadMedia();
+//Loads media and the save, with the given number of records if not 0
+bool loadMedia(int totalData);
+
+//Compares the save file against per element reads and writes
+void runSaveBenchmark();
+
+//Writes a new save in the background that the journal restarts from
+void compactSave(Sint32 *values, Uint64 count);
 
 //Frees media nad shits down SDL
 void close();
@@ -97,7 +399,16 @@ TTF_Font *g_font = NULL;
 //Scene textures
 LTexture g_promptTextTexture;
 LTexture g_inputTextTexture;
-LTexture g_dataTextures[TOTAL_DATA];
+LTextTable g_dataTable;
+
+//Data points
+LSaveFile g_save;
+
+//Background saving
+LSaveWriter g_saveWriter;
+
+//Edits made since the last save
+LSaveJournal g_journal;
 
 LTexture::LTexture() {
   //Initialize
@@ -220,7 +531,790 @@ void LTexture::setAlpha(Uint8 alpha) {
   SDL_SetTextureAlphaMod(m_texture, alpha);
 }
 
-bool loadMedia() {
+LTextTable::LTextTable() {
+  //Initialize
+  m_values    = NULL;
+  m_area.x    = 0;
+  m_area.y    = 0;
+  m_area.w    = 0;
+  m_area.h    = 0;
+  m_rowHeight = 1;
+  m_firstRow  = 0;
+  m_highlight = 0;
+  m_deferred  = true;
+
+  SDL_Color black = {0, 0, 0, 0xFF};
+  m_textColor      = black;
+  m_highlightColor = black;
+}
+
+LTextTable::~LTextTable() {
+  //Deallocate
+  free();
+}
+
+void LTextTable::setValues(Sint32 *values, int count, SDL_Rect area) {
+  //Get rid of preexisting cells
+  free();
+
+  m_values    = values;
+  m_area      = area;
+  m_rowHeight = TTF_FontHeight(g_font);
+  if(m_rowHeight < 1) {
+    m_rowHeight = 1;
+  }
+  m_firstRow  = 0;
+  m_highlight = 0;
+
+  //Nothing is rendered until it comes into view
+  m_textures.assign(count, (LTexture*)NULL);
+  m_dirty.assign(count, true);
+}
+
+void LTextTable::setColors(SDL_Color textColor, SDL_Color highlightColor) {
+  m_textColor      = textColor;
+  m_highlightColor = highlightColor;
+
+  //Every cell needs its new color
+  m_dirty.assign(m_dirty.size(), true);
+}
+
+void LTextTable::setDeferred(bool deferred) {
+  m_deferred = deferred;
+}
+
+void LTextTable::invalidate(int index) {
+  if(index < 0 || index >= (int)m_dirty.size()) {
+    return;
+  }
+  m_dirty[index] = true;
+
+  //Without deferring, visible cells update right away
+  if(!m_deferred && inView(index)) {
+    renderCell(index);
+  }
+}
+
+void LTextTable::setHighlight(int index) {
+  if(index < 0 || index >= (int)m_dirty.size() || index == m_highlight) {
+    return;
+  }
+
+  //Only the old and new highlighted cells change
+  int previous = m_highlight;
+  m_highlight = index;
+  scrollTo(index);
+  invalidate(previous);
+  invalidate(index);
+}
+
+int LTextTable::getHighlight() {
+  return m_highlight;
+}
+
+int LTextTable::getVisibleRows() {
+  int rows = m_area.h / m_rowHeight;
+  return rows < 1 ? 1 : rows;
+}
+
+bool LTextTable::inView(int index) {
+  return index >= m_firstRow && index < m_firstRow + getVisibleRows();
+}
+
+void LTextTable::scrollTo(int index) {
+  int firstRow = m_firstRow;
+  if(index < firstRow) {
+    firstRow = index;
+  } else if(index >= firstRow + getVisibleRows()) {
+    firstRow = index - getVisibleRows() + 1;
+  }
+  if(firstRow == m_firstRow) {
+    return;
+  }
+
+  //Drop textures of rows that moved out of the cached range
+  int total = m_textures.size();
+  int oldBegin = std::max(m_firstRow - CACHE_MARGIN, 0);
+  int oldEnd   = std::min(m_firstRow + getVisibleRows() + CACHE_MARGIN, total);
+  int newBegin = firstRow - CACHE_MARGIN;
+  int newEnd   = firstRow + getVisibleRows() + CACHE_MARGIN;
+  for(int i = oldBegin; i < oldEnd; ++i) {
+    if((i < newBegin || i >= newEnd) && m_textures[i] != NULL) {
+      delete m_textures[i];
+      m_textures[i] = NULL;
+    }
+  }
+  m_firstRow = firstRow;
+}
+
+void LTextTable::renderCell(int index) {
+  if(m_textures[index] == NULL) {
+    m_textures[index] = new LTexture();
+  }
+  SDL_Color color = index == m_highlight ? m_highlightColor : m_textColor;
+  m_textures[index]->loadFromRenderedText(std::to_string((long)m_values[index]), color);
+  m_dirty[index] = false;
+}
+
+int LTextTable::flush() {
+  int rendered = 0;
+  int end = std::min(m_firstRow + getVisibleRows(), (int)m_textures.size());
+  for(int i = m_firstRow; i < end; ++i) {
+    if(m_dirty[i] || m_textures[i] == NULL) {
+      renderCell(i);
+      ++rendered;
+    }
+  }
+  return rendered;
+}
+
+void LTextTable::render() {
+  //Catch up on changes deferred during the frame
+  flush();
+
+  int end = std::min(m_firstRow + getVisibleRows(), (int)m_textures.size());
+  for(int i = m_firstRow; i < end; ++i) {
+    LTexture *texture = m_textures[i];
+    texture->render(m_area.x + (m_area.w - texture->getWidth()) / 2, m_area.y + (i - m_firstRow) * m_rowHeight);
+  }
+}
+
+void LTextTable::free() {
+  //Free every cached cell
+  for(int i = 0; i < (int)m_textures.size(); ++i) {
+    delete m_textures[i];
+  }
+  m_textures.clear();
+  m_dirty.clear();
+  m_values = NULL;
+}
+
+LSaveFile::LSaveFile() {
+  //Initialize
+  m_mapping     = NULL;
+  m_mappingSize = 0;
+  m_values      = NULL;
+  m_count       = 0;
+  m_generation  = 0;
+}
+
+LSaveFile::~LSaveFile() {
+  //Deallocate
+  free();
+}
+
+void LSaveFile::create(Uint64 count) {
+  free();
+  m_buffer.assign(count, 0);
+  m_values = m_buffer.empty() ? NULL : &m_buffer[0];
+  m_count  = count;
+}
+
+bool LSaveFile::load(std::string path) {
+  //Get rid of preexisting records
+  free();
+
+#ifdef HAVE_POSIX_FILES
+  //Map a private copy so edits never reach the file until it is saved
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd != -1) {
+    struct stat info;
+    if(fstat(fd, &info) == 0 && info.st_size > 0) {
+      void *mapping = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+      if(mapping != MAP_FAILED) {
+	m_mapping     = mapping;
+	m_mappingSize = info.st_size;
+      }
+    }
+    close(fd);
+    if(m_mapping != NULL) {
+      if(parse((Uint8*)m_mapping, m_mappingSize, path)) {
+	return true;
+      }
+      free();
+      return false;
+    }
+  }
+#endif
+
+  //Read the whole file in one call
+  SDL_RWops *file = SDL_RWFromFile(path.c_str(), "rb");
+  if(file == NULL) {
+    printf("Warning: Unable to open %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+    return false;
+  }
+  Sint64 size = SDL_RWsize(file);
+  bool success = size >= 0;
+  if(success && size > 0) {
+    //Keep the records aligned for direct access
+    m_buffer.resize((size + sizeof(Sint32) - 1) / sizeof(Sint32));
+    success = SDL_RWread(file, &m_buffer[0], size, 1) == 1;
+  }
+  SDL_RWclose(file);
+  if(!success) {
+    printf("Unable to read %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+    free();
+    return false;
+  }
+  if(!parse(size > 0 ? (Uint8*)&m_buffer[0] : NULL, size, path)) {
+    free();
+    return false;
+  }
+  return true;
+}
+
+bool LSaveFile::parse(Uint8 *data, Uint64 size, std::string &path) {
+  Uint32 magic = 0;
+  if(size >= (Uint64)HEADER_SIZE) {
+    memcpy(&magic, data, sizeof(magic));
+    magic = SDL_SwapLE32(magic);
+  }
+
+  //Files from before the header are bare records
+  if(magic != MAGIC) {
+    printf("%s has no header, reading it as raw records\n", path.c_str());
+    std::vector<Sint32> records(size / sizeof(Sint32));
+    for(Uint64 i = 0; i < records.size(); ++i) {
+      Sint32 value;
+      memcpy(&value, data + i * sizeof(Sint32), sizeof(value));
+      records[i] = SDL_SwapLE32(value);
+    }
+    free();
+    m_buffer.swap(records);
+    m_values = m_buffer.empty() ? NULL : &m_buffer[0];
+    m_count  = m_buffer.size();
+    return true;
+  }
+
+  //Read the rest of the header
+  Uint32 version, storedChecksum, generation;
+  Uint64 count;
+  memcpy(&version, data + 4, sizeof(version));
+  memcpy(&count, data + 8, sizeof(count));
+  memcpy(&storedChecksum, data + 16, sizeof(storedChecksum));
+  memcpy(&generation, data + 20, sizeof(generation));
+  version        = SDL_SwapLE32(version);
+  count          = SDL_SwapLE64(count);
+  storedChecksum = SDL_SwapLE32(storedChecksum);
+  generation     = SDL_SwapLE32(generation);
+
+  if(version > VERSION) {
+    printf("%s is version %u, newer than this program!\n", path.c_str(), version);
+    return false;
+  }
+  if(count > (size - HEADER_SIZE) / sizeof(Sint32)) {
+    printf("%s is truncated!\n", path.c_str());
+    return false;
+  }
+
+  //Records follow the header, fix their byte order in place on big endian machines
+  m_values = (Sint32*)(data + HEADER_SIZE);
+  m_count  = count;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+  for(Uint64 i = 0; i < m_count; ++i) {
+    m_values[i] = SDL_SwapLE32(m_values[i]);
+  }
+#endif
+  if(checksum(m_values, m_count) != storedChecksum) {
+    printf("%s is corrupt, checksum does not match!\n", path.c_str());
+    return false;
+  }
+  m_generation = generation;
+  return true;
+}
+
+bool LSaveFile::save(std::string path, const Sint32 *values, Uint64 count, Uint32 generation) {
+  //Build header
+  Uint8 header[HEADER_SIZE] = {0};
+  Uint32 magic    = SDL_SwapLE32(MAGIC);
+  Uint32 version  = SDL_SwapLE32(VERSION);
+  Uint64 total    = SDL_SwapLE64(count);
+  Uint32 checkSum = SDL_SwapLE32(checksum(values, count));
+  Uint32 gen      = SDL_SwapLE32(generation);
+  memcpy(header, &magic, sizeof(magic));
+  memcpy(header + 4, &version, sizeof(version));
+  memcpy(header + 8, &total, sizeof(total));
+  memcpy(header + 16, &checkSum, sizeof(checkSum));
+  memcpy(header + 20, &gen, sizeof(gen));
+
+  //Records are written as they are on little endian machines
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+  std::vector<Sint32> swapped(values, values + count);
+  for(Uint64 i = 0; i < count; ++i) {
+    swapped[i] = SDL_SwapLE32(swapped[i]);
+  }
+  values = count > 0 ? &swapped[0] : NULL;
+#endif
+
+  //Write beside the save and only replace it once the new file is on disk
+  std::string temporary = path + ".tmp";
+  if(!writeFile(temporary, header, HEADER_SIZE, values, count * sizeof(Sint32)) || !replaceFile(temporary, path)) {
+    printf("Error: Unable to save %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+    remove(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool LSaveFile::writeFile(std::string path, const Uint8 *header, Uint64 headerSize, const void *body, Uint64 bodySize) {
+#ifdef HAVE_POSIX_FILES
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd == -1) {
+    return false;
+  }
+
+  //Write header and body, picking up after short writes
+  const Uint8 *parts[2] = {header, (const Uint8*)body};
+  Uint64 sizes[2] = {headerSize, bodySize};
+  bool success = true;
+  for(int part = 0; part < 2 && success; ++part) {
+    Uint64 written = 0;
+    while(written < sizes[part]) {
+      ssize_t result = write(fd, parts[part] + written, sizes[part] - written);
+      if(result < 0) {
+	if(errno == EINTR) {
+	  continue;
+	}
+	success = false;
+	break;
+      }
+      written += result;
+    }
+  }
+
+  //Make sure the data is on disk before the rename can expose it
+  if(success && fsync(fd) != 0) {
+    success = false;
+  }
+  if(close(fd) != 0) {
+    success = false;
+  }
+  return success;
+#else
+  SDL_RWops *file = SDL_RWFromFile(path.c_str(), "wb");
+  if(file == NULL) {
+    return false;
+  }
+  bool success = SDL_RWwrite(file, header, headerSize, 1) == 1;
+  if(success && bodySize > 0) {
+    success = SDL_RWwrite(file, body, bodySize, 1) == 1;
+  }
+  if(SDL_RWclose(file) != 0) {
+    success = false;
+  }
+  return success;
+#endif
+}
+
+bool LSaveFile::replaceFile(std::string from, std::string to) {
+#ifdef HAVE_POSIX_FILES
+  //Rename is atomic, the save is either old or new
+  if(rename(from.c_str(), to.c_str()) != 0) {
+    return false;
+  }
+
+  //Flush the directory entry too
+  size_t slash = to.find_last_of('/');
+  std::string directory = slash == std::string::npos ? "." : to.substr(0, slash + 1);
+  int fd = open(directory.c_str(), O_RDONLY);
+  if(fd != -1) {
+    fsync(fd);
+    close(fd);
+  }
+  return true;
+#else
+  //Rename will not replace a file here, so there is a short window with no save
+  remove(to.c_str());
+  return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+void LSaveFile::resize(Uint64 count) {
+  if(count == m_count) {
+    return;
+  }
+
+  //Move the records out of the mapping into memory of their own
+  std::vector<Sint32> records(count, 0);
+  if(m_count > 0) {
+    memcpy(&records[0], m_values, std::min(count, m_count) * sizeof(Sint32));
+  }
+  Uint32 generation = m_generation;
+  free();
+  m_buffer.swap(records);
+  m_values     = m_buffer.empty() ? NULL : &m_buffer[0];
+  m_count      = count;
+  m_generation = generation;
+}
+
+void LSaveFile::free() {
+#ifdef HAVE_POSIX_FILES
+  if(m_mapping != NULL) {
+    munmap(m_mapping, m_mappingSize);
+  }
+#endif
+  m_mapping     = NULL;
+  m_mappingSize = 0;
+  m_buffer.clear();
+  m_values     = NULL;
+  m_count      = 0;
+  m_generation = 0;
+}
+
+Sint32 *LSaveFile::getValues() {
+  return m_values;
+}
+
+Uint64 LSaveFile::getCount() {
+  return m_count;
+}
+
+bool LSaveFile::isMapped() {
+  return m_mapping != NULL;
+}
+
+Uint32 LSaveFile::getGeneration() {
+  return m_generation;
+}
+
+Uint32 LSaveFile::checksum(const Sint32 *values, Uint64 count) {
+  //FNV-1a over whole words
+  Uint32 hash = 2166136261u;
+  for(Uint64 i = 0; i < count; ++i) {
+    hash ^= (Uint32)values[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+LSaveWriter::LSaveWriter() {
+  //Initialize
+  m_thread     = NULL;
+  m_lock       = NULL;
+  m_saveQueued = NULL;
+  m_hasPending = false;
+  m_pendingGeneration = 0;
+  m_quit       = false;
+  m_eventType  = (Uint32)-1;
+}
+
+LSaveWriter::~LSaveWriter() {
+  //Deallocate
+  free();
+}
+
+bool LSaveWriter::start() {
+  //Get rid of preexisting thread
+  free();
+
+  //Completed saves come back through the event queue
+  m_eventType = SDL_RegisterEvents(1);
+  if(m_eventType == (Uint32)-1) {
+    printf("Warning: Unable to register save event! SDL Error: %s\n", SDL_GetError());
+  }
+
+  m_quit       = false;
+  m_lock       = SDL_CreateMutex();
+  m_saveQueued = SDL_CreateCond();
+  m_thread     = SDL_CreateThread(writerThread, "SaveWriter", this);
+  if(m_thread == NULL) {
+    printf("Save writer could not be created! SDL Error: %s\n", SDL_GetError());
+    return false;
+  }
+  return true;
+}
+
+void LSaveWriter::save(std::string path, const Sint32 *values, Uint64 count, Uint32 generation) {
+  //Without a thread save right away
+  if(m_thread == NULL) {
+    finished(LSaveFile::save(path, values, count, generation));
+    return;
+  }
+
+  //Snapshot the records into the pending buffer, its memory is reused
+  SDL_LockMutex(m_lock);
+  m_pendingPath = path;
+  m_pending.assign(values, values + count);
+  m_pendingGeneration = generation;
+  m_hasPending = true;
+  SDL_CondSignal(m_saveQueued);
+  SDL_UnlockMutex(m_lock);
+}
+
+void LSaveWriter::free() {
+  //Let the thread write what is queued, then stop it
+  if(m_thread != NULL) {
+    SDL_LockMutex(m_lock);
+    m_quit = true;
+    SDL_CondSignal(m_saveQueued);
+    SDL_UnlockMutex(m_lock);
+    SDL_WaitThread(m_thread, NULL);
+    m_thread = NULL;
+  }
+  if(m_saveQueued != NULL) {
+    SDL_DestroyCond(m_saveQueued);
+    m_saveQueued = NULL;
+  }
+  if(m_lock != NULL) {
+    SDL_DestroyMutex(m_lock);
+    m_lock = NULL;
+  }
+}
+
+Uint32 LSaveWriter::getEventType() {
+  return m_eventType;
+}
+
+int LSaveWriter::writerThread(void *data) {
+  LSaveWriter *writer = (LSaveWriter*)data;
+
+  SDL_LockMutex(writer->m_lock);
+  while(true) {
+    //Sleep until there is a save or a stop request
+    while(!writer->m_hasPending && !writer->m_quit) {
+      SDL_CondWait(writer->m_saveQueued, writer->m_lock);
+    }
+    if(!writer->m_hasPending) {
+      break;
+    }
+
+    //Take the snapshot so a new one can be queued while this one is written
+    std::string path = writer->m_pendingPath;
+    Uint32 generation = writer->m_pendingGeneration;
+    writer->m_writing.swap(writer->m_pending);
+    writer->m_hasPending = false;
+    SDL_UnlockMutex(writer->m_lock);
+
+    Uint64 count = writer->m_writing.size();
+    bool success = LSaveFile::save(path, count > 0 ? &writer->m_writing[0] : NULL, count, generation);
+
+    //Report back to the game loop
+    writer->finished(success);
+
+    SDL_LockMutex(writer->m_lock);
+  }
+  SDL_UnlockMutex(writer->m_lock);
+  return 0;
+}
+
+void LSaveWriter::finished(bool success) {
+  if(m_eventType != (Uint32)-1) {
+    SDL_Event event;
+    SDL_zero(event);
+    event.type      = m_eventType;
+    event.user.code = success ? 1 : 0;
+    SDL_PushEvent(&event);
+  }
+}
+
+LSaveJournal::LSaveJournal() {
+  //Initialize
+  m_generation = 0;
+  m_saved      = false;
+  m_saving     = false;
+  m_entries    = 0;
+}
+
+int LSaveJournal::open(std::string savePath, Uint32 generation, Sint32 *values, Uint64 count) {
+  free();
+  m_savePath   = savePath;
+  m_generation = generation;
+  m_saved      = values != NULL;
+  m_saving     = false;
+  m_entries    = 0;
+
+  //Journals beside a save that was not read belong to some other save
+  std::vector<Uint8> entries;
+  if(values == NULL) {
+    remove(getPath(m_savePath, generation + 1).c_str());
+    writeFile(entries);
+    return 0;
+  }
+
+  //Edits made on top of the save
+  int replayed = std::max(replay(getPath(m_savePath, generation), generation, values, count, entries), 0);
+
+  //A journal for the next generation means a save was begun and may not have
+  //finished, its edits came later so they go on top and the save is written again
+  std::vector<Uint8> nextEntries;
+  int next = replay(getPath(m_savePath, generation + 1), generation + 1, values, count, nextEntries);
+  if(next >= 0) {
+    replayed    += next;
+    m_generation = generation + 1;
+    m_saved      = false;
+    entries.swap(nextEntries);
+  }
+
+  //Rewrite the journal being continued so a torn entry does not hide later ones
+  m_entries = entries.size() / ENTRY_SIZE;
+  writeFile(entries);
+  return replayed;
+}
+
+int LSaveJournal::replay(std::string path, Uint32 generation, Sint32 *values, Uint64 count, std::vector<Uint8> &entries) {
+  SDL_RWops *file = SDL_RWFromFile(path.c_str(), "rb");
+  if(file == NULL) {
+    return -1;
+  }
+
+  //Read the whole journal in one call
+  std::vector<Uint8> data;
+  Sint64 size = SDL_RWsize(file);
+  if(size >= HEADER_SIZE) {
+    data.resize(size);
+    if(SDL_RWread(file, &data[0], size, 1) != 1) {
+      data.clear();
+    }
+  }
+  SDL_RWclose(file);
+  if(data.size() < (size_t)HEADER_SIZE) {
+    return -1;
+  }
+
+  //Check it belongs to the generation
+  Uint32 magic, fileGeneration;
+  memcpy(&magic, &data[0], sizeof(magic));
+  memcpy(&fileGeneration, &data[4], sizeof(fileGeneration));
+  if(SDL_SwapLE32(magic) != MAGIC || SDL_SwapLE32(fileGeneration) != generation) {
+    return -1;
+  }
+
+  //Apply entries up to the first one that did not make it to disk whole
+  int applied = 0;
+  for(size_t offset = HEADER_SIZE; offset + ENTRY_SIZE <= data.size(); offset += ENTRY_SIZE) {
+    Uint32 index, check;
+    Sint32 value;
+    memcpy(&index, &data[offset], sizeof(index));
+    memcpy(&value, &data[offset + 4], sizeof(value));
+    memcpy(&check, &data[offset + 8], sizeof(check));
+    index = SDL_SwapLE32(index);
+    value = SDL_SwapLE32(value);
+    if(SDL_SwapLE32(check) != entryChecksum(generation, index, value)) {
+      printf("%s ends in a torn entry, dropping the rest\n", path.c_str());
+      break;
+    }
+
+    //Entries past the end are from before the save shrank
+    if(index < count) {
+      values[index] = value;
+    }
+    entries.insert(entries.end(), data.begin() + offset, data.begin() + offset + ENTRY_SIZE);
+    ++applied;
+  }
+  return applied;
+}
+
+bool LSaveJournal::writeFile(const std::vector<Uint8> &entries) {
+  Uint8 header[HEADER_SIZE];
+  Uint32 magic      = SDL_SwapLE32(MAGIC);
+  Uint32 generation = SDL_SwapLE32(m_generation);
+  memcpy(header, &magic, sizeof(magic));
+  memcpy(header + 4, &generation, sizeof(generation));
+
+  //Write beside the journal and rename over it, so a crash keeps the old entries
+  std::string path = getPath(m_savePath, m_generation);
+  std::string temporary = path + ".tmp";
+  if(!LSaveFile::writeFile(temporary, header, HEADER_SIZE, entries.empty() ? NULL : &entries[0], entries.size()) ||
+     !LSaveFile::replaceFile(temporary, path)) {
+    printf("Warning: Unable to write %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+    remove(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+void LSaveJournal::record(Uint32 index, Sint32 value) {
+  Uint32 words[3];
+  words[0] = SDL_SwapLE32(index);
+  words[1] = SDL_SwapLE32((Uint32)value);
+  words[2] = SDL_SwapLE32(entryChecksum(m_generation, index, value));
+
+  Uint8 entry[ENTRY_SIZE];
+  memcpy(entry, words, ENTRY_SIZE);
+  m_queued.insert(m_queued.end(), entry, entry + ENTRY_SIZE);
+  ++m_entries;
+}
+
+bool LSaveJournal::flush() {
+  if(m_queued.empty()) {
+    return true;
+  }
+
+  //Closing hands the entries to the system, so they survive the program crashing.
+  //There is no fsync, so a power loss can still drop the latest entries
+  std::string path = getPath(m_savePath, m_generation);
+  SDL_RWops *file = SDL_RWFromFile(path.c_str(), "ab");
+  if(file == NULL) {
+    printf("Warning: Unable to open %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+    return false;
+  }
+  bool success = SDL_RWwrite(file, &m_queued[0], m_queued.size(), 1) == 1;
+  if(SDL_RWclose(file) != 0) {
+    success = false;
+  }
+  if(!success) {
+    printf("Warning: Unable to write %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+    return false;
+  }
+  m_queued.clear();
+  return true;
+}
+
+void LSaveJournal::markUnsaved() {
+  m_saved = false;
+}
+
+bool LSaveJournal::needsSave() {
+  return !m_saved && !m_saving;
+}
+
+Uint32 LSaveJournal::beginSave() {
+  //Queued entries belong before the save
+  flush();
+
+  //The last save is on disk so the journal before it is no longer needed and its
+  //file takes the new generation, otherwise keep both until that save lands
+  if(m_saved) {
+    ++m_generation;
+    m_saved = false;
+    std::vector<Uint8> entries;
+    writeFile(entries);
+  }
+  m_saving  = true;
+  m_entries = 0;
+  return m_generation;
+}
+
+void LSaveJournal::endSave(bool success) {
+  m_saving = false;
+  if(success) {
+    m_saved = true;
+    remove(getPath(m_savePath, m_generation + 1).c_str());
+  }
+}
+
+bool LSaveJournal::isSaving() {
+  return m_saving;
+}
+
+int LSaveJournal::getEntries() {
+  return m_entries;
+}
+
+void LSaveJournal::free() {
+  m_queued.clear();
+}
+
+std::string LSaveJournal::getPath(std::string savePath, Uint32 generation) {
+  return savePath + (generation % 2 == 0 ? ".journal0" : ".journal1");
+}
+
+Uint32 LSaveJournal::entryChecksum(Uint32 generation, Uint32 index, Sint32 value) {
+  Sint32 words[3] = {(Sint32)generation, (Sint32)index, value};
+  return LSaveFile::checksum(words, 3);
+}
+
+bool loadMedia(int totalData) {
   //Loading success flag
   bool success = true;
 
@@ -228,9 +1322,6 @@ bool loadMedia() {
   SDL_Color textColor = { 0, 0, 0, 0xFF };
   SDL_Color highlightColor = { 0xFF, 0, 0, 0xFF };
   
-  //Open file for reading in binary
-  SDL_RWops *file = SDL_RWFromFile("nums.bin", "r+b");
-
   //Open the font
   g_font = TTF_OpenFont("lazy.ttf", 28);
   if(g_font == NULL) {
@@ -246,40 +1337,36 @@ bool loadMedia() {
   }
 
 
-  //File does not exist
-  if(file == NULL) {
-    printf("Warning: Unable to open file! SDL Error: %s\n", SDL_GetError());
+  //Load saved data or start a new save
+  bool loaded = g_save.load(SAVE_FILE);
+  if(loaded) {
+    printf("Read %lu records%s\n", (unsigned long)g_save.getCount(), g_save.isMapped() ? " (mapped)" : "");
+  } else {
+    printf("Starting new save!\n");
+    g_save.create(TOTAL_DATA);
+  }
 
-    //Create file for writing
-    file = SDL_RWFromFile("nums.bin", "w+b");
+  //Apply edits made since the save was written
+  int replayed = g_journal.open(SAVE_FILE, g_save.getGeneration(), loaded ? g_save.getValues() : NULL, g_save.getCount());
+  if(replayed > 0) {
+    printf("Replayed %d edits from the journal\n", replayed);
+  }
 
-    if(file != NULL) {
-      printf("New file created!\n");
-      //Initialize data
-      for(int i = 0; i < TOTAL_DATA; ++i) {
-	g_data[i] = 0;
-	SDL_RWwrite(file, &g_data[i], sizeof(Sint32), 1);
-      }
-      //Close file handler
-      SDL_RWclose(file);
-    } else {
-      printf("Error: Unable to create file! SDL Error: %s\n", SDL_GetError());
-      success = false;
-    }
-  } else { //File exist
-    //Load data
-    printf("Reading file...!\n");
-    for(int i = 0; i < TOTAL_DATA; ++i) {
-      SDL_RWread(file, &g_data[i], sizeof(Sint32), 1);
-    }
-    //Close file handler
-    SDL_RWclose(file);
+  //Changes in size are not journaled
+  if(totalData > 0 && (Uint64)totalData != g_save.getCount()) {
+    g_save.resize(totalData);
+    g_journal.markUnsaved();
+  }
+  if(g_save.getCount() == 0) {
+    g_save.create(TOTAL_DATA);
+    g_journal.markUnsaved();
   }
 
-  //Initialize data texture
-  g_dataTextures[0].loadFromRenderedText(std::to_string((long)g_data[0]), highlightColor);
-  for(int i = 1; i < TOTAL_DATA; ++i) {
-    g_dataTextures[i].loadFromRenderedText(std::to_string((long)g_data[i]), textColor);
+  //Show the data below the prompt, cells render as they come into view
+  if(success) {
+    SDL_Rect tableArea = {0, g_promptTextTexture.getHeight(), SCREEN_WIDTH, SCREEN_HEIGHT - g_promptTextTexture.getHeight()};
+    g_dataTable.setValues(g_save.getValues(), g_save.getCount(), tableArea);
+    g_dataTable.setColors(textColor, highlightColor);
   }
   return success;
 }
@@ -385,23 +1472,86 @@ bool init() {
   return l_success;
 }
 
-void close() {
-  //Open data for writing
-  SDL_RWops *file = SDL_RWFromFile("nums.bin", "w+b");
+void runSaveBenchmark() {
+  //Something to write
+  std::vector<Sint32> values(BENCHMARK_RECORDS);
+  for(int i = 0; i < BENCHMARK_RECORDS; ++i) {
+    values[i] = i * 2654435761u;
+  }
+  std::vector<Sint32> readBack(BENCHMARK_RECORDS);
+  double frequency = (double)SDL_GetPerformanceFrequency() / 1000.0;
+  printf("Saving and loading %d records\n", BENCHMARK_RECORDS);
+
+  //Per element writes, as the tutorial used to save
+  Uint64 start = SDL_GetPerformanceCounter();
+  SDL_RWops *file = SDL_RWFromFile("bench_loop.bin", "w+b");
   if(file != NULL) {
-    //Save data
-    for(int i = 0; i < TOTAL_DATA; ++i) {
-      SDL_RWwrite(file, &g_data[i], sizeof(Sint32), 1);
+    for(int i = 0; i < BENCHMARK_RECORDS; ++i) {
+      SDL_RWwrite(file, &values[i], sizeof(Sint32), 1);
     }
-    //Close file handler
     SDL_RWclose(file);
-  } else {
-    printf("Error: Unable to save file! %s\n", SDL_GetError());
   }
+  printf("  per element write: %8.2f ms\n", (SDL_GetPerformanceCounter() - start) / frequency);
+
+  //Per element reads
+  start = SDL_GetPerformanceCounter();
+  file = SDL_RWFromFile("bench_loop.bin", "r+b");
+  if(file != NULL) {
+    for(int i = 0; i < BENCHMARK_RECORDS; ++i) {
+      SDL_RWread(file, &readBack[i], sizeof(Sint32), 1);
+    }
+    SDL_RWclose(file);
+  }
+  printf("  per element read:  %8.2f ms\n", (SDL_GetPerformanceCounter() - start) / frequency);
+
+  //Bulk write with header and checksum
+  start = SDL_GetPerformanceCounter();
+  LSaveFile::save("bench_save.bin", &values[0], values.size());
+  printf("  save file write:   %8.2f ms\n", (SDL_GetPerformanceCounter() - start) / frequency);
+
+  //Mapped or bulk read, checksum included
+  LSaveFile save;
+  start = SDL_GetPerformanceCounter();
+  bool loaded = save.load("bench_save.bin");
+  double loadTime = (SDL_GetPerformanceCounter() - start) / frequency;
+  printf("  save file load:    %8.2f ms (%s)\n", loadTime, save.isMapped() ? "mapped" : "bulk read");
+  if(!loaded || save.getCount() != values.size() ||
+     memcmp(save.getValues(), &values[0], values.size() * sizeof(Sint32)) != 0 ||
+     memcmp(&readBack[0], &values[0], values.size() * sizeof(Sint32)) != 0) {
+    printf("  records read back do not match!\n");
+  }
+  save.free();
+
+  remove("bench_loop.bin");
+  remove("bench_save.bin");
+}
+
+void compactSave(Sint32 *values, Uint64 count) {
+  //One save at a time, so the journal it replaces stays until it lands
+  if(g_journal.isSaving()) {
+    printf("Save already in progress\n");
+    return;
+  }
+  Uint32 generation = g_journal.beginSave();
+  g_saveWriter.save(SAVE_FILE, values, count, generation);
+}
+
+void close() {
+  //Edits are already in the journal, only a save the journal depends on must still be written
+  g_journal.flush();
+  if(g_journal.needsSave()) {
+    compactSave(g_save.getValues(), g_save.getCount());
+  }
+
+  //Wait for saves to reach the disk
+  g_saveWriter.free();
+  g_journal.free();
+  g_save.free();
 
   //Free loaded images
   g_promptTextTexture.free();
   g_inputTextTexture.free();
+  g_dataTable.free();
 
   //Free global font
   TTF_CloseFont(g_font);
@@ -419,13 +1569,44 @@ void close() {
   SDL_Quit();
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+  //Number of data points, 0 keeps what the save holds
+  int totalData = 0;
+
+  //Render changed cells as soon as they change instead of at frame end
+  bool immediate = false;
+
+  //Journal entries before a new save is written
+  int compactEntries = COMPACT_ENTRIES;
+
+  //Parse command line
+  for(int i = 1; i < argc; ++i) {
+    if(strcmp(argv[i], "--values") == 0 && i + 1 < argc) {
+      totalData = atoi(argv[++i]);
+      if(totalData < 1) {
+	printf("Invalid value count, keeping the saved count\n");
+	totalData = 0;
+      }
+    } else if(strcmp(argv[i], "--immediate") == 0) {
+      immediate = true;
+    } else if(strcmp(argv[i], "--compact-every") == 0 && i + 1 < argc) {
+      compactEntries = atoi(argv[++i]);
+      if(compactEntries < 1) {
+	printf("Invalid compaction interval, using %d\n", COMPACT_ENTRIES);
+	compactEntries = COMPACT_ENTRIES;
+      }
+    } else if(strcmp(argv[i], "--bench") == 0) {
+      runSaveBenchmark();
+      return 0;
+    }
+  }
+
   if(!init()) {
     printf("Failed to initialize!\n");
     return -1;
   }
 
-  if(!loadMedia()) {
+  if(!loadMedia(totalData)) {
     printf("Failed to load media!\n");
     return -1;
   }
@@ -435,10 +1616,21 @@ int main() {
 
   //Set text color as black
   SDL_Color textColor = {0, 0, 0, 0xFF};
-  SDL_Color highlightColor = {0xFF, 0, 0, 0xFF};
 
-  //Current input point
-  int currentData = 0;
+  //Cells re-render at frame end unless asked otherwise
+  g_dataTable.setDeferred(!immediate);
+
+  //The records being edited
+  Sint32 *data = g_save.getValues();
+  totalData = g_save.getCount();
+
+  //Saves are written in the background, F5 saves
+  g_saveWriter.start();
+
+  //A new or resized save has nothing on disk for the journal to build on
+  if(g_journal.needsSave()) {
+    compactSave(data, totalData);
+  }
 
   //The current input text.
   std::string inputText = "some Text";
@@ -457,47 +1649,53 @@ int main() {
       //User request quit
       if(e.type == SDL_QUIT) {
 	quit = true;
+      } else if(e.type == g_saveWriter.getEventType()) {
+	//A background save finished, the journal restarts from it
+	printf(e.user.code ? "Saved %s\n" : "Failed to save %s!\n", SAVE_FILE.c_str());
+	g_journal.endSave(e.user.code == 1);
       } else if(e.type == SDL_KEYDOWN) {
+	//Current input point
+	int currentData = g_dataTable.getHighlight();
+
 	switch(e.key.keysym.sym) {
 	  //Previous data entry
 	case SDLK_UP:
-	  //Render previous entry input point
-	  g_dataTextures[currentData].loadFromRenderedText(std::to_string((long)g_data[currentData]), textColor);
-	  --currentData;
-
-	  if(currentData < 0) {
-	    currentData = TOTAL_DATA - 1;
-	  }
-
-	  //Render current entry input point
-	  g_dataTextures[currentData].loadFromRenderedText(std::to_string((long)g_data[currentData]), highlightColor);
+	  g_dataTable.setHighlight(currentData > 0 ? currentData - 1 : totalData - 1);
 	  break;
 
 	  //Next data entry
 	case SDLK_DOWN:
-	  //Render previous entry input point
-	  g_dataTextures[currentData].loadFromRenderedText(std::to_string((long)g_data[currentData]), textColor);
-	  ++currentData;
+	  g_dataTable.setHighlight(currentData < totalData - 1 ? currentData + 1 : 0);
+	  break;
 
-	  if(currentData == TOTAL_DATA) {
-	    currentData = 0;
-	  }
+	  //Previous page of entries
+	case SDLK_PAGEUP:
+	  g_dataTable.setHighlight(std::max(currentData - g_dataTable.getVisibleRows(), 0));
+	  break;
 
-	  //Render current entry input point
-	  g_dataTextures[currentData].loadFromRenderedText(std::to_string((long)g_data[currentData]), highlightColor);
+	  //Next page of entries
+	case SDLK_PAGEDOWN:
+	  g_dataTable.setHighlight(std::min(currentData + g_dataTable.getVisibleRows(), totalData - 1));
 	  break;
 
 	  //Decrement input point
 	case SDLK_LEFT:
-	  --g_data[currentData];
-	  g_dataTextures[currentData].loadFromRenderedText(std::to_string((long)g_data[currentData]), highlightColor);
+	  --data[currentData];
+	  g_dataTable.invalidate(currentData);
+	  g_journal.record(currentData, data[currentData]);
 	  break;
 
 	  //Increment input point
 	case SDLK_RIGHT:
-	  ++g_data[currentData];
-	  g_dataTextures[currentData].loadFromRenderedText(std::to_string((long)g_data[currentData]), highlightColor);
+	  ++data[currentData];
+	  g_dataTable.invalidate(currentData);
+	  g_journal.record(currentData, data[currentData]);
 	  break;	  
+
+	  //Save in the background
+	case SDLK_F5:
+	  compactSave(data, totalData);
+	  break;
 	}
       } else if (e.type == SDL_TEXTINPUT) {
 	//Not copy or pasting
@@ -522,15 +1720,19 @@ int main() {
       }
     }
 
+    //Write this frame's edits, and fold a long journal into a new save
+    g_journal.flush();
+    if(g_journal.getEntries() >= compactEntries && !g_journal.isSaving()) {
+      compactSave(data, totalData);
+    }
+
     //Clear screen
     SDL_SetRenderDrawColor(g_renderer, 0xFF, 0xFF, 0xFF, 0xFF);
     SDL_RenderClear(g_renderer);
 
     //Render text textures
     g_promptTextTexture.render((SCREEN_WIDTH - g_promptTextTexture.getWidth() ) / 2, 0);
-    for(int i = 0; i < TOTAL_DATA; ++i) {
-      g_dataTextures[i].render((SCREEN_WIDTH - g_dataTextures[i].getWidth()) / 2, g_promptTextTexture.getHeight() + g_dataTextures[0].getHeight() * i);
-    }
+    g_dataTable.render();
     
     //Update screen
     SDL_RenderPresent(g_renderer);
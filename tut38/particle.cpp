@@ -6,13 +6,39 @@
 #include <cmath>
 #include <vector>
 #include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 //Screen domension constants
 const int SCREEN_HEIGHT = 480;
 const int SCREEN_WIDTH  = 640;
 
+//Default number of particles, override with --particles
 const int TOTAL_PARTICLES = 1000;
 
+//Frames simulated per benchmark run
+const int BENCHMARK_FRAMES = 600;
+
+//Most threads tried by the scaling benchmark
+const int MAX_BENCHMARK_THREADS = 8;
+
+//Random seed used unless --seed is given, fixed so runs can be replayed
+const Uint64 DEFAULT_RANDOM_SEED = 38;
+
+//Random numbers generated by the generator benchmark
+const int RANDOM_BENCHMARK_VALUES = 1 << 24;
+
+//Frames drawn per render benchmark run
+const int RENDER_BENCHMARK_FRAMES = 120;
+
+//Alpha applied to every particle
+const Uint8 PARTICLE_ALPHA = 192;
+
 //A circele structure
 struct Circle {
   int x, y;
@@ -22,6 +48,140 @@ struct Circle {
 //Class defination
 class LTexture;
 
+//Records timed zones into a buffer per thread and writes them as a Chrome
+//trace_event file. While disabled a zone costs one check
+class LProfiler {
+public:
+  //Zones kept per thread, later ones are counted and dropped
+  static const int MAX_EVENTS = 1 << 20;
+
+  //Initializes variables
+  LProfiler();
+
+  //Deallocates memory
+  ~LProfiler();
+
+  //Starts recording
+  bool enable();
+
+  //Checks if zones are being recorded
+  bool isEnabled();
+
+  //Names the calling thread in the trace
+  void nameThread(const char *name);
+
+  //Records a finished zone on the calling thread, the name must outlive the profiler
+  void record(const char *name, Uint64 start, Uint64 end);
+
+  //Writes every thread's zones
+  bool write(std::string path);
+
+  //Stops recording and frees the buffers, no thread may be inside a zone
+  void free();
+
+private:
+  //A finished zone in performance counter ticks
+  struct Event {
+    const char *name;
+    Uint64 start;
+    Uint64 end;
+  };
+
+  //Zones recorded by one thread, only that thread appends to it
+  struct ThreadBuffer {
+    int id;
+    std::string name;
+    std::vector<Event> events;
+    int dropped;
+  };
+
+  //Gets the calling thread's buffer, creating it on first use
+  ThreadBuffer *getBuffer();
+
+  //Recording flag
+  bool m_enabled;
+
+  //Where each thread keeps its buffer
+  SDL_TLSID m_buffer;
+
+  //Guards the list of buffers
+  SDL_mutex *m_lock;
+  std::vector<ThreadBuffer*> m_buffers;
+
+  //Counter value trace times are measured from
+  Uint64 m_startCounts;
+};
+
+//Times the scope it is declared in
+class LProfileZone {
+public:
+  //Starts timing if the profiler is enabled
+  LProfileZone(const char *name);
+
+  //Records the zone
+  ~LProfileZone();
+
+private:
+  //Zone name and start, start is 0 when not recording
+  const char *m_name;
+  Uint64 m_start;
+};
+
+//Seedable xoshiro128** random number generator
+class LRandom {
+public:
+  //Seeds the generator, each stream of a seed gives an independent sequence
+  LRandom(Uint64 seed = DEFAULT_RANDOM_SEED, Uint64 stream = 0);
+
+  //Restarts the generator
+  void seed(Uint64 seed, Uint64 stream = 0);
+
+  //Gets 32 random bits
+  Uint32 next();
+
+  //Gets a random number in [0, bound)
+  Uint32 nextBounded(Uint32 bound);
+
+  //Gets a random number in [0, 1)
+  float nextFloat();
+
+  //Maps random bits onto [0, bound) without division
+  static Uint32 bounded(Uint32 bits, Uint32 bound);
+
+  //Advances a splitmix64 sequence, used to expand seeds into generator state
+  static Uint64 splitMix64(Uint64 &state);
+
+private:
+  //Generator state
+  Uint32 m_state[4];
+};
+
+//Several xoshiro128** generators stepped together so bulk fills vectorize
+class LRandomBatch {
+public:
+  //Generators stepped at once, one AVX2 register of 32 bit lanes
+  static const int LANES = 8;
+
+  //Seeds every lane, each stream of a seed gives independent lanes
+  LRandomBatch(Uint64 seed = DEFAULT_RANDOM_SEED, Uint64 stream = 0);
+
+  //Restarts every lane
+  void seed(Uint64 seed, Uint64 stream = 0);
+
+  //Fills buffer with random bits
+  void fill(Uint32 *values, int count);
+
+private:
+  //Steps every lane once and writes one value per lane
+  void step(Uint32 *out);
+
+  //Lane state stored word by word so one step is a handful of vector operations
+  Uint32 m_s0[LANES];
+  Uint32 m_s1[LANES];
+  Uint32 m_s2[LANES];
+  Uint32 m_s3[LANES];
+};
+
 //Particle class
 class Particle {
 public:
@@ -31,6 +191,9 @@ public:
   //Shows the particle
   void render();
 
+  //Advances the animation
+  void animate();
+
   //Checks if partivle is dead
   bool isDead();
 
@@ -45,6 +208,91 @@ private:
   LTexture *m_texture;
 };
 
+//Fixed capacity particle storage laid out as parallel arrays
+class ParticlePool {
+public:
+  //Particle colors
+  enum ParticleType {
+    PARTICLE_RED,
+    PARTICLE_GREEN,
+    PARTICLE_BLUE,
+    TOTAL_PARTICLE_TYPES
+  };
+
+  //Last frame of animation before a particle is recycled
+  static const int MAX_FRAME = 20;
+
+  //Smaller pools update on one thread, forking would cost more than the work
+  static const int MIN_PARALLEL_PARTICLES = 10000;
+
+  //Allocates storage for every particle up front
+  ParticlePool(int capacity, int threads = 0, Uint64 seed = DEFAULT_RANDOM_SEED);
+
+  //Sets the number of update threads, 0 uses the OpenMP default
+  void setThreads(int threads);
+
+  //Restarts every thread's random stream from given seed
+  void setSeed(Uint64 seed);
+
+  //Gets the number of update threads
+  int getThreads();
+
+  //Spawns every particle around given point
+  void reset(int x, int y);
+
+  //Animates particles and respawns dead ones in place, safe to run in parallel
+  void update(int x, int y);
+
+  //Shows the particles through the particle sprite batch
+  void render();
+
+  //Shows the particles with one texture copy per sprite, returns copies made
+  int renderUnbatched();
+
+  //Gets number of particles
+  int size();
+
+private:
+  //Particles respawned per random batch
+  static const int SPAWN_BATCH = 256;
+
+  //Random numbers drawn per spawned particle
+  static const int SPAWN_RANDOMS = 4;
+
+  //Random generator owned by one update thread, padded so threads never share a cache line
+  struct ThreadRandom {
+    LRandomBatch generator;
+    char padding[64];
+  };
+
+  //Respawns the particles in given slots with one batch of random numbers
+  void spawn(const int *slots, int count, int x, int y, LRandomBatch &generator);
+
+  //Respawns the particles in [begin, end) and animates the rest
+  void updateRange(int begin, int end, int x, int y, LRandomBatch &generator);
+
+  //Random generator for each update thread
+  std::vector<ThreadRandom> m_randoms;
+
+  //Seed the generators were started from
+  Uint64 m_seed;
+
+  //Number of update threads
+  int m_threads;
+
+  //Offsets
+  std::vector<int> m_posX, m_posY;
+
+  //Current frame of animation
+  std::vector<int> m_frame;
+
+  //Type of particle
+  std::vector<Uint8> m_type;
+
+  //Number of particles
+  int m_capacity;
+};
+
 //The dot that will move around on the screen
 class Dot {
 public:
@@ -56,10 +304,7 @@ public:
   static const int DOT_VEL = 10;
 
   //Initializes the variable and allocates particles
-  Dot();
-
-  //Deallocates particles
-  ~Dot();
+  Dot(int totalParticles = TOTAL_PARTICLES, int particleThreads = 0, Uint64 seed = DEFAULT_RANDOM_SEED);
 
   //Takes key presses and adjusts the dot's velocity
   void handleEvent(SDL_Event &e);
@@ -72,7 +317,7 @@ public:
 
 private:
   //The particles
-  Particle *particles[TOTAL_PARTICLES];
+  ParticlePool m_particles;
   
   //Shows the particles
   void renderParticles();
@@ -94,7 +339,7 @@ public:
   bool init();
   
   //Creates renderer from internal window
-  SDL_Renderer *createRenderer();
+  SDL_Renderer *createRenderer(bool vsync = true);
   
   //Handles window events
   void handleEvent(SDL_Event &e);
@@ -126,6 +371,64 @@ private:
   bool m_minimized;
 };
 
+//Packs images into one surface with a skyline bottom-left packer
+class LAtlasPacker {
+public:
+  //Pixels left between packed images
+  static const int PADDING = 1;
+
+  //Initializes variables
+  LAtlasPacker();
+
+  //Deallocates memory
+  ~LAtlasPacker();
+
+  //Loads and packs images, each region is named after its file without extension
+  bool pack(const std::string paths[], int count);
+
+  //Writes the atlas image to path.png and its regions to path.atlas
+  bool save(std::string path);
+
+  //Deallocates atlas surface
+  void free();
+
+  //Gets the packed surface
+  SDL_Surface *getSurface();
+
+  //Gets packed regions
+  int getRegionCount();
+  std::string &getRegionName(int index);
+  SDL_Rect &getRegion(int index);
+
+  //Gets the region name for an image path
+  static std::string regionName(std::string path);
+
+private:
+  //A horizontal run of the skyline
+  struct Segment {
+    int x, y, w;
+  };
+
+  //Finds the lowest place for a rectangle, returns the segment it starts on or -1
+  int findPosition(int w, int h, int &x, int &y);
+
+  //Raises the skyline over a rectangle placed on a segment
+  void addSkyline(int index, int x, int y, int w, int h);
+
+  //Top edge of the packed area, left to right
+  std::vector<Segment> m_skyline;
+
+  //Atlas width
+  int m_width;
+
+  //The packed images
+  SDL_Surface *m_surface;
+
+  //Region names and locations
+  std::vector<std::string> m_names;
+  std::vector<SDL_Rect> m_regions;
+};
+
 //Texture wrapper class
 class LTexture {
 public:
@@ -138,6 +441,12 @@ public:
   //Loads image at specified path
   bool loadFromFile(std::string path);
 
+  //Creates atlas from packed images
+  bool loadFromAtlas(LAtlasPacker &packer);
+
+  //Loads atlas written by LAtlasPacker::save
+  bool loadAtlas(std::string path);
+
   #ifdef _SDL_TTF_H
   //Creates image from font string
   bool loadFromRenderedText(std::string textureText, SDL_Color textColor);
@@ -159,6 +468,15 @@ public:
   void render(int x, int y, SDL_Rect *clip = NULL, double angle = 0.0, 
 	      SDL_Point* center = NULL, SDL_RendererFlip flip = SDL_FLIP_NONE);
 
+  //Renders named atlas region at given point
+  void render(const std::string &region, int x, int y);
+
+  //Gets named atlas region, NULL if there is none
+  SDL_Rect *getRegion(const std::string &name);
+
+  //Gets the hardware texture
+  SDL_Texture *getTexture();
+
   //Gets image dimensions
   int getWidth();
   int getHeight();
@@ -170,13 +488,70 @@ private:
   //Image dimensions
   int m_width;
   int m_height;
+
+  //Atlas regions by name
+  std::map<std::string, SDL_Rect> m_regions;
+};
+
+//Draws many sprites from one atlas texture with a single geometry call
+class LSpriteBatch {
+public:
+  //Initializes variables
+  LSpriteBatch();
+
+  //Deallocates memory
+  ~LSpriteBatch();
+
+  //Draws from the atlas, regions are numbered in the order they are named
+  bool setAtlas(LTexture &atlas, const std::string names[], int count);
+
+  //Deallocates buffers, the atlas belongs to its LTexture
+  void free();
+
+  //Set blending, flushes pending sprites if the mode changes
+  void setBlendMode(SDL_BlendMode blending);
+
+  //Queues atlas region at given point
+  void draw(int region, int x, int y, Uint8 alpha = 0xFF);
+
+  //Renders every queued sprite
+  void flush();
+
+  //Gets and resets the number of geometry calls since last reset
+  int takeDrawCalls();
+
+private:
+  //The atlas hardware texture
+  SDL_Texture *m_texture;
+
+  //Atlas dimensions
+  int m_width;
+  int m_height;
+
+  //Atlas regions in draw order
+  std::vector<SDL_Rect> m_regions;
+
+  //Current blending
+  SDL_BlendMode m_blendMode;
+
+  //Queued quads, four vertices per sprite
+  std::vector<SDL_Vertex> m_vertices;
+
+  //Shared quad indices, only grown when more sprites are queued than ever before
+  std::vector<int> m_indices;
+
+  //Geometry calls issued
+  int m_drawCalls;
 };
 
 //Start up SDL and creates window
-bool init();
+bool init(bool vsync = true);
+
+//Loads media, the sprite atlas is packed at startup unless a prebuilt one is given
+bool loadMedia(std::string atlasPath = "");
 
-//Loads media
-bool loadMedia();
+//Packs images into an atlas on disk
+bool packAtlasFiles(std::string path, const std::string paths[], int count);
 
 //Frees media nad shits down SDL
 void close();
@@ -190,9 +565,21 @@ bool checkCollision(Circle &a, SDL_Rect &b);
 //Calcilates distance squared between two points
 double distanceSquared(int x1, int y1, int x2, int y2);
 
+//Compares rand() against the particle generators
+void runRandomBenchmark(Uint64 seed);
+
+//Compares pointer array particles against the particle pool
+void runBenchmark(Uint64 seed);
+
+//Compares per sprite copies against the particle sprite batch
+void runRenderBenchmark(Uint64 seed);
+
 //The window renderer
 SDL_Renderer *g_renderer = NULL;
 
+//Frame profiler, enabled with --trace
+LProfiler g_profiler;
+
 //Globally used font
 TTF_Font *g_font = NULL;
 
@@ -202,8 +589,17 @@ LTexture g_greenTexture;
 LTexture g_blueTexture;
 LTexture g_shimmerTexture;
 
-//Dot texture
-LTexture g_dotTexture;
+//Particle textures by type
+LTexture *g_particleTextures[ParticlePool::TOTAL_PARTICLE_TYPES] = {
+  &g_redTexture, &g_greenTexture, &g_blueTexture
+};
+
+//Particle atlas, regions follow the particle types with shimmer last
+LSpriteBatch g_particleBatch;
+const int SHIMMER_REGION = ParticlePool::TOTAL_PARTICLE_TYPES;
+
+//Dot and particle sprites in one texture
+LTexture g_spriteAtlas;
 
 //Scene textures
 LTexture g_sceneTexture;
@@ -211,6 +607,138 @@ LTexture g_sceneTexture;
 //Our custom window
 LWindow g_window;
 
+LProfiler::LProfiler() {
+  //Initialize
+  m_enabled     = false;
+  m_buffer      = 0;
+  m_lock        = NULL;
+  m_startCounts = 0;
+}
+
+LProfiler::~LProfiler() {
+  //Deallocate
+  free();
+}
+
+bool LProfiler::enable() {
+  //Get rid of a previous recording
+  free();
+
+  //Each recording gets its own thread slot so old buffers are never seen again
+  m_buffer = SDL_TLSCreate();
+  m_lock   = SDL_CreateMutex();
+  if(m_buffer == 0 || m_lock == NULL) {
+    printf("Unable to start profiler! SDL Error: %s\n", SDL_GetError());
+    free();
+    return false;
+  }
+  m_startCounts = SDL_GetPerformanceCounter();
+  m_enabled     = true;
+  return true;
+}
+
+bool LProfiler::isEnabled() {
+  return m_enabled;
+}
+
+void LProfiler::nameThread(const char *name) {
+  if(m_enabled) {
+    getBuffer()->name = name;
+  }
+}
+
+void LProfiler::record(const char *name, Uint64 start, Uint64 end) {
+  ThreadBuffer *buffer = getBuffer();
+  if(buffer->events.size() >= (size_t)MAX_EVENTS) {
+    ++buffer->dropped;
+    return;
+  }
+  Event event = {name, start, end};
+  buffer->events.push_back(event);
+}
+
+LProfiler::ThreadBuffer *LProfiler::getBuffer() {
+  ThreadBuffer *buffer = (ThreadBuffer*)SDL_TLSGet(m_buffer);
+  if(buffer == NULL) {
+    //First zone on this thread, only registering takes the lock
+    buffer = new ThreadBuffer();
+    buffer->dropped = 0;
+    SDL_LockMutex(m_lock);
+    buffer->id = m_buffers.size();
+    m_buffers.push_back(buffer);
+    SDL_UnlockMutex(m_lock);
+
+    std::stringstream name;
+    name << "Thread " << buffer->id;
+    buffer->name = name.str();
+    SDL_TLSSet(m_buffer, buffer, NULL);
+  }
+  return buffer;
+}
+
+bool LProfiler::write(std::string path) {
+  FILE *file = fopen(path.c_str(), "w");
+  if(file == NULL) {
+    printf("Unable to write %s!\n", path.c_str());
+    return false;
+  }
+
+  //Complete events in microseconds, one track per thread
+  double microseconds = 1000000.0 / SDL_GetPerformanceFrequency();
+  int events = 0;
+  fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  SDL_LockMutex(m_lock);
+  for(int i = 0; i < (int)m_buffers.size(); ++i) {
+    ThreadBuffer *buffer = m_buffers[i];
+    fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+	    i == 0 ? "" : ",\n", buffer->id, buffer->name.c_str());
+    for(int j = 0; j < (int)buffer->events.size(); ++j) {
+      Event &event = buffer->events[j];
+      fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+	      event.name, buffer->id, (event.start - m_startCounts) * microseconds,
+	      (event.end - event.start) * microseconds);
+    }
+    events += buffer->events.size();
+    if(buffer->dropped > 0) {
+      printf("Profiler dropped %d zones on %s\n", buffer->dropped, buffer->name.c_str());
+    }
+  }
+  int threads = m_buffers.size();
+  SDL_UnlockMutex(m_lock);
+  fprintf(file, "\n]}\n");
+
+  if(fclose(file) != 0) {
+    printf("Unable to write %s!\n", path.c_str());
+    return false;
+  }
+  printf("Wrote %d zones from %d threads to %s\n", events, threads, path.c_str());
+  return true;
+}
+
+void LProfiler::free() {
+  m_enabled = false;
+  for(int i = 0; i < (int)m_buffers.size(); ++i) {
+    delete m_buffers[i];
+  }
+  m_buffers.clear();
+  if(m_lock != NULL) {
+    SDL_DestroyMutex(m_lock);
+    m_lock = NULL;
+  }
+  m_buffer = 0;
+}
+
+LProfileZone::LProfileZone(const char *name) {
+  m_name  = name;
+  m_start = g_profiler.isEnabled() ? SDL_GetPerformanceCounter() : 0;
+}
+
+LProfileZone::~LProfileZone() {
+  if(m_start != 0) {
+    g_profiler.record(m_name, m_start, SDL_GetPerformanceCounter());
+  }
+}
+
 Particle::Particle(int x, int y) {
   //Set offsets
   m_posX = x - 5 + (rand() % 25);
@@ -237,14 +765,282 @@ void Particle::render() {
   }
 
   //Animate
+  animate();
+}
+
+void Particle::animate() {
   m_frame++;
 }
 
 bool Particle::isDead() {
-  return m_frame > 20;
+  return m_frame > ParticlePool::MAX_FRAME;
+}
+
+LRandom::LRandom(Uint64 seed, Uint64 stream) {
+  this->seed(seed, stream);
+}
+
+void LRandom::seed(Uint64 seed, Uint64 stream) {
+  //Expand the seed, streams start far apart in the splitmix64 sequence
+  Uint64 sequence = seed ^ (stream * 0xD1B54A32D192ED03ull);
+  Uint64 low  = splitMix64(sequence);
+  Uint64 high = splitMix64(sequence);
+  m_state[0] = (Uint32)low;
+  m_state[1] = (Uint32)(low >> 32);
+  m_state[2] = (Uint32)high;
+  m_state[3] = (Uint32)(high >> 32);
+}
+
+Uint32 LRandom::next() {
+  Uint32 result = m_state[1] * 5;
+  result = ((result << 7) | (result >> 25)) * 9;
+
+  Uint32 t = m_state[1] << 9;
+  m_state[2] ^= m_state[0];
+  m_state[3] ^= m_state[1];
+  m_state[1] ^= m_state[2];
+  m_state[0] ^= m_state[3];
+  m_state[2] ^= t;
+  m_state[3] = (m_state[3] << 11) | (m_state[3] >> 21);
+
+  return result;
+}
+
+Uint32 LRandom::nextBounded(Uint32 bound) {
+  return bounded(next(), bound);
+}
+
+float LRandom::nextFloat() {
+  //Top 24 bits fill a float mantissa exactly
+  return (next() >> 8) * (1.0f / 16777216.0f);
+}
+
+Uint32 LRandom::bounded(Uint32 bits, Uint32 bound) {
+  //Scale into range with a multiply, bias is below 2^-32 per unit of bound
+  return (Uint32)(((Uint64)bits * bound) >> 32);
+}
+
+Uint64 LRandom::splitMix64(Uint64 &state) {
+  Uint64 z = (state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+LRandomBatch::LRandomBatch(Uint64 seed, Uint64 stream) {
+  this->seed(seed, stream);
+}
+
+void LRandomBatch::seed(Uint64 seed, Uint64 stream) {
+  //Every lane is its own stream of the seed
+  for(int lane = 0; lane < LANES; ++lane) {
+    Uint64 sequence = seed ^ ((stream * LANES + lane) * 0xD1B54A32D192ED03ull);
+    Uint64 low  = LRandom::splitMix64(sequence);
+    Uint64 high = LRandom::splitMix64(sequence);
+    m_s0[lane] = (Uint32)low;
+    m_s1[lane] = (Uint32)(low >> 32);
+    m_s2[lane] = (Uint32)high;
+    m_s3[lane] = (Uint32)(high >> 32);
+  }
+}
+
+void LRandomBatch::step(Uint32 *out) {
+  //Results stay local until the state is updated, otherwise out could alias the lanes
+  Uint32 results[LANES];
+
+  //Same recurrence as LRandom::next, written lane by lane so it vectorizes
+  for(int lane = 0; lane < LANES; ++lane) {
+    Uint32 result = m_s1[lane] * 5;
+    results[lane] = ((result << 7) | (result >> 25)) * 9;
+
+    Uint32 t = m_s1[lane] << 9;
+    m_s2[lane] ^= m_s0[lane];
+    m_s3[lane] ^= m_s1[lane];
+    m_s1[lane] ^= m_s2[lane];
+    m_s0[lane] ^= m_s3[lane];
+    m_s2[lane] ^= t;
+    m_s3[lane] = (m_s3[lane] << 11) | (m_s3[lane] >> 21);
+  }
+
+  for(int lane = 0; lane < LANES; ++lane) {
+    out[lane] = results[lane];
+  }
+}
+
+void LRandomBatch::fill(Uint32 *values, int count) {
+  //Whole strides go straight into the buffer
+  int i = 0;
+  for(; i + LANES <= count; i += LANES) {
+    step(values + i);
+  }
+
+  //Finish with one more stride, unused values are dropped
+  if(i < count) {
+    Uint32 tail[LANES];
+    step(tail);
+    for(int lane = 0; lane < count - i; ++lane) {
+      values[i + lane] = tail[lane];
+    }
+  }
+}
+
+ParticlePool::ParticlePool(int capacity, int threads, Uint64 seed) {
+  //Allocate every array once, slots are recycled afterwards
+  m_capacity = capacity;
+  m_posX.resize(capacity);
+  m_posY.resize(capacity);
+  m_frame.resize(capacity);
+  m_type.resize(capacity);
+
+  //Allocate random state for the update threads
+  m_seed = seed;
+  setThreads(threads);
+}
+
+void ParticlePool::setThreads(int threads) {
+  if(threads < 1) {
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#else
+    threads = 1;
+#endif
+  }
+  m_threads = threads;
+
+  //Give every thread its own stream so runs repeat for a given seed and thread count
+  m_randoms.resize(threads);
+  setSeed(m_seed);
+}
+
+void ParticlePool::setSeed(Uint64 seed) {
+  m_seed = seed;
+  for(int t = 0; t < m_threads; ++t) {
+    m_randoms[t].generator.seed(seed, t);
+  }
+}
+
+int ParticlePool::getThreads() {
+  return m_threads;
+}
+
+void ParticlePool::reset(int x, int y) {
+  //Every slot is spawned again from the start of the seed
+  setSeed(m_seed);
+
+  int slots[SPAWN_BATCH];
+  for(int begin = 0; begin < m_capacity; begin += SPAWN_BATCH) {
+    int count = 0;
+    for(int i = begin; i < m_capacity && count < SPAWN_BATCH; ++i) {
+      slots[count++] = i;
+    }
+    spawn(slots, count, x, y, m_randoms[0].generator);
+  }
+}
+
+void ParticlePool::spawn(const int *slots, int count, int x, int y, LRandomBatch &generator) {
+  //Draw every random number the batch needs at once
+  Uint32 randoms[SPAWN_BATCH * SPAWN_RANDOMS];
+  generator.fill(randoms, count * SPAWN_RANDOMS);
+
+  for(int n = 0; n < count; ++n) {
+    int i = slots[n];
+    const Uint32 *r = randoms + n * SPAWN_RANDOMS;
+
+    //Set offsets
+    m_posX[i] = x - 5 + LRandom::bounded(r[0], 25);
+    m_posY[i] = y - 5 + LRandom::bounded(r[1], 25);
+
+    //Initialize animation
+    m_frame[i] = LRandom::bounded(r[2], 5);
+
+    //Set type
+    m_type[i] = LRandom::bounded(r[3], TOTAL_PARTICLE_TYPES);
+  }
+}
+
+void ParticlePool::updateRange(int begin, int end, int x, int y, LRandomBatch &generator) {
+  //Dead slots waiting for a spawn batch
+  int slots[SPAWN_BATCH];
+  int count = 0;
+
+  for(int i = begin; i < end; ++i) {
+    //Animate
+    m_frame[i]++;
+
+    //Collect dead particle to be replaced in place
+    if(m_frame[i] > MAX_FRAME) {
+      slots[count++] = i;
+      if(count == SPAWN_BATCH) {
+	spawn(slots, count, x, y, generator);
+	count = 0;
+      }
+    }
+  }
+  spawn(slots, count, x, y, generator);
+}
+
+void ParticlePool::update(int x, int y) {
+  LProfileZone zone("Particle update");
+
+  //Each thread owns a contiguous block of slots and its own generator,
+  //nothing here allocates or touches SDL
+#pragma omp parallel num_threads(m_threads) if(m_capacity >= MIN_PARALLEL_PARTICLES)
+  {
+#ifdef _OPENMP
+    int thread  = omp_get_thread_num();
+    int threads = omp_get_num_threads();
+#else
+    int thread  = 0;
+    int threads = 1;
+#endif
+    LProfileZone blockZone("Particle block");
+
+    //Split slots evenly so a thread count always gives the same blocks
+    int begin = (int)((Sint64)m_capacity * thread / threads);
+    int end   = (int)((Sint64)m_capacity * (thread + 1) / threads);
+    updateRange(begin, end, x, y, m_randoms[thread].generator);
+  }
 }
 
-Dot::Dot() {
+void ParticlePool::render() {
+  LProfileZone zone("Particle render");
+
+  //Queue every particle in submission order so shimmer stays on top of its particle
+  for(int i = 0; i < m_capacity; ++i) {
+    //Show image
+    g_particleBatch.draw(m_type[i], m_posX[i], m_posY[i], PARTICLE_ALPHA);
+
+    //Show shimmer
+    if(m_frame[i] % 2 == 0) {
+      g_particleBatch.draw(SHIMMER_REGION, m_posX[i], m_posY[i], PARTICLE_ALPHA);
+    }
+  }
+
+  //Draw the whole field at once
+  g_particleBatch.flush();
+}
+
+int ParticlePool::renderUnbatched() {
+  int copies = 0;
+  for(int i = 0; i < m_capacity; ++i) {
+    //Show image
+    g_particleTextures[m_type[i]] -> render(m_posX[i], m_posY[i]);
+    ++copies;
+
+    //Show shimmer
+    if(m_frame[i] % 2 == 0) {
+      g_shimmerTexture.render(m_posX[i], m_posY[i]);
+      ++copies;
+    }
+  }
+  return copies;
+}
+
+int ParticlePool::size() {
+  return m_capacity;
+}
+
+Dot::Dot(int totalParticles, int particleThreads, Uint64 seed) : m_particles(totalParticles, particleThreads, seed) {
   //Initialize the offsets
   m_posX = 0;
   m_posY = 0;
@@ -254,16 +1050,7 @@ Dot::Dot() {
   m_velY = 0;
 
   //Initialize particles
-  for(int i = 0; i < TOTAL_PARTICLES; ++i) {
-    particles[i] = new Particle(m_posX, m_posY);
-  }
-}
-
-Dot::~Dot() {
-  //Delete particles
-  for(int i = 0; i < TOTAL_PARTICLES; ++i) {
-    delete particles[i];
-  }
+  m_particles.reset(m_posX, m_posY);
 }
 
 void Dot::handleEvent(SDL_Event &e) {
@@ -309,28 +1096,18 @@ void Dot::move() {
 
 void Dot::render() {
   //Show the dot
-  g_dotTexture.render(m_posX, m_posY);
+  g_spriteAtlas.render("dot", m_posX, m_posY);
 
   //Show particles on top of dot
   renderParticles();
 }
 
 void Dot::renderParticles() {
-  //Go through particles
-#pragma omp parallel for
-  for(int i = 0; i < TOTAL_PARTICLES; ++i) {
-    //Delete and replace dead particles
-    if(particles[i] -> isDead()) {
-      delete particles[i];
-      particles[i] = new Particle(m_posX, m_posY);
-    }
-  }
+  //Animate and recycle dead particles in parallel
+  m_particles.update(m_posX, m_posY);
 
-  //Show particles
-#pragma omp parallel for
-  for(int i = 0; i < TOTAL_PARTICLES; i++) {
-    particles[i] -> render();
-  }
+  //Submit particles from this thread only
+  m_particles.render();
 }
 
 LWindow::LWindow() {
@@ -358,8 +1135,12 @@ bool LWindow::init() {
   return m_window != NULL;
 }
 
-SDL_Renderer *LWindow::createRenderer() {
-  return SDL_CreateRenderer(m_window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+SDL_Renderer *LWindow::createRenderer(bool vsync) {
+  Uint32 flags = SDL_RENDERER_ACCELERATED;
+  if(vsync) {
+    flags |= SDL_RENDERER_PRESENTVSYNC;
+  }
+  return SDL_CreateRenderer(m_window, -1, flags);
 }
 
 void LWindow::handleEvent(SDL_Event &e) {
@@ -468,6 +1249,225 @@ bool LWindow::isMinimized() {
     return m_minimized;
 }
 
+LAtlasPacker::LAtlasPacker() {
+  //Initialize
+  m_width   = 0;
+  m_surface = NULL;
+}
+
+LAtlasPacker::~LAtlasPacker() {
+  //Deallocate
+  free();
+}
+
+bool LAtlasPacker::pack(const std::string paths[], int count) {
+  //Get rid of preexisting atlas
+  free();
+
+  //Loading success flag
+  bool success = true;
+
+  //Load every image
+  std::vector<SDL_Surface*> surfaces(count, (SDL_Surface*)NULL);
+  int area     = 0;
+  int maxWidth = 0;
+  for(int i = 0; i < count; ++i) {
+    surfaces[i] = IMG_Load(paths[i].c_str());
+    if(surfaces[i] == NULL) {
+      printf("Unable to load image %s! SDL_image Error: %s\n", paths[i].c_str(), IMG_GetError());
+      success = false;
+    } else {
+      //Color key image
+      SDL_SetColorKey(surfaces[i], SDL_TRUE, SDL_MapRGB(surfaces[i]->format, 0, 0xFF, 0xFF));
+
+      area    += (surfaces[i]->w + PADDING) * (surfaces[i]->h + PADDING);
+      maxWidth = std::max(maxWidth, surfaces[i]->w + PADDING);
+    }
+  }
+
+  if(success) {
+    //Square-ish power of two width that fits the widest image
+    m_width = 1;
+    while(m_width < maxWidth || m_width * m_width < area) {
+      m_width *= 2;
+    }
+    Segment floor = {0, 0, m_width};
+    m_skyline.push_back(floor);
+
+    //Place tallest images first
+    std::vector<int> order(count);
+    for(int i = 0; i < count; ++i) {
+      order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&surfaces](int a, int b) {
+	return surfaces[a]->h > surfaces[b]->h;
+      });
+
+    m_regions.resize(count);
+    int height = 0;
+    for(int i = 0; i < count; ++i) {
+      SDL_Surface *image = surfaces[order[i]];
+      int x, y;
+      int index = findPosition(image->w + PADDING, image->h + PADDING, x, y);
+      addSkyline(index, x, y, image->w + PADDING, image->h + PADDING);
+
+      SDL_Rect region = {x, y, image->w, image->h};
+      m_regions[order[i]] = region;
+      height = std::max(height, y + image->h + PADDING);
+    }
+
+    //Create transparent atlas surface
+    m_surface = SDL_CreateRGBSurfaceWithFormat(0, m_width, height, 32, SDL_PIXELFORMAT_RGBA32);
+    if(m_surface == NULL) {
+      printf("Unable to create atlas surface! SDL Error: %s\n", SDL_GetError());
+      success = false;
+    } else {
+      SDL_FillRect(m_surface, NULL, SDL_MapRGBA(m_surface->format, 0, 0, 0, 0));
+
+      //Copy images into place, color keyed pixels stay transparent
+      for(int i = 0; i < count; ++i) {
+	SDL_Rect destination = m_regions[i];
+	SDL_BlitSurface(surfaces[i], NULL, m_surface, &destination);
+	m_names.push_back(regionName(paths[i]));
+      }
+    }
+  }
+
+  //Get rid of loaded surfaces
+  for(int i = 0; i < count; ++i) {
+    SDL_FreeSurface(surfaces[i]);
+  }
+
+  if(!success) {
+    free();
+  }
+  return success;
+}
+
+int LAtlasPacker::findPosition(int w, int h, int &x, int &y) {
+  int best       = -1;
+  int bestBottom = 0;
+  for(int i = 0; i < (int)m_skyline.size(); ++i) {
+    int left = m_skyline[i].x;
+    if(left + w > m_width) {
+      break;
+    }
+
+    //Rest on the highest segment under the rectangle
+    int top = 0;
+    for(int j = i; j < (int)m_skyline.size() && m_skyline[j].x < left + w; ++j) {
+      top = std::max(top, m_skyline[j].y);
+    }
+
+    //Keep the lowest bottom edge, leftmost on ties
+    if(best == -1 || top + h < bestBottom) {
+      best       = i;
+      bestBottom = top + h;
+      x = left;
+      y = top;
+    }
+  }
+  return best;
+}
+
+void LAtlasPacker::addSkyline(int index, int x, int y, int w, int h) {
+  //New segment over the rectangle
+  Segment top = {x, y + h, w};
+  m_skyline.insert(m_skyline.begin() + index, top);
+
+  //Cut away what it covers of the segments to its right
+  for(int i = index + 1; i < (int)m_skyline.size(); ) {
+    int covered = x + w - m_skyline[i].x;
+    if(covered <= 0) {
+      break;
+    }
+    if(covered >= m_skyline[i].w) {
+      m_skyline.erase(m_skyline.begin() + i);
+    } else {
+      m_skyline[i].x += covered;
+      m_skyline[i].w -= covered;
+      break;
+    }
+  }
+
+  //Join neighbours at the same height
+  for(int i = 0; i + 1 < (int)m_skyline.size(); ) {
+    if(m_skyline[i].y == m_skyline[i + 1].y) {
+      m_skyline[i].w += m_skyline[i + 1].w;
+      m_skyline.erase(m_skyline.begin() + i + 1);
+    } else {
+      ++i;
+    }
+  }
+}
+
+bool LAtlasPacker::save(std::string path) {
+  if(m_surface == NULL) {
+    printf("No atlas to save!\n");
+    return false;
+  }
+
+  //Write image
+  if(IMG_SavePNG(m_surface, (path + ".png").c_str()) != 0) {
+    printf("Unable to save %s.png! SDL_image Error: %s\n", path.c_str(), IMG_GetError());
+    return false;
+  }
+
+  //Write one "name x y w h" line per region
+  SDL_RWops *file = SDL_RWFromFile((path + ".atlas").c_str(), "w");
+  if(file == NULL) {
+    printf("Unable to save %s.atlas! SDL Error: %s\n", path.c_str(), SDL_GetError());
+    return false;
+  }
+  for(int i = 0; i < (int)m_regions.size(); ++i) {
+    std::stringstream line;
+    line << m_names[i] << " " << m_regions[i].x << " " << m_regions[i].y << " "
+	 << m_regions[i].w << " " << m_regions[i].h << "\n";
+    SDL_RWwrite(file, line.str().c_str(), 1, line.str().size());
+  }
+  SDL_RWclose(file);
+  return true;
+}
+
+void LAtlasPacker::free() {
+  //Free atlas if it exists
+  if(m_surface != NULL) {
+    SDL_FreeSurface(m_surface);
+    m_surface = NULL;
+  }
+  m_width = 0;
+  m_skyline.clear();
+  m_names.clear();
+  m_regions.clear();
+}
+
+SDL_Surface *LAtlasPacker::getSurface() {
+  return m_surface;
+}
+
+int LAtlasPacker::getRegionCount() {
+  return m_regions.size();
+}
+
+std::string &LAtlasPacker::getRegionName(int index) {
+  return m_names[index];
+}
+
+SDL_Rect &LAtlasPacker::getRegion(int index) {
+  return m_regions[index];
+}
+
+std::string LAtlasPacker::regionName(std::string path) {
+  //Strip directories and extension
+  size_t start = path.find_last_of("/\\");
+  start = start == std::string::npos ? 0 : start + 1;
+  size_t end = path.find_last_of('.');
+  if(end == std::string::npos || end < start) {
+    end = path.size();
+  }
+  return path.substr(start, end - start);
+}
+
 LTexture::LTexture() {
   //Initialize
   m_texture = NULL;
@@ -512,6 +1512,73 @@ bool LTexture::loadFromFile(std::string path) {
   return m_texture != NULL;
 }
 
+bool LTexture::loadFromAtlas(LAtlasPacker &packer) {
+  //Get rid of preexisting texture
+  free();
+
+  if(packer.getSurface() == NULL) {
+    printf("Atlas has not been packed!\n");
+    return false;
+  }
+
+  //Create texture from atlas pixels
+  m_texture = SDL_CreateTextureFromSurface(g_renderer, packer.getSurface());
+  if(m_texture == NULL) {
+    printf("Unable to create atlas texture! SDL Error: %s\n", SDL_GetError());
+    return false;
+  }
+  m_width  = packer.getSurface()->w;
+  m_height = packer.getSurface()->h;
+
+  //Remember where each image went
+  for(int i = 0; i < packer.getRegionCount(); ++i) {
+    m_regions[packer.getRegionName(i)] = packer.getRegion(i);
+  }
+  return true;
+}
+
+bool LTexture::loadAtlas(std::string path) {
+  //Load packed image, its transparency is already in the alpha channel
+  free();
+  SDL_Surface *loadedSurface = IMG_Load((path + ".png").c_str());
+  if(loadedSurface == NULL) {
+    printf("Unable to load image %s.png! SDL_image Error: %s\n", path.c_str(), IMG_GetError());
+    return false;
+  }
+  m_texture = SDL_CreateTextureFromSurface(g_renderer, loadedSurface);
+  if(m_texture == NULL) {
+    printf("Unable to create texture from %s.png! SDL Error: %s\n", path.c_str(), SDL_GetError());
+  } else {
+    m_width  = loadedSurface->w;
+    m_height = loadedSurface->h;
+  }
+  SDL_FreeSurface(loadedSurface);
+  if(m_texture == NULL) {
+    return false;
+  }
+
+  //Read the region list
+  SDL_RWops *file = SDL_RWFromFile((path + ".atlas").c_str(), "r");
+  if(file == NULL) {
+    printf("Unable to load %s.atlas! SDL Error: %s\n", path.c_str(), SDL_GetError());
+    free();
+    return false;
+  }
+  std::string text(SDL_RWsize(file), '\0');
+  if(!text.empty()) {
+    SDL_RWread(file, &text[0], 1, text.size());
+  }
+  SDL_RWclose(file);
+
+  std::stringstream lines(text);
+  std::string name;
+  SDL_Rect region;
+  while(lines >> name >> region.x >> region.y >> region.w >> region.h) {
+    m_regions[name] = region;
+  }
+  return true;
+}
+
 #ifdef _SDL_TTF_H
 bool LTexture::loadFromRenderedText(std::string textureText, SDL_Color textColor) {
   bool success = true;
@@ -549,6 +1616,7 @@ void LTexture::free() {
     m_width   = 0;
     m_height  = 0;
   }
+  m_regions.clear();
 }
 
 void LTexture::setColor(Uint8 red, Uint8 green, Uint8 blue) {
@@ -571,6 +1639,25 @@ void LTexture::render(int x, int y, SDL_Rect *clip, double angle,
   SDL_RenderCopyEx(g_renderer, m_texture, clip, &renderQuad, angle, center, flip);
 }
 
+void LTexture::render(const std::string &region, int x, int y) {
+  SDL_Rect *clip = getRegion(region);
+  if(clip != NULL) {
+    render(x, y, clip);
+  }
+}
+
+SDL_Rect *LTexture::getRegion(const std::string &name) {
+  std::map<std::string, SDL_Rect>::iterator found = m_regions.find(name);
+  if(found == m_regions.end()) {
+    return NULL;
+  }
+  return &found->second;
+}
+
+SDL_Texture *LTexture::getTexture() {
+  return m_texture;
+}
+
 int LTexture::getWidth() {
   return m_width;
 }
@@ -589,14 +1676,129 @@ void LTexture::setAlpha(Uint8 alpha) {
   SDL_SetTextureAlphaMod(m_texture, alpha);
 }
 
-bool loadMedia() {
+LSpriteBatch::LSpriteBatch() {
+  //Initialize
+  m_texture   = NULL;
+  m_width     = 0;
+  m_height    = 0;
+  m_blendMode = SDL_BLENDMODE_BLEND;
+  m_drawCalls = 0;
+}
+
+LSpriteBatch::~LSpriteBatch() {
+  //Deallocate
+  free();
+}
+
+bool LSpriteBatch::setAtlas(LTexture &atlas, const std::string names[], int count) {
+  //Get rid of preexisting regions
+  free();
+
+  //Look up regions once so drawing can index them
+  for(int i = 0; i < count; ++i) {
+    SDL_Rect *region = atlas.getRegion(names[i]);
+    if(region == NULL) {
+      printf("Atlas has no region %s!\n", names[i].c_str());
+      free();
+      return false;
+    }
+    m_regions.push_back(*region);
+  }
+
+  m_texture = atlas.getTexture();
+  m_width   = atlas.getWidth();
+  m_height  = atlas.getHeight();
+  SDL_SetTextureBlendMode(m_texture, m_blendMode);
+  return true;
+}
+
+void LSpriteBatch::free() {
+  //Forget atlas, its LTexture frees it
+  m_texture = NULL;
+  m_width   = 0;
+  m_height  = 0;
+  m_regions.clear();
+  m_vertices.clear();
+}
+
+void LSpriteBatch::setBlendMode(SDL_BlendMode blending) {
+  //Sprites queued so far belong to the old mode
+  if(blending != m_blendMode) {
+    flush();
+    m_blendMode = blending;
+    SDL_SetTextureBlendMode(m_texture, blending);
+  }
+}
+
+void LSpriteBatch::draw(int region, int x, int y, Uint8 alpha) {
+  const SDL_Rect &clip = m_regions[region];
+
+  //Quad corners on screen
+  float left   = (float)x;
+  float top    = (float)y;
+  float right  = (float)(x + clip.w);
+  float bottom = (float)(y + clip.h);
+
+  //Quad corners in the atlas
+  float u0 = (float)clip.x / m_width;
+  float v0 = (float)clip.y / m_height;
+  float u1 = (float)(clip.x + clip.w) / m_width;
+  float v1 = (float)(clip.y + clip.h) / m_height;
+
+  SDL_Color color = {0xFF, 0xFF, 0xFF, alpha};
+  SDL_Vertex quad[4] = {
+    {{left,  top},    color, {u0, v0}},
+    {{right, top},    color, {u1, v0}},
+    {{right, bottom}, color, {u1, v1}},
+    {{left,  bottom}, color, {u0, v1}}
+  };
+  m_vertices.insert(m_vertices.end(), quad, quad + 4);
+}
+
+void LSpriteBatch::flush() {
+  int totalQuads = m_vertices.size() / 4;
+  if(totalQuads == 0) {
+    return;
+  }
+
+  //Extend the shared index list to cover every queued quad
+  for(int q = m_indices.size() / 6; q < totalQuads; ++q) {
+    int first = q * 4;
+    int indices[6] = {first, first + 1, first + 2, first, first + 2, first + 3};
+    m_indices.insert(m_indices.end(), indices, indices + 6);
+  }
+
+  //Render every queued sprite in one call
+  SDL_RenderGeometry(g_renderer, m_texture, &m_vertices[0], m_vertices.size(), &m_indices[0], totalQuads * 6);
+  ++m_drawCalls;
+
+  //Keep capacity for the next frame
+  m_vertices.clear();
+}
+
+int LSpriteBatch::takeDrawCalls() {
+  int drawCalls = m_drawCalls;
+  m_drawCalls = 0;
+  return drawCalls;
+}
+
+bool loadMedia(std::string atlasPath) {
   //Loading success flag
   bool success = true;
 
- //Load dot texture
-    if(!g_dotTexture.loadFromFile("dot.bmp")) {
-      printf("Failed to load dot texture!\n");
-      success = false;
+    //Load the dot and particle sprites into one atlas
+    if(!atlasPath.empty()) {
+      if(!g_spriteAtlas.loadAtlas(atlasPath)) {
+	printf("Failed to load sprite atlas %s!\n", atlasPath.c_str());
+	success = false;
+      }
+    } else {
+      std::string spritePaths[] = {"dot.bmp", "red.bmp", "green.bmp", "blue.bmp", "shimmer.bmp"};
+      LAtlasPacker packer;
+      if(!packer.pack(spritePaths, 5) || !g_spriteAtlas.loadFromAtlas(packer)) {
+	printf("Failed to pack sprite atlas!\n");
+	success = false;
+      }
     }
 
     //Load red texture
@@ -624,10 +1826,17 @@ bool loadMedia() {
     }
     
     //Set texture transparency
-    g_redTexture.setAlpha( 192 );
-    g_greenTexture.setAlpha( 192 );
-    g_blueTexture.setAlpha( 192 );
-    g_shimmerTexture.setAlpha( 192 );
+    g_redTexture.setAlpha( PARTICLE_ALPHA );
+    g_greenTexture.setAlpha( PARTICLE_ALPHA );
+    g_blueTexture.setAlpha( PARTICLE_ALPHA );
+    g_shimmerTexture.setAlpha( PARTICLE_ALPHA );
+
+    //Batch particles from the atlas, order must match the particle types
+    std::string particleRegions[] = {"red", "green", "blue", "shimmer"};
+    if(!g_particleBatch.setAtlas(g_spriteAtlas, particleRegions, 4)) {
+      printf("Failed to load particle atlas!\n");
+      success = false;
+    }
 
   return success;
 }
@@ -684,7 +1893,171 @@ double distanceSquared(int x1, int y1, int x2, int y2) {
   return deltaX * deltaX + deltaY * deltaY;
 }
 
-bool init() {
+void runRandomBenchmark(Uint64 seed) {
+  //Ticks per second of the high resolution counter
+  double frequency = (double)SDL_GetPerformanceFrequency();
+
+  //Sums keep the compiler from dropping the work
+  Uint32 checksum = 0;
+  std::vector<Uint32> values(RANDOM_BENCHMARK_VALUES);
+
+  printf("Generating %d random numbers per run\n", RANDOM_BENCHMARK_VALUES);
+  printf("%14s %10s\n", "generator", "ns/value");
+
+  srand((unsigned int)seed);
+  Uint64 start = SDL_GetPerformanceCounter();
+  for(int i = 0; i < RANDOM_BENCHMARK_VALUES; ++i) {
+    values[i] = rand();
+  }
+  double randTime = (SDL_GetPerformanceCounter() - start) * 1e9 / frequency / RANDOM_BENCHMARK_VALUES;
+  checksum += values[RANDOM_BENCHMARK_VALUES - 1];
+
+  LRandom random(seed);
+  start = SDL_GetPerformanceCounter();
+  for(int i = 0; i < RANDOM_BENCHMARK_VALUES; ++i) {
+    values[i] = random.next();
+  }
+  double scalarTime = (SDL_GetPerformanceCounter() - start) * 1e9 / frequency / RANDOM_BENCHMARK_VALUES;
+  checksum += values[RANDOM_BENCHMARK_VALUES - 1];
+
+  LRandomBatch batch(seed);
+  start = SDL_GetPerformanceCounter();
+  batch.fill(&values[0], RANDOM_BENCHMARK_VALUES);
+  double batchTime = (SDL_GetPerformanceCounter() - start) * 1e9 / frequency / RANDOM_BENCHMARK_VALUES;
+  checksum += values[RANDOM_BENCHMARK_VALUES - 1];
+
+  printf("%14s %10.3f\n", "rand", randTime);
+  printf("%14s %10.3f\n", "LRandom", scalarTime);
+  printf("%14s %10.3f\n", "LRandomBatch", batchTime);
+  printf("Seed %llu, checksum %08x\n", (unsigned long long)seed, checksum);
+}
+
+void runBenchmark(Uint64 seed) {
+  //Old particles draw from rand(), seed it too so runs repeat
+  srand((unsigned int)seed);
+
+  //Particle counts to compare
+  const int counts[] = {1000, 10000, 100000, 1000000};
+  const int totalCounts = sizeof(counts) / sizeof(counts[0]);
+
+  //Ticks per second of the high resolution counter
+  double frequency = (double)SDL_GetPerformanceFrequency();
+
+  printf("Simulating %d frames per run\n", BENCHMARK_FRAMES);
+  printf("%10s %14s %14s %8s\n", "particles", "pointers ms", "pool ms", "speedup");
+  for(int c = 0; c < totalCounts; ++c) {
+    int count = counts[c];
+
+    //Pointer array layout, one heap allocation per particle
+    std::vector<Particle*> particles(count);
+    for(int i = 0; i < count; ++i) {
+      particles[i] = new Particle(0, 0);
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    for(int frame = 0; frame < BENCHMARK_FRAMES; ++frame) {
+      int x = frame % SCREEN_WIDTH;
+      for(int i = 0; i < count; ++i) {
+	if(particles[i] -> isDead()) {
+	  delete particles[i];
+	  particles[i] = new Particle(x, 0);
+	}
+      }
+      for(int i = 0; i < count; ++i) {
+	particles[i] -> animate();
+      }
+    }
+    double pointerTime = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency / BENCHMARK_FRAMES;
+
+    for(int i = 0; i < count; ++i) {
+      delete particles[i];
+    }
+
+    //Pooled layout, no allocations after construction
+    ParticlePool pool(count, 0, seed);
+    pool.reset(0, 0);
+
+    start = SDL_GetPerformanceCounter();
+    for(int frame = 0; frame < BENCHMARK_FRAMES; ++frame) {
+      pool.update(frame % SCREEN_WIDTH, 0);
+    }
+    double poolTime = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency / BENCHMARK_FRAMES;
+
+    printf("%10d %14.4f %14.4f %7.2fx\n", count, pointerTime, poolTime, pointerTime / poolTime);
+  }
+
+  //Thread scaling of the pool update
+#ifndef _OPENMP
+  printf("Built without OpenMP, every run below uses one thread\n");
+#endif
+  printf("%10s %8s %14s %8s\n", "particles", "threads", "pool ms", "speedup");
+  for(int c = 0; c < totalCounts; ++c) {
+    int count = counts[c];
+    ParticlePool pool(count, 1, seed);
+    double singleTime = 0.0;
+
+    for(int threads = 1; threads <= MAX_BENCHMARK_THREADS; threads *= 2) {
+      pool.setThreads(threads);
+      pool.reset(0, 0);
+
+      Uint64 start = SDL_GetPerformanceCounter();
+      for(int frame = 0; frame < BENCHMARK_FRAMES; ++frame) {
+	pool.update(frame % SCREEN_WIDTH, 0);
+      }
+      double poolTime = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency / BENCHMARK_FRAMES;
+      if(threads == 1) {
+	singleTime = poolTime;
+      }
+
+      printf("%10d %8d %14.4f %7.2fx\n", count, threads, poolTime, singleTime / poolTime);
+    }
+  }
+}
+
+void runRenderBenchmark(Uint64 seed) {
+  //Particle counts to compare
+  const int counts[] = {1000, 10000, 100000};
+  const int totalCounts = sizeof(counts) / sizeof(counts[0]);
+
+  //Ticks per second of the high resolution counter
+  double frequency = (double)SDL_GetPerformanceFrequency();
+
+  printf("Rendering %d frames per run\n", RENDER_BENCHMARK_FRAMES);
+  printf("%10s %12s %12s %12s %12s\n", "particles", "copy calls", "copy ms", "batch calls", "batch ms");
+  for(int c = 0; c < totalCounts; ++c) {
+    int count = counts[c];
+    ParticlePool pool(count, 0, seed);
+    pool.reset(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2);
+
+    //One texture copy per particle and shimmer
+    int copyCalls = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for(int frame = 0; frame < RENDER_BENCHMARK_FRAMES; ++frame) {
+      pool.update(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2);
+      SDL_RenderClear(g_renderer);
+      copyCalls += pool.renderUnbatched();
+      SDL_RenderPresent(g_renderer);
+    }
+    double copyTime = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency / RENDER_BENCHMARK_FRAMES;
+    copyCalls /= RENDER_BENCHMARK_FRAMES;
+
+    //One geometry call for the whole field
+    g_particleBatch.takeDrawCalls();
+    start = SDL_GetPerformanceCounter();
+    for(int frame = 0; frame < RENDER_BENCHMARK_FRAMES; ++frame) {
+      pool.update(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2);
+      SDL_RenderClear(g_renderer);
+      pool.render();
+      SDL_RenderPresent(g_renderer);
+    }
+    double batchTime = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency / RENDER_BENCHMARK_FRAMES;
+    int batchCalls = g_particleBatch.takeDrawCalls() / RENDER_BENCHMARK_FRAMES;
+
+    printf("%10d %12d %12.3f %12d %12.3f\n", count, copyCalls, copyTime, batchCalls, batchTime);
+  }
+}
+
+bool init(bool vsync) {
   bool l_success = true;
   
   if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
@@ -702,7 +2075,7 @@ bool init() {
       l_success = false;
     } else {
       //Create renderer for window
-      g_renderer = g_window.createRenderer();
+      g_renderer = g_window.createRenderer(vsync);
       if(g_renderer == NULL) {
 	printf("Renderer could not be created! SDL Error: %s\n", SDL_GetError());
 	l_success = false;
@@ -727,9 +2100,27 @@ bool init() {
   return l_success;
 }
 
+bool packAtlasFiles(std::string path, const std::string paths[], int count) {
+  LAtlasPacker packer;
+  if(!packer.pack(paths, count) || !packer.save(path)) {
+    return false;
+  }
+
+  //Report where everything went
+  for(int i = 0; i < packer.getRegionCount(); ++i) {
+    SDL_Rect &region = packer.getRegion(i);
+    printf("%s: %d,%d %dx%d\n", packer.getRegionName(i).c_str(), region.x, region.y, region.w, region.h);
+  }
+  printf("Packed %d images into %s.png (%dx%d)\n", count, path.c_str(),
+	 packer.getSurface()->w, packer.getSurface()->h);
+  return true;
+}
+
 void close() {
   //Free loadded images
   g_sceneTexture.free();
+  g_particleBatch.free();
+  g_spriteAtlas.free();
   
   //Destroy window
   SDL_DestroyRenderer(g_renderer);
@@ -741,13 +2132,70 @@ void close() {
   SDL_Quit();
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+  //Number of particles following the dot
+  int totalParticles = TOTAL_PARTICLES;
+
+  //Particle update threads, 0 uses the OpenMP default
+  int particleThreads = 0;
+
+  //Particle random seed
+  Uint64 seed = DEFAULT_RANDOM_SEED;
+
+  //Benchmark instead of running the demo
+  bool benchmark = false;
+
+  //Prebuilt sprite atlas
+  std::string atlasPath;
+
+  //Where to write a frame trace
+  std::string tracePath;
+
+  //Parse command line
+  for(int i = 1; i < argc; ++i) {
+    if(strcmp(argv[i], "--bench") == 0) {
+      benchmark = true;
+    } else if(strcmp(argv[i], "--particles") == 0 && i + 1 < argc) {
+      totalParticles = atoi(argv[++i]);
+      if(totalParticles < 1) {
+	printf("Invalid particle count, using %d\n", TOTAL_PARTICLES);
+	totalParticles = TOTAL_PARTICLES;
+      }
+    } else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      particleThreads = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoull(argv[++i], NULL, 10);
+    } else if(strcmp(argv[i], "--atlas") == 0 && i + 1 < argc) {
+      atlasPath = argv[++i];
+    } else if(strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      tracePath = argv[++i];
+    } else if(strcmp(argv[i], "--pack-atlas") == 0 && i + 2 < argc) {
+      //Offline packing takes the output path and every remaining argument as an image
+      std::vector<std::string> paths(argv + i + 2, argv + argc);
+      return packAtlasFiles(argv[i + 1], &paths[0], paths.size()) ? 0 : -1;
+    }
+  }
+
+  if(benchmark) {
+    runRandomBenchmark(seed);
+    runBenchmark(seed);
+
+    //Rendering needs a window, run it without vsync so frames are not capped
+    if(init(false) && loadMedia(atlasPath)) {
+      runRenderBenchmark(seed);
+    } else {
+      printf("Skipping render benchmark!\n");
+    }
+    close();
+    return 0;
+  }
+
   if(!init()) {
     printf("Failed to initialize!\n");
     return -1;
   }
 
-  if(!loadMedia()) {
+  if(!loadMedia(atlasPath)) {
     printf("Failed to load media!\n");
     return -1;
   }
@@ -756,33 +2204,57 @@ int main() {
   SDL_Event e;
 
   //The dot that will be moving on the screen
-  Dot dot;
+  Dot dot(totalParticles, particleThreads, seed);
+
+  //Record where frame time goes
+  if(!tracePath.empty() && g_profiler.enable()) {
+    g_profiler.nameThread("Main");
+  }
 
   //While application is running
   while(!quit) {
+    LProfileZone frameZone("Frame");
+
     //Handle events on queue
-    while(SDL_PollEvent(&e) != 0) {
-      //User request quit
-      if(e.type == SDL_QUIT) {
-	quit = true;
-      } 
-      //Handle window events
-      dot.handleEvent(e);
+    {
+      LProfileZone zone("Events");
+      while(SDL_PollEvent(&e) != 0) {
+	//User request quit
+	if(e.type == SDL_QUIT) {
+	  quit = true;
+	} 
+	//Handle window events
+	dot.handleEvent(e);
+      }
     }
 
     //Move the dot
-    dot.move();
+    {
+      LProfileZone zone("Move");
+      dot.move();
+    }
 
-    //Clear screen
-    SDL_SetRenderDrawColor(g_renderer, 0xFF, 0xFF, 0xFF, 0xFF);
-    SDL_RenderClear(g_renderer);
-    
     //Render objects
-    dot.render();
+    {
+      LProfileZone zone("Render");
+
+      //Clear screen
+      SDL_SetRenderDrawColor(g_renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+      SDL_RenderClear(g_renderer);
+    
+      dot.render();
+    }
 
     //Update screen
-    SDL_RenderPresent(g_renderer);
+    {
+      LProfileZone zone("Present");
+      SDL_RenderPresent(g_renderer);
     }
+  }
+  if(g_profiler.isEnabled()) {
+    g_profiler.write(tracePath);
+    g_profiler.free();
+  }
   close();
   return 0;
 }